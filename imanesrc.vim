@@ -8,6 +8,7 @@ syntax keyword rcStdId square2
 syntax keyword rcStdId triangle
 syntax keyword rcStdId dmc
 syntax keyword rcStdId noise
+syntax match rcStdId /\<pad[12]\.\(a\|b\|select\|start\|up\|down\|left\|right\)\>/
 
 syntax match rcComment /#.*$/ display
 
@@ -29,9 +29,12 @@ typedef enum _nes_apu_channel {
 	Square2   = 1,
 	Triangle  = 2,
 	DMC       = 3,
-	Noise     = 4
+	Noise     = 4,
+	Expansion = 5  /* Cartridge audio, already mixed by the mapper */
 } nes_apu_channel;
 
+#define APU_CHANNELS (6)
+
 
 /*
  * Common structures
@@ -0,0 +1,16 @@
+#ifndef axrom_h
+#define axrom_h
+
+#include <stdint.h>
+
+#define AXROM_ID (7)
+
+/* Implementation of mapper struct function pointers */
+void axrom_initialize_mapper();
+int  axrom_check_address(uint16_t address, uint8_t value);
+void axrom_switch_banks();
+void axrom_reset();
+void axrom_update();
+void axrom_end_mapper();
+
+#endif /* axrom_h */
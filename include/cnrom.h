@@ -7,7 +7,7 @@
 
 /* Implementation of mapper struct function pointers */
 void cnrom_initialize_mapper();
-int  cnrom_check_address(uint16_t address);
+int  cnrom_check_address(uint16_t address, uint8_t value);
 void cnrom_switch_banks();
 void cnrom_reset();
 void cnrom_update();
@@ -43,6 +43,7 @@ typedef struct _ines_file {
 	uint8_t *vrom;
 
 	int has_trainer;
+	int pal;
 } ines_file;
 
 /* For a given file, and given its full path, get only the file name
@@ -50,6 +51,6 @@ typedef struct _ines_file {
 char *get_filename(char *full_pathname);
 
 /* Convert an instruction's name to lowercase */
-void inst_lowercase(char *inst_name, char *ret);
+void inst_lowercase(const char *inst_name, char *ret);
 
 #endif /* common_h */
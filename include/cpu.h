@@ -10,6 +10,11 @@
 #define SRAM_ENABLE 0x01
 #define SRAM_RO     0x02
 
+/* Sources that can hold the IRQ line asserted */
+#define IRQ_MAPPER  0x01
+#define IRQ_FRAME   0x02
+#define IRQ_DMC     0x04
+
 typedef struct _cpu {
 
 	/* Internal CPU registers */
@@ -29,10 +34,96 @@ typedef struct _cpu {
 	/* Enable SRAM storage */
 	uint8_t sram_enabled;
 
+	/* IRQ line. Each source sets its own bit, and the line stays
+	 * asserted until all the sources acknowledge it */
+	uint8_t irq;
+
+	/* An I/O register was accessed, or the mapper was written */
+	uint8_t io_access;
+
 } nes_cpu;
 
 extern nes_cpu *CPU;
 
+/* Functions implementing each instruction */
+void ADC_func(const instruction *inst, operand *oper);
+void AND_func(const instruction *inst, operand *oper);
+void ASL_func(const instruction *inst, operand *oper);
+void BCC_func(const instruction *inst, operand *oper);
+void BCS_func(const instruction *inst, operand *oper);
+void BEQ_func(const instruction *inst, operand *oper);
+void BIT_func(const instruction *inst, operand *oper);
+void BMI_func(const instruction *inst, operand *oper);
+void BNE_func(const instruction *inst, operand *oper);
+void BPL_func(const instruction *inst, operand *oper);
+void BRK_func(const instruction *inst, operand *oper);
+void BVC_func(const instruction *inst, operand *oper);
+void BVS_func(const instruction *inst, operand *oper);
+void CLC_func(const instruction *inst, operand *oper);
+void CLD_func(const instruction *inst, operand *oper);
+void CLI_func(const instruction *inst, operand *oper);
+void CLV_func(const instruction *inst, operand *oper);
+void CMP_func(const instruction *inst, operand *oper);
+void CPX_func(const instruction *inst, operand *oper);
+void CPY_func(const instruction *inst, operand *oper);
+void DEC_func(const instruction *inst, operand *oper);
+void DEX_func(const instruction *inst, operand *oper);
+void DEY_func(const instruction *inst, operand *oper);
+void EOR_func(const instruction *inst, operand *oper);
+void INC_func(const instruction *inst, operand *oper);
+void INX_func(const instruction *inst, operand *oper);
+void INY_func(const instruction *inst, operand *oper);
+void JMP_func(const instruction *inst, operand *oper);
+void JSR_func(const instruction *inst, operand *oper);
+void LDA_func(const instruction *inst, operand *oper);
+void LDX_func(const instruction *inst, operand *oper);
+void LDY_func(const instruction *inst, operand *oper);
+void LSR_func(const instruction *inst, operand *oper);
+void NOP_func(const instruction *inst, operand *oper);
+void ORA_func(const instruction *inst, operand *oper);
+void PHA_func(const instruction *inst, operand *oper);
+void PHP_func(const instruction *inst, operand *oper);
+void PLA_func(const instruction *inst, operand *oper);
+void PLP_func(const instruction *inst, operand *oper);
+void ROL_func(const instruction *inst, operand *oper);
+void ROR_func(const instruction *inst, operand *oper);
+void RTI_func(const instruction *inst, operand *oper);
+void RTS_func(const instruction *inst, operand *oper);
+void SBC_func(const instruction *inst, operand *oper);
+void SEC_func(const instruction *inst, operand *oper);
+void SED_func(const instruction *inst, operand *oper);
+void SEI_func(const instruction *inst, operand *oper);
+void STA_func(const instruction *inst, operand *oper);
+void STX_func(const instruction *inst, operand *oper);
+void STY_func(const instruction *inst, operand *oper);
+void TAX_func(const instruction *inst, operand *oper);
+void TAY_func(const instruction *inst, operand *oper);
+void TSX_func(const instruction *inst, operand *oper);
+void TXA_func(const instruction *inst, operand *oper);
+void TXS_func(const instruction *inst, operand *oper);
+void TYA_func(const instruction *inst, operand *oper);
+void ANC_func(const instruction *inst, operand *oper);
+void ALR_func(const instruction *inst, operand *oper);
+void ARR_func(const instruction *inst, operand *oper);
+void DCP_func(const instruction *inst, operand *oper);
+void ISC_func(const instruction *inst, operand *oper);
+void LAX_func(const instruction *inst, operand *oper);
+void RLA_func(const instruction *inst, operand *oper);
+void RRA_func(const instruction *inst, operand *oper);
+void SAX_func(const instruction *inst, operand *oper);
+void SBX_func(const instruction *inst, operand *oper);
+void SHX_func(const instruction *inst, operand *oper);
+void SHY_func(const instruction *inst, operand *oper);
+void SLO_func(const instruction *inst, operand *oper);
+void SRE_func(const instruction *inst, operand *oper);
+void default_func(const instruction *inst, operand *oper);
+
+/* Illegal instructions not implemented yet */
+#define AHX_func default_func
+#define LAS_func default_func
+#define TAS_func default_func
+#define XAA_func default_func
+
 /** SR flags */
 #define N_FLAG 0x80
 #define V_FLAG 0x40
@@ -46,6 +137,12 @@ extern nes_cpu *CPU;
 #define BEGIN_STACK (0x100)
 #define STACK_SIZE  (0x100)
 
+/** Memory mapped registers */
+#define PPU_REGISTERS   (0x8)
+#define APU_REGISTERS   (0x20)
+#define EXPANSION_START (0x4020)
+#define EXPANSION_SIZE  (0x6000 - EXPANSION_START)
+
 /**
  * Initialize the CPU with its registers
  */
@@ -70,7 +167,7 @@ void dump_ram(uint16_t address, unsigned int lenght);
 /**
  * Given an operand, and an instruction, it executes it into the CPU
  */
-void execute_instruction(instruction *inst, operand *oper);
+void execute_instruction(const instruction *inst, operand *oper);
 
 /**
  * Read from a RAM address and return the value there. This function
@@ -86,6 +183,13 @@ uint8_t read_cpu_ram(uint16_t address);
  */
 void write_cpu_ram(uint16_t address, uint8_t value);
 
+/**
+ * Replaces the function used to read the given address of the expansion
+ * area ($4020-$5FFF). Mappers use it for their registers that have side
+ * effects when read
+ */
+void set_read_cpu_ram_f(uint16_t address, uint8_t (*read_f)(uint16_t address));
+
 /**
  * Pushes the given value into the CPU's stack
  */
@@ -111,12 +215,36 @@ void execute_reset();
  */
 void execute_irq();
 
+/**
+ * Checks the IRQ line between instructions. If any source is asserting
+ * it and the I flag is clear, the IRQ is serviced
+ */
+void check_irq_line();
+
 /**
  * Add cycles to certain opcodes executions
  * when crossing page bounds
  */
 void add_cycles(uint8_t type, int8_t value);
 
+/**
+ * If the CPU is spinning in an idle loop (a JMP to itself or a load of
+ * a RAM or $2002 value followed by a branch back to it) that wouldn't
+ * exit, runs as many of its iterations as fit in the budget of CPU
+ * cycles at once. Returns the base cycles of the skipped instructions,
+ * or 0 if there was no idle loop to skip
+ */
+int skip_idle_loop(int budget);
+
+/**
+ * Runs instructions until the clock would pass the given deadline (in
+ * PPU cycles), an I/O register is accessed, or an unmasked IRQ is
+ * pending. Idle loops are skipped and translated blocks are run when
+ * enabled. Returns the base cycles of the executed instructions, or 0
+ * if none could be run
+ */
+int run_until(unsigned long int deadline);
+
 /**
  * Frees all the resources used by the CPU 
  */
@@ -8,13 +8,23 @@
 #define DEBUG_LEVEL   2
 #define XTREME_LEVEL  3
 
+/* Highest verbosity level compiled in. Release builds leave the DEBUG
+ * and XTREME logs out, so the hot paths don't check the verbosity at all.
+ * The imanes-debug build compiles every level in */
+#ifndef MAX_VERBOSITY
+#define MAX_VERBOSITY INFO_LEVEL
+#endif
+
+/* Whether a verbosity level is compiled in and selected by the user */
+#define VERBOSE(level) ( (level) <= MAX_VERBOSITY && config.verbosity >= (level) )
+
 #define NORMAL( X )  LOG(NORMAL_LEVEL, X)
 #define INFO( X )    LOG(INFO_LEVEL, X)
 #define DEBUG( X )   LOG(DEBUG_LEVEL, X)
 #define XTREME( X )  LOG(XTREME_LEVEL, X)
 #define LOG(level, X) \
 	do { \
-		if( config.verbosity >= level ) { X; } \
+		if( VERBOSE(level) ) { X; } \
 	} while(0);
 
 extern int verbosity;
@@ -0,0 +1,23 @@
+#ifndef dma_h
+#define dma_h
+
+#include <stdint.h>
+
+/* CPU cycles stolen by each DMA transfer. OAM DMA takes one more
+ * cycle when it starts in an odd CPU cycle */
+#define OAM_DMA_CYCLES   (513)
+#define DMC_DMA_CYCLES   (4)
+
+/**
+ * Copies the 256 bytes of the given CPU page into the SPR-RAM, starting
+ * at the current SPR-RAM address, and stalls the CPU. Must be called
+ * while the instruction writing to $4014 is being executed
+ */
+void oam_dma(uint8_t page);
+
+/**
+ * Fetches a DMC sample byte from the given address and stalls the CPU
+ */
+uint8_t dmc_dma(uint16_t address);
+
+#endif /* dma_h */
@@ -0,0 +1,18 @@
+#ifndef fme7_h
+#define fme7_h
+
+#include <stdint.h>
+
+#define FME7_ID (69)
+
+/* Implementation of mapper struct function pointers */
+void fme7_initialize_mapper();
+int  fme7_check_address(uint16_t address, uint8_t value);
+void fme7_switch_banks();
+void fme7_reset();
+void fme7_update();
+void fme7_clock_cpu(int cycles);
+uint8_t *fme7_sram();
+void fme7_end_mapper();
+
+#endif /* fme7_h */
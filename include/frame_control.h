@@ -1,14 +1,38 @@
 #ifndef frame_control_h
 #define frame_control_h
 
+#include "common.h"
+
+/* Frame periods in nanoseconds, as exact fractions. An NTSC frame lasts
+ * 357366 master cycles at 236.25/11 MHz (60.0988 Hz), and a PAL one
+ * 531960 master cycles at 26.601712 MHz (50.0070 Hz) */
+#define NTSC_FRAME_NS_NUM  (1048273600ULL)
+#define NTSC_FRAME_NS_DEN  (63ULL)
+#define PAL_FRAME_NS_NUM   (33247500000000ULL)
+#define PAL_FRAME_NS_DEN   (1662607ULL)
+
+/**
+ * Returns the current time of the monotonic clock used for
+ * pacing the frames, in nanoseconds
+ */
+uint64_t frame_clock();
+
 /**
  * Set the initial times to now
  */
 void start_timing();
 
 /**
- * Sleeps the necessary time to get the needed frequency
+ * Waits until the absolute deadline of the current frame, so the
+ * emulation runs at the exact NTSC or PAL frame rate. Deadlines are not
+ * reset when we are slightly late, so the lost time is recovered
  */
 void frame_sleep();
 
+/**
+ * Decides, following the frame skipping policy, whether the next
+ * frame should be rendered or not
+ */
+int render_next_frame();
+
 #endif /* frame_control_h */
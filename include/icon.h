@@ -0,0 +1,13 @@
+#ifndef icon_h
+#define icon_h
+
+#include <SDL/SDL.h>
+
+/* Width and height of the window icon */
+#define ICON_SIZE  (32)
+
+/* Built-in window icon */
+extern const Uint32 imanes_icon[ICON_SIZE*ICON_SIZE];
+extern const Uint8  imanes_icon_mask[ICON_SIZE*ICON_SIZE/8];
+
+#endif /* icon_h */
@@ -3,6 +3,13 @@
 
 #include <stdint.h>
 
+/* Special frame skipping values */
+#define FRAME_SKIP_AUTO   (-1)  /* Skip frames to keep up with real time */
+#define FRAME_SKIP_NEVER  (-2)  /* Don't render at all */
+
+#define CAPTURE_PNG  (0)  /* Indexed PNG images */
+#define CAPTURE_RAW  (1)  /* One palette index per pixel, 256x224 */
+
 typedef struct _config {
 
 	/* PPU layers */
@@ -31,15 +38,32 @@ typedef struct _config {
 	int video_scale;             /* Video scale factor */
 	int verbosity;               /* How verbose imanes should be */
 	int run_fast;                /* Run as fast as possible */
+	int frame_skip;              /* Frames skipped after a rendered one */
+	int translate_blocks;        /* Run PRG-ROM code as native code */
+	int skip_idle_loops;         /* Fast-forward idle loops to the next event */
 	int use_sdl_colors;          /* Let SDL convert RGB values */
+	int ntsc_filter;             /* Simulate the NTSC composite signal */
+	char *palette_file;          /* Colors of the system palette */
+	int present_thread;          /* Show frames from a separate thread */
 	int sound_mute;              /* Do not output any sound */
 	int sound_rec;               /* Record the current sound */
+	int audio_pacing;            /* Follow the audio clock when pacing frames */
 
 	int take_screenshot;         /* Should we take a screenshot? */
+	int capture_format;          /* Format of screenshots and dumps */
+	char *dump_dir;              /* Directory where every frame is saved */
+	char *record_file;           /* Lossless video and audio recording */
+
+	char *trace_file;            /* Binary instruction trace file */
+	char *profile_file;          /* Execution profile report */
+	char *telemetry;             /* Telemetry file or Unix socket */
 
 	char *rom_file;             /* Name of the rom file */
 } imanes_config;
 
+/* Longest name of the per-user configuration files */
+#define CONFIG_PATH_SIZE  (1024)
+
 typedef enum _imanes_dir {
 	States,    /* To save internal states of ImaNES*/
 	Saves,     /* To save ROM's SRAM */
@@ -56,11 +80,15 @@ void initialize_configuration();
 void load_user_configuration();
 
 /* Checks the existence (and creates) of per-user imanes config directory
- * and returns its name */
+ * and returns its name. Only needed when writing into it */
 char *get_user_imanes_dir();
 
 /** Checks and returns internal config directories under the per-user
  * imanes config directory */
 char *get_imanes_dir(imanes_dir dir);
 
+/** Returns the name of an internal config directory, without creating
+ * it. Enough for reading what's already there */
+char *imanes_dir_name(imanes_dir dir);
+
 #endif /* imaconfig_h */
@@ -109,6 +109,16 @@
 /* Number of possible opcodes */
 #define OPCODES_NUMBER  0x100
 
+/**
+ * An instruction may need the value in memory of a given address,
+ * or maybe the address itself. Therefore, we store both values in this
+ * structure, so they can be used as needed
+ */
+typedef struct _operand {
+	uint16_t address;   /* Store the address if needed */
+	uint8_t  value;     /* Store the value of the operand if needed */
+} operand;
+
 typedef struct _instruction {
 	uint8_t opcode;       /* 1 byte opcode */
 	uint8_t instr_id;     /* Which instruction corresponds */
@@ -117,49 +127,39 @@ typedef struct _instruction {
 	short size;           /* Instruction size / depends on addr_mode */
 	short cycles;         /* CPU cycles that it takes to run the instr */
 	uint8_t cycle_change; /* Cycle number is variable? */
-	long executed;        /* Times that the instruction been executed */
+	void (*handler)(const struct _instruction *, operand *); /* Function that runs it */
 } instruction;
 
-extern instruction instructions[OPCODES_NUMBER];
-
+/* Constant table of all the opcodes, see opcodes.def */
+extern const instruction instructions[OPCODES_NUMBER];
 
 /**
- * An instruction may need the value in memory of a given address,
- * or maybe the address itself. Therefore, we store both values in this
- * structure, so they can be used as needed
+ * An instruction decoded in advance: the function that runs it and,
+ * when it doesn't depend on the registers or on memory contents, its
+ * operand. Entries of the decoded instructions cache are valid as long
+ * as the memory page where they are hasn't changed since
  */
-typedef struct _operand {
-	uint16_t address;   /* Store the address if needed */
-	uint8_t  value;     /* Store the value of the operand if needed */
-} operand;
+typedef struct _decoded_inst {
+	const instruction *inst;                         /* Entry of the instruction table */
+	void (*handler)(const instruction *, operand *); /* Function that runs it */
+	operand oper;        /* Operand, when it's known in advance */
+	uint8_t dynamic;     /* Operand must be calculated at execution time */
+	uint64_t tag;        /* Generation of the memory page when decoded */
+} decoded_inst;
+
+/* Generation of each 256 bytes page of CPU memory */
+extern uint64_t decoded_page_gen[0x100];
 
-#ifdef _MSC_VER
-#define SET_INSTRUCTION_ADDR_DATA( INST, ADDR_MODE, OPCODE, SIZE, CYCLES, \
-                                   CHANGE ) \
-   instructions[OPCODE].opcode       = OPCODE; \
-   instructions[OPCODE].instr_id     = INST;   \
-   instructions[OPCODE].addr_mode    = ADDR_##ADDR_MODE;   \
-   instructions[OPCODE].size         = SIZE;   \
-   instructions[OPCODE].cycles       = CYCLES; \
-   instructions[OPCODE].cycle_change = CYCLE_##CHANGE; \
-   instructions[OPCODE].executed     = 0; \
-   strncpy_s(instructions[OPCODE].name,4,#INST,3);
-#else
-#define SET_INSTRUCTION_ADDR_DATA( INST, ADDR_MODE, OPCODE, SIZE, CYCLES, \
-                                   CHANGE ) \
-   instructions[OPCODE].opcode       = OPCODE; \
-   instructions[OPCODE].instr_id     = INST;   \
-   instructions[OPCODE].addr_mode    = ADDR_##ADDR_MODE;   \
-   instructions[OPCODE].size         = SIZE;   \
-   instructions[OPCODE].cycles       = CYCLES; \
-   instructions[OPCODE].cycle_change = CYCLE_##CHANGE; \
-   instructions[OPCODE].executed     = 0; \
-   strncpy(instructions[OPCODE].name,#INST,3);
-#endif
+/**
+ * Must be used every time that a CPU memory byte is modified, so the
+ * instructions decoded from its page are decoded again
+ */
+#define DECODED_PAGE_WRITTEN(address) \
+	decoded_page_gen[((address) >> 8) & 0xFF]++
 
 /**
- * Initializes the instruction set with the corresponding opcodes,
- * operation sizes and cycles in CPU
+ * Initializes the decoded instructions cache. The instruction table
+ * itself is constant
  */
 void initialize_instruction_set();
 
@@ -167,6 +167,28 @@ void initialize_instruction_set();
  * When reading an instruction, the operand that should be used depends
  * on the addressing mode. This function does this job
  */
-void get_operand(instruction *inst, operand *oper);
+void get_operand(const instruction *inst, operand *oper);
+
+/**
+ * Decodes the instruction at the given CPU address
+ */
+void decode_instruction(uint16_t address, decoded_inst *d);
+
+/**
+ * Returns the decoded instruction at the given CPU address, decoding it
+ * only if it's not in the cache or if its memory changed since
+ */
+decoded_inst *fetch_decoded(uint16_t address);
+
+/**
+ * Invalidates the decoded instructions of a CPU memory area that was
+ * modified without going through the CPU writes (e.g., bank switching)
+ */
+void invalidate_decoded(uint16_t address, unsigned int size);
+
+/**
+ * Frees the decoded instructions cache
+ */
+void end_instruction_set();
 
 #endif /* instruction_set_h */
@@ -4,9 +4,21 @@
 #include <stdint.h>
 
 #include "common.h"
+#include "telemetry.h"
+#include "translator.h"
 
 #define MAX_MAPPER_NAME_SIZE 100
 
+/* A variable of the internal state of a mapper that isn't kept in its
+ * registers. It is saved and restored along with them in the states */
+typedef struct _mapper_state {
+	void *data;
+	unsigned int size;
+} mapper_state;
+
+#define MAPPER_STATE(variable)  { &(variable), sizeof(variable) }
+#define MAPPER_STATES(list)     (sizeof(list)/sizeof(list[0]))
+
 /** Common structure for all mappers */
 typedef struct _mapper {
 
@@ -18,7 +30,7 @@ typedef struct _mapper {
 	void (*initialize_mapper)();
 
 	/* Checks the written memory, and saves the data to the internal  */
-	int  (*check_address)(uint16_t address);
+	int  (*check_address)(uint16_t address, uint8_t value);
 
 	/* Performs the bank switchings */
 	void (*switch_banks)();
@@ -26,23 +38,57 @@ typedef struct _mapper {
 	/* Performs the system memory fill at reset or at initialization */
 	void (*reset)();
 
-	/* Updates internal registers at the end of each scanline */
+	/* Updates internal registers on each rising edge of the PPU A12 line */
 	void (*update)();
 
 	/* Frees the resources used by the mapper */
 	void (*end_mapper)();
 
+	/* The following hooks are optional, and are only
+	 * needed by some boards. They are left to NULL otherwise */
+
+	/* Clocks internal counters and expansion audio with CPU cycles */
+	void (*clock_cpu)(int cycles);
+
+	/* Called at the beginning of each scanline */
+	void (*scanline)(int line);
+
+	/* Notified of the pattern table addresses fetched by the PPU */
+	void (*latch_chr)(uint16_t address);
+
+	/* Fetches a background tile instead of the PPU. Returns 0 if
+	 * the PPU should fetch it by itself */
+	int  (*fetch_bg_tile)(int column, int line, uint16_t nt_address, uint8_t fine_y,
+	                      uint8_t *byte1, uint8_t *byte2, uint8_t *palette);
+
+	/* Returns where the battery-backed RAM currently is, for boards
+	 * that can map something else on 0x6000-0x7FFF */
+	uint8_t *(*sram)();
+
 	/* Registers */
 	uint8_t *regs;
 
 	/* Associated nes file pointer */
 	ines_file *file;
 
+	/* Internal state out of the registers, set by initialize_mapper */
+	const mapper_state *state;
+	unsigned int state_count;
+
 } nes_mapper;
 
 /* Dumps the contents of the internal mapper registers into stdout */
 void dump_mapper();
 
+/* Size of the mapper state (registers and internal state) in the states */
+unsigned int mapper_state_size();
+
+/* Saves the mapper state into a buffer of mapper_state_size() bytes */
+void save_mapper_state(uint8_t *buffer);
+
+/* Restores the mapper state from a buffer of mapper_state_size() bytes */
+void load_mapper_state(const uint8_t *buffer);
+
 /* Mapper list from http://fms.komkon.org/EMUL8/NES.html */
 extern nes_mapper mapper_list[];
 
@@ -50,7 +96,11 @@ extern nes_mapper mapper_list[];
 extern nes_mapper *mapper;
 
 #define SWAP_RAM( ram_start, prg_start, size ) \
-	memcpy(CPU->RAM + ram_start, prg_start, size)
+	do { \
+		memcpy(CPU->RAM + (ram_start), prg_start, size); \
+		map_prg_pages(ram_start, prg_start, size); \
+		COUNT(bank_switches, 1); \
+	} while(0)
 
 #define SWAP_RAM_8K( start, bank ) \
 	SWAP_RAM( start, mapper->file->rom + (bank) * 0x2000, 0x2000 )
@@ -61,7 +111,11 @@ extern nes_mapper *mapper;
 
 
 #define SWAP_VRAM( vram_start, chr_start, size ) \
-	memcpy(PPU->VRAM + vram_start, chr_start, size)
+	do { \
+		memcpy(PPU->VRAM + (vram_start), chr_start, size); \
+		invalidate_chr_cache(vram_start, size); \
+		COUNT(bank_switches, 1); \
+	} while(0)
 
 #define SWAP_VRAM_1K( address, bank ) \
 	SWAP_VRAM(address, mapper->file->vrom + (bank) * 0x0400, 0x0400 )
@@ -7,7 +7,7 @@
 
 /* Implementation of mapper struct function pointers */
 void mmc1_initialize_mapper();
-int  mmc1_check_address(uint16_t address);
+int  mmc1_check_address(uint16_t address, uint8_t value);
 void mmc1_switch_banks();
 void mmc1_reset();
 void mmc1_update();
@@ -0,0 +1,20 @@
+#ifndef mmc2_h
+#define mmc2_h
+
+#include <stdint.h>
+
+#define MMC2_ID (9)
+#define MMC4_ID (10)
+
+/* Implementation of mapper struct function pointers.
+ * MMC4 shares everything but the initialization */
+void mmc2_initialize_mapper();
+void mmc4_initialize_mapper();
+int  mmc2_check_address(uint16_t address, uint8_t value);
+void mmc2_switch_banks();
+void mmc2_reset();
+void mmc2_update();
+void mmc2_latch_chr(uint16_t address);
+void mmc2_end_mapper();
+
+#endif /* mmc2_h */
@@ -7,7 +7,7 @@
 
 /* Implementation of mapper struct function pointers */
 void mmc3_initialize_mapper();
-int  mmc3_check_address(uint16_t address);
+int  mmc3_check_address(uint16_t address, uint8_t value);
 void mmc3_switch_banks();
 void mmc3_reset();
 void mmc3_update();
@@ -0,0 +1,20 @@
+#ifndef mmc5_h
+#define mmc5_h
+
+#include <stdint.h>
+
+#define MMC5_ID (5)
+
+/* Implementation of mapper struct function pointers */
+void mmc5_initialize_mapper();
+int  mmc5_check_address(uint16_t address, uint8_t value);
+void mmc5_switch_banks();
+void mmc5_reset();
+void mmc5_update();
+void mmc5_clock_cpu(int cycles);
+void mmc5_scanline(int line);
+int  mmc5_fetch_bg_tile(int column, int line, uint16_t nt_address, uint8_t fine_y,
+                        uint8_t *byte1, uint8_t *byte2, uint8_t *palette);
+void mmc5_end_mapper();
+
+#endif /* mmc5_h */
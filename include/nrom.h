@@ -7,7 +7,7 @@
 
 /* Implementation of the "no mapper" mapper */
 void nrom_initialize_mapper();
-int  nrom_check_address(uint16_t address);
+int  nrom_check_address(uint16_t address, uint8_t value);
 void nrom_switch_banks();
 void nrom_reset();
 void nrom_update();
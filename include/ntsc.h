@@ -0,0 +1,30 @@
+#ifndef ntsc_h
+#define ntsc_h
+
+#include <stdint.h>
+
+/* Filtered pixels produced for each NES pixel */
+#define NTSC_OUT_PER_PIXEL  (2)
+
+/* Colors with emphasis: the 6 bits system palette index and the 3 bits
+ * of color emphasis in the PPU CR2 */
+#define NTSC_COLORS  (512)
+
+/* Phases of the color subcarrier a pixel can start at */
+#define NTSC_PHASES  (3)
+
+/**
+ * Computes the contribution of each color to the filtered pixels around
+ * it, by simulating the composite signal generated by the PPU and its
+ * decoding by the TV
+ */
+void initialize_ntsc_filter();
+
+/**
+ * Filters a line of system palette indexes drawn with the given PPU CR2,
+ * whose first pixel starts at the given subcarrier phase. The output has
+ * NTSC_OUT_PER_PIXEL pixels per input pixel, in 0x00RRGGBB format
+ */
+void ntsc_filter_line(const uint8_t *pixels, uint8_t cr2, int phase, uint32_t *out);
+
+#endif /* ntsc_h */
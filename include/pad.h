@@ -14,9 +14,17 @@
 #define NES_LEFT   (0x40)
 #define NES_RIGHT  (0x80)
 
+/* Number of buttons of each pad */
+#define PAD_BUTTONS (8)
+
+/* Joystick axis value from which a direction is considered pressed */
+#define JOY_AXIS_THRESHOLD (16384)
+
 typedef struct _pad {
 	uint8_t plugged;      /* The pad is plugged or not */
-	uint8_t pressed_keys; /* Keys that are actually pressed, or'ed */
+	uint8_t pressed_keys; /* Buttons pressed on the keyboard, or'ed */
+	uint8_t pressed_joy;  /* Buttons pressed on the joystick, or'ed */
+	uint8_t latched;      /* Keys pressed when the pad was strobed */
 	uint8_t reads;
 } nes_pad;
 
@@ -25,6 +33,22 @@ extern nes_pad pads[2];
 /* Initializes the pads */
 void initialize_pads();
 
+/* Closes the joysticks opened by initialize_pads */
+void end_pads();
+
+/* Binds a pad button from imanes.rc (e.g., "pad1.a = k").
+ * Returns -1 if the setting is not a pad binding, 0 otherwise */
+int configure_pad(char *key, char *value);
+
+/* Polls the user's input, unless it was already done in this frame */
+void poll_input();
+
+/* Called at the end of each frame; polls if no game read the pads */
+void end_input_frame();
+
+/* Latches the pressed keys when the pads are strobed */
+void latch_pads();
+
 /* Dumps the contents of the given pad */
 void dump_pad(int pad);
 
@@ -34,4 +58,10 @@ void nes_keydown(SDL_keysym keysym);
 /* Update pads information for released keys */
 void nes_keyup(SDL_keysym keysym);
 
+/* Update pads information for joystick buttons */
+void nes_joybutton(SDL_JoyButtonEvent *event);
+
+/* Update pads information for joystick axes */
+void nes_joyaxis(SDL_JoyAxisEvent *event);
+
 #endif /* pad_h */
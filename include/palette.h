@@ -3,6 +3,8 @@
 
 #include <stdint.h>
 
+#include "common.h"
+
 /**
  * It keeps the current colors that can be drawn in the NES
  */
@@ -20,11 +22,20 @@ typedef struct _palette {
    PALETTE[INDEX].blue = BLUE; \
    PALETTE[INDEX].combined = RED << 16 | GREEN << 8 | BLUE;
 
-/* System palette with the actual colors */
+/* Colors of the system palette for each combination of the emphasis bits.
+ * Index 'color | (CR2 & EMPHASIS_MASK) << 1' has the emphasized color */
+#define NES_EMPHASIS_COLORS  (8*NES_PALETTE_COLORS)
+
+/* Attenuation of the channels not emphasized */
+#define EMPHASIS_ATTENUATION  (0.746)
+
+/* System palette with the actual colors, NES_EMPHASIS_COLORS long */
 extern nes_palette *system_palette;
 
 /**
- * This function initializes the palette
+ * This function initializes the palette. If a palette file is configured
+ * it is loaded instead of the built-in one: either 64 RGB colors, whose
+ * emphasis is then calculated, or 512 RGB colors including it
  */
 void initialize_palette();
 
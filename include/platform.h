@@ -6,6 +6,8 @@
 #undef IMANES_WRITE  /* write() function */
 #undef IMANES_READ   /* read() function */
 #undef IMANES_MKDIR  /* mkdir() function */
+#undef IMANES_XCHG   /* Atomic exchange, returns the old value */
+#undef IMANES_RENAME /* Replaces a file with another one, returns 0 on success */
 #undef RW_RET        /* Type returned by read()/write() */
 
 #define IMANES_OPEN_READ  0
@@ -35,6 +37,12 @@
 	#define IMANES_WRITE        _write
 	#define IMANES_READ         _read
 	#define IMANES_MKDIR(dir)   _mkdir(dir)
+	/* Needs <Windows.h> */
+	#define IMANES_RENAME(from,to) \
+	            (MoveFileExA((from), (to), MOVEFILE_REPLACE_EXISTING|MOVEFILE_WRITE_THROUGH) ? 0 : -1)
+
+	#include <intrin.h>
+	#define IMANES_XCHG(ptr,val) _InterlockedExchange((volatile long *)(ptr), (val))
 
 #else
 
@@ -54,6 +62,9 @@
 	#define IMANES_WRITE        write
 	#define IMANES_READ         read
 	#define IMANES_MKDIR(dir)   mkdir(dir, S_IRWXU|S_IRGRP|S_IXGRP|S_IROTH|S_IXOTH)
+	#define IMANES_RENAME(from,to) rename((from), (to))
+
+	#define IMANES_XCHG(ptr,val) __atomic_exchange_n((ptr), (val), __ATOMIC_ACQ_REL)
 
 #endif /* _MSC_VER */
 
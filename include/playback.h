@@ -20,6 +20,17 @@ void playback_fill_sound_card(void *userdata, Uint8 *stream, int len);
  */
 void playback_add_sample(int channel, uint8_t sample);
 
+/**
+ * Returns the sampling rate of the played audio, 0 if there's no audio
+ */
+int playback_rate();
+
+/**
+ * Returns the audio device clock at the given frame_clock() instant, in
+ * nanoseconds of played audio, or 0 if it is not running yet
+ */
+uint64_t playback_clock(uint64_t now);
+
 /**
  * Pauses/resumes the playback of audio
  */
@@ -0,0 +1,24 @@
+#ifndef png_h
+#define png_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Largest PNG produced for an image of the given size and number of
+ * palette colors. Fixed Huffman codes take at most 9 bits per byte */
+#define PNG_MAX_SIZE(width, height, colors) \
+	(((size_t)(width)+1)*(height)*9/8 + 3*(colors) + 128)
+
+/* Buffer needed to encode it, including the filtered lines */
+#define PNG_BUFFER_SIZE(width, height, colors) \
+	(PNG_MAX_SIZE(width, height, colors) + ((size_t)(width)+1)*(height))
+
+/**
+ * Encodes an 8-bit indexed image as a PNG into the given buffer, which
+ * must hold at least PNG_BUFFER_SIZE bytes. The palette has 3 bytes (RGB)
+ * per color. Returns the size of the encoded image
+ */
+size_t encode_png(uint8_t *out, const uint8_t *pixels, int width, int height,
+                  const uint8_t *palette, int colors);
+
+#endif /* png_h */
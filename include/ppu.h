@@ -17,6 +17,10 @@
 #define DONTCLIP_SPRITES     (0x04)
 #define SHOW_BACKGROUND      (0x08)
 #define SHOW_SPRITES         (0x10)
+#define EMPHASIS_RED         (0x20)
+#define EMPHASIS_GREEN       (0x40)
+#define EMPHASIS_BLUE        (0x80)
+#define EMPHASIS_MASK        (0xE0)
 
 /* Flags for the PPU Status Register */
 #define IGNORE_VRAM_WRITE    (0x10)
@@ -36,6 +40,18 @@
 #define SPRITE_FLIP_HORIZ    (0x40)
 #define SPRITE_FLIP_VERT     (0x80)
 
+/* A12 line of the PPU address bus. MMC3-like mappers only see a rising
+ * edge if the line has been low for some M2 cycles before (~3 CPU cycles),
+ * that is, for more than A12_FILTER_CYCLES PPU cycles. The short low period
+ * across the end of a line (337 to 5) never counts */
+#define PPU_A12              (0x1000)
+#define A12_FILTER_CYCLES    (9)
+#define A12_MAX_EDGES        (16)
+
+/* Pattern tables are decoded by tiles of 16 bytes */
+#define CHR_TILE_SIZE        (16)
+#define CHR_TILES            (0x2000/CHR_TILE_SIZE)
+
 typedef struct _ppu {
 
 	/* Registers */
@@ -59,6 +75,11 @@ typedef struct _ppu {
 	unsigned int lines;    /* Current scanline */
 	unsigned int frames;   /* Frame counting */
 
+	/* Qualified A12 rising edges of the current scanline */
+	int a12_edges[A12_MAX_EDGES]; /* Scanline PPU cycle of each edge */
+	int a12_edge_count;           /* Number of edges in the scanline */
+	int a12_next_edge;            /* Next edge to be signaled */
+
 } nes_ppu;
 
 /* Global PPU used through all the program */
@@ -70,9 +91,11 @@ extern nes_ppu *PPU;
 void initialize_ppu();
 
 /**
- * Function called every time that we need to draw a scanline
+ * Function called every time that we need to draw a scanline. When
+ * render is 0 the frame is being skipped, and only the work with side
+ * effects (scrolling, sprite #0 hit, mapper CHR latches) is done
  */
-void draw_line(int line, int frame);
+void draw_line(int line, int render);
 
 /**
  * Reads a value from a given PPU VRAM address. This method should
@@ -86,6 +109,28 @@ uint8_t read_ppu_vram(uint16_t address);
  */
 void write_ppu_vram(uint16_t address, uint8_t value);
 
+/**
+ * Calculates at which PPU cycles of the given scanline the A12 line
+ * rises, based on the pattern table fetches that the PPU will perform
+ * (background tiles, sprites and the next line prefetch). Only the edges
+ * that pass the M2 filter are stored in the PPU for the main loop
+ */
+void schedule_a12_edges(int line);
+
+/**
+ * Feeds the A12 edge detector with an address put on the PPU bus
+ * by the CPU through 0x2006/0x2007. A qualified rising edge clocks
+ * the mapper immediately
+ */
+void a12_bus_access(uint16_t address);
+
+/**
+ * Marks the decoded tiles of the given pattern table area as invalid.
+ * It must be called each time that CHR data is modified, either by
+ * bank switching or by writes to CHR RAM
+ */
+void invalidate_chr_cache(uint16_t address, unsigned int size);
+
 /**
  * Dumps the content of the PPU to the stdout
  */
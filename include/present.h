@@ -0,0 +1,46 @@
+#ifndef present_h
+#define present_h
+
+#include <stdint.h>
+
+#include "screen.h"
+
+/* Frames shared between the PPU and the presentation thread: one being
+ * drawn, one ready to be shown, and one being shown */
+#define PRESENT_BUFFERS  (3)
+
+/* A frame as drawn by the PPU */
+typedef struct _frame_buffer {
+	uint8_t pixels[NES_SCREEN_WIDTH*NES_SCREEN_HEIGHT]; /* System palette indexes */
+	uint8_t cr2[NES_SCREEN_HEIGHT]; /* PPU CR2 of each line: emphasis and monochrome */
+	int phase;                      /* Color subcarrier phase of the first line */
+} frame_buffer;
+
+/* The frame being drawn */
+extern frame_buffer *nes_frame;
+
+/**
+ * Starts the presentation thread, which converts the finished frames to
+ * the screen colors, scales them and flips the screen
+ */
+void initialize_presentation();
+
+/**
+ * Hands the frame drawn until now to the presentation thread and starts
+ * drawing the next one. Never waits for the screen: if the previous
+ * frame hasn't been shown yet it is replaced by this one
+ */
+void publish_frame();
+
+/**
+ * Waits until every published frame has been shown, so the screen
+ * surface can be used from the calling thread
+ */
+void present_flush();
+
+/**
+ * Stops the presentation thread after showing the pending frame
+ */
+void end_presentation();
+
+#endif /* present_h */
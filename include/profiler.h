@@ -0,0 +1,63 @@
+#ifndef profiler_h
+#define profiler_h
+
+#include <stdint.h>
+
+/* Limits of the call stacks tracked for the collapsed stacks report */
+#define PROFILE_MAX_NODES  (1 << 16)
+#define PROFILE_MAX_DEPTH  (64)
+
+/* Kinds of stack frames that are not subroutines */
+#define PROFILE_RESET  (-1)
+#define PROFILE_NMI    (-2)
+#define PROFILE_IRQ    (-3)
+
+/* Whether the execution is being profiled */
+extern int profiling;
+
+/**
+ * Accounts the instruction about to be executed, if profiling.
+ * Its cycles are known when the next one starts
+ */
+#define PROFILE_INSTRUCTION() \
+	do { \
+		if( profiling ) \
+			profile_instruction(); \
+	} while(0)
+
+/**
+ * Accounts an interrupt of the given kind, if profiling
+ */
+#define PROFILE_INTERRUPT(kind) \
+	do { \
+		if( profiling ) \
+			profile_interrupt(kind); \
+	} while(0)
+
+/**
+ * Accounts an access to an I/O register or a mapper write, if profiling
+ */
+#define PROFILE_IO(address, write) \
+	do { \
+		if( profiling ) \
+			profile_io(address, write); \
+	} while(0)
+
+/**
+ * Starts profiling the PRG-ROM of the given size
+ */
+void initialize_profiler(unsigned long prg_size);
+
+void profile_instruction();
+
+void profile_interrupt(int kind);
+
+void profile_io(uint16_t address, int write);
+
+/**
+ * Writes the flat report into the given file, and the collapsed stacks
+ * (for flamegraph tools) into the same file with a ".folded" suffix
+ */
+void end_profiler(char *file);
+
+#endif /* profiler_h */
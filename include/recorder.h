@@ -0,0 +1,68 @@
+#ifndef recorder_h
+#define recorder_h
+
+#include <stdint.h>
+
+/* Frames that can be waiting to be encoded */
+#define RECORD_QUEUE  (16)
+
+/* Frames between two frames encoded without reference to the previous one */
+#define KEYFRAME_INTERVAL  (600)
+
+/* Bytes of played audio kept until the next frame is written */
+#define RECORD_AUDIO_SIZE  (1 << 16)
+
+/*
+ * Recordings are a header followed by chunks. All numbers are little
+ * endian. The header is:
+ *
+ *  - "IMANESV" and the format version (1 byte)
+ *  - Frame width and height (2 bytes each)
+ *  - Frame period in nanoseconds as a fraction (8 bytes each)
+ *  - Audio sampling rate, 0 if there's no audio (4 bytes)
+ *  - RGB palette of NES_PALETTE_COLORS colors (3 bytes each)
+ *
+ * Each chunk is its type (1 byte) and payload size (4 bytes):
+ *
+ *  - 'A': unsigned 8 bits mono samples, as they were played
+ *  - 'K', 'F': emulated frame number (4 bytes), and the frame encoded as
+ *    a sequence of operations. 'K' frames don't use any SKIP operation.
+ *    Frames not rendered are missing, and the previous one should be
+ *    repeated in their place
+ *
+ * Operations are a byte with the type in the two upper bits, and the
+ * number of pixels in the rest. If they are RECORD_LONG_OP, the number
+ * of pixels follows in 2 bytes
+ */
+#define RECORD_VERSION  (1)
+
+#define RECORD_SKIP     (0)  /* Pixels not changed since the last frame */
+#define RECORD_RUN      (1)  /* Pixels of the single color that follows */
+#define RECORD_LITERAL  (2)  /* Pixels that follow */
+
+#define RECORD_LONG_OP  (0x3F)
+#define RECORD_MAX_OP   (0xFFFF)
+
+/**
+ * Starts recording the shown frames and the played audio into the given
+ * file. Frames are encoded and written from a separate thread
+ */
+int initialize_recording(char *file_name);
+
+/**
+ * Queues a frame of system palette indexes to be recorded. It is
+ * dropped if the queue is full, the recording remains valid
+ */
+void record_frame(const uint8_t *frame, unsigned long number);
+
+/**
+ * Keeps the audio samples being played, to be written with the next frame
+ */
+void record_audio(const uint8_t *samples, int len);
+
+/**
+ * Writes the queued frames and closes the recording
+ */
+void end_recording();
+
+#endif /* recorder_h */
@@ -17,6 +17,17 @@ extern SDL_Surface *nes_screen;
 /* Screen loop */
 void screen_loop(void);
 
+/**
+ * SDL 1.2 video and event functions are not thread safe, and the screen is
+ * flipped by the presentation thread while the emulation polls the events.
+ * Every one of those calls is made with this lock held
+ */
+void lock_video(void);
+void unlock_video(void);
+
+/* SDL_PollEvent with the video lock held */
+int poll_event(SDL_Event *event);
+
 /**
  * This method initializes the screen where everything is going to be drawn
  */ 
@@ -28,40 +39,18 @@ void init_screen(void);
 void end_screen(void);
 
 /**
- * Draw a pixel on the screen.
+ * Draw a pixel on the frame being drawn, using a system palette index.
+ * The presentation thread converts it later to the screen colors
  */
 #define draw_pixel(x, y, color) \
 do { \
-	int loop1; \
-	int loop2; \
-	Uint32 colour; \
-	Uint32 *pixmem32; \
-	int realy = y - 8; \
-	if( realy >= 0 && realy < NES_NTSC_HEIGHT ) { \
-		/* This is the color that will be put in the pixel */ \
-		if( config.use_sdl_colors ) \
-			colour = SDL_MapRGB(nes_screen->format, color.red, color.green, color.blue); \
-		else \
-			colour = color.combined; \
-		pixmem32 = (Uint32*)nes_screen->pixels; \
-		if( config.video_scale != 1 ) { \
-			for(loop1=0;loop1!=config.video_scale;loop1++) \
-				for(loop2=0;loop2!=config.video_scale;loop2++) \
-					pixmem32[config.video_scale*x+loop1+NES_SCREEN_WIDTH*config.video_scale*(realy*config.video_scale+loop2)] = colour; \
-		} \
-		else \
-			pixmem32[x+NES_SCREEN_WIDTH*realy] = colour; \
-	} \
-} while(0);
+	if( (y) >= 0 && (y) < NES_SCREEN_HEIGHT ) \
+		nes_frame->pixels[(y)*NES_SCREEN_WIDTH + (x)] = (color); \
+} while(0)
 
 /**
  * Shows the current fps in the emulation window title
  */
 void show_fps();
 
-/**
- * Redraw screen
- */
-void redraw_screen();
-
 #endif
@@ -1,7 +1,26 @@
 #ifndef screenshot_h
 #define screenshot_h
 
-/* Saves an screenshot of the current picture */
-void save_screenshot();
+#include <stdint.h>
+
+/* Frames that can be waiting to be written */
+#define CAPTURE_QUEUE  (8)
+
+/**
+ * Starts the thread that encodes and writes the screenshots and dumps
+ */
+void initialize_capture();
+
+/**
+ * Queues the visible part of a frame of system palette indexes, if a
+ * screenshot was requested or frames are being dumped. The frame is
+ * copied, and it is dropped if the queue is full
+ */
+void capture_frame(const uint8_t *frame, unsigned long number);
+
+/**
+ * Writes the queued frames and stops the capture thread
+ */
+void end_capture();
 
 #endif /* screenshot_h */
@@ -1,14 +1,26 @@
 #ifndef sram_h
 #define sram_h
 
-/* Function used to save the actual contents of the SRAM
- * to a persistent file on disk
+/* Battery backed RAM area */
+#define SRAM_START  (0x6000)
+#define SRAM_SIZE   (0x2000)
+
+/* Frames between checks of the SRAM contents, about 2 seconds */
+#define SRAM_FLUSH_FRAMES  (120)
+
+/* Loads the SRAM of the given ROM from its save file, if it has
+ * battery, and starts the thread that saves it in the background
+ */
+void initialize_sram(char *rom_file);
+
+/* Called once per frame. Every now and then, if the SRAM has
+ * changed, its contents are handed to the thread to be saved. The
+ * save file is replaced atomically, so it survives crashes
  */
-void save_sram(char * file);
+void check_sram();
 
-/* Function used to get the contents of the SRAM from a
- * file on disk. Returns the file where the contents are saves
+/* Stops the thread and saves the last contents of the SRAM
  */
-char * load_sram(char * rom_file);
+void end_sram();
 
 #endif /* sram_h */
@@ -1,10 +1,37 @@
 #ifndef states_h
 #define states_h
 
-/* Loads an ImaNES state */
+/* Number of state slots of each ROM */
+#define STATE_SLOTS  (10)
+
+/* States kept in memory, the least recently used one is replaced */
+#define STATE_CACHE_SIZE  (STATE_SLOTS)
+
+/* States that can be waiting to be written */
+#define STATE_QUEUE  (4)
+
+/* State files start with the magic, followed by the uncompressed
+ * size (32 bits, little endian). The last byte of the magic is the
+ * version of the state layout. Version 1 states, and the uncompressed
+ * ones from before, have no IRQ lines, SRAM enable or internal mapper
+ * state, and are still loaded */
+#define STATE_MAGIC       "IMANESS\2"
+#define STATE_MAGIC_V1    "IMANESS\1"
+#define STATE_MAGIC_SIZE  (8)
+#define STATE_HEADER      (STATE_MAGIC_SIZE + 4)
+
+/* Allocates the states memory, and starts the thread that writes
+ * them and reads in advance the ones of the ROM */
+void initialize_states();
+
+/* Loads an ImaNES state, from memory if it was recently used */
 void load_state(int i);
 
-/* Saves an ImaNES state */
+/* Saves an ImaNES state. It's copied into memory, and
+ * then compressed and written in the background */
 void save_state(int i);
 
+/* Writes the pending states and stops the thread */
+void end_states();
+
 #endif /* states_h */
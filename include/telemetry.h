@@ -0,0 +1,95 @@
+#ifndef telemetry_h
+#define telemetry_h
+
+#include <stdint.h>
+
+/* Seconds between telemetry reports */
+#define TELEMETRY_PERIOD  (1)
+
+/* Prefix of the telemetry destinations that are Unix sockets */
+#define TELEMETRY_UNIX_PREFIX  "unix:"
+
+/* Subsystems whose host time is measured */
+typedef enum _telemetry_timer {
+	CPUTime,    /* CPU, APU and mappers */
+	PPUTime,    /* Scanlines drawing */
+	HostTime,   /* SDL events and input */
+	SleepTime   /* Waiting for the next frame */
+} telemetry_timer;
+
+#define TELEMETRY_TIMERS  (4)
+
+/**
+ * Performance counters. They are always updated, and periodically
+ * reported when telemetry is enabled
+ */
+typedef struct _nes_counters {
+	uint64_t frames;             /* Emulated frames */
+	uint64_t rendered_frames;    /* Frames actually drawn */
+	uint64_t presented_frames;   /* Frames shown on the screen */
+	uint64_t dropped_frames;     /* Drawn frames replaced before being shown */
+	uint64_t dropped_captures;   /* Screenshots, dumps and recorded frames not saved in time */
+	uint64_t late_frames;        /* Frames finished after their deadline */
+	uint64_t instructions;       /* Executed CPU instructions */
+	uint64_t bank_switches;      /* PRG and CHR banks mapped */
+	uint64_t vram_accesses;      /* $2007 reads and writes */
+	uint64_t audio_underruns;    /* Sound card asked for unemulated audio */
+	uint64_t sleep_overshoot;    /* Microseconds slept past the deadlines */
+	uint64_t present_time;       /* Microseconds spent showing frames */
+	uint64_t first_frame_time;   /* Microseconds from the start to the first frame shown */
+	uint64_t time[TELEMETRY_TIMERS]; /* Microseconds spent on each subsystem */
+} nes_counters;
+
+extern nes_counters counters;
+
+/* Whether the counters are being reported */
+extern int telemetry;
+
+#define COUNT(counter, n) \
+	do { \
+		counters.counter += (n); \
+	} while(0)
+
+/**
+ * Starts accounting the host time to the given subsystem, if reporting
+ */
+#define TELEMETRY_TIMER(timer) \
+	do { \
+		if( telemetry ) \
+			telemetry_timer_switch(timer); \
+	} while(0)
+
+/**
+ * Starts reporting the counters to the given destination: either a file,
+ * where lines are appended, or a Unix datagram socket ("unix:<path>")
+ */
+int initialize_telemetry(char *destination);
+
+/**
+ * Marks the start of the emulator, to measure the time to the first frame
+ */
+void telemetry_startup();
+
+/**
+ * Accounts the time to the first frame shown since the start
+ */
+void telemetry_first_frame();
+
+/**
+ * Returns a monotonic time in microseconds
+ */
+uint64_t telemetry_now();
+
+void telemetry_timer_switch(telemetry_timer timer);
+
+/**
+ * Accounts an emulated frame, and reports the counters when it's time
+ */
+void telemetry_frame(int rendered);
+
+/**
+ * Closes the telemetry destination
+ */
+void end_telemetry();
+
+#endif /* telemetry_h */
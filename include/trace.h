@@ -0,0 +1,83 @@
+#ifndef trace_h
+#define trace_h
+
+#include <stdint.h>
+
+/* Trace files start with this header, followed by the ring of records */
+#define TRACE_MAGIC        "IMNTRACE"
+#define TRACE_VERSION      (1)
+#define TRACE_HEADER_SIZE  (4096)
+
+/* Instructions kept in the ring. Must be a power of 2 */
+#define TRACE_RECORDS      (1 << 20)
+
+/**
+ * A traced instruction, with the CPU state before executing it
+ */
+typedef struct _trace_record {
+	uint64_t cycle;       /* CPU cycle */
+	uint32_t frame;       /* Frame number */
+	int16_t  scanline;    /* Scanline, -1 is the pre-render one */
+	uint16_t PC;
+	uint8_t  opcode;
+	uint8_t  operands[2]; /* Bytes following the opcode */
+	uint8_t  A;
+	uint8_t  X;
+	uint8_t  Y;
+	uint8_t  SR;
+	uint8_t  SP;
+} trace_record;
+
+/**
+ * Opcode description stored in the trace file, so traces can
+ * be disassembled without the emulator
+ */
+typedef struct _trace_opcode {
+	char    name[4];
+	uint8_t addr_mode;
+	uint8_t size;
+} trace_opcode;
+
+/**
+ * Header of the trace file. The ring is full once total reaches
+ * capacity, and then the oldest record is the next to be written
+ */
+typedef struct _trace_header {
+	char     magic[8];
+	uint32_t version;
+	uint32_t record_size;
+	uint32_t capacity;     /* Records in the ring */
+	uint32_t next;         /* Next record to be written */
+	uint64_t total;        /* Records written since the start */
+	trace_opcode opcodes[0x100];
+} trace_header;
+
+/* Whether instructions are being traced */
+extern int tracing;
+
+/**
+ * Records the instruction about to be executed, if tracing
+ */
+#define TRACE_INSTRUCTION() \
+	do { \
+		if( tracing ) \
+			trace_instruction(); \
+	} while(0)
+
+/**
+ * Creates the trace file and maps it into memory. The records stay
+ * in the file even if the emulator crashes
+ */
+int initialize_trace(char *file);
+
+/**
+ * Records the instruction at the current PC
+ */
+void trace_instruction();
+
+/**
+ * Flushes and unmaps the trace file
+ */
+void end_trace();
+
+#endif /* trace_h */
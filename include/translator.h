@@ -0,0 +1,57 @@
+#ifndef translator_h
+#define translator_h
+
+#include <stdint.h>
+
+#include "common.h"
+#include "instruction_set.h"
+
+/* PRG-ROM is tracked in 8 Kb pages, the smallest bank size of the
+ * supported mappers. Blocks never cross a page */
+#define PRG_PAGE_SIZE      (0x2000)
+#define PRG_PAGES          (4)      /* 0x8000 -> 0xFFFF */
+
+/* Limits of the translated blocks */
+#define BLOCK_MAX_INSTS    (16)
+#define MAX_BLOCKS         (8192)
+
+/**
+ * Initializes the translator for the PRG-ROM of the given file
+ */
+void initialize_translator(ines_file *file);
+
+/**
+ * Records that the given CPU RAM area now holds a copy of the given PRG
+ * data. Mappers call it through SWAP_RAM on every bank switch, so blocks
+ * are looked up by PRG-ROM offset and survive bank switching. The decoded
+ * instructions of the area are invalidated
+ */
+void map_prg_pages(uint16_t address, const uint8_t *prg, unsigned int size);
+
+/**
+ * Returns the PRG-ROM offset of the byte mapped at the given CPU address,
+ * or -1 if it is not in a known PRG-ROM bank
+ */
+long prg_offset(uint16_t address);
+
+/**
+ * Forgets which PRG-ROM banks are mapped. Pages are not translated again
+ * until a mapper maps them
+ */
+void reset_prg_map();
+
+/**
+ * Runs the native code of the block starting at the current PC if it
+ * takes at most budget CPU cycles. Returns the base cycles of the
+ * executed instructions, or 0 if nothing was run and the instruction must
+ * be interpreted. Native code is only generated on x86-64 hosts, on any
+ * other host this always returns 0
+ */
+int execute_block(int budget);
+
+/**
+ * Frees the resources used by the translator
+ */
+void end_translator();
+
+#endif /* translator_h */
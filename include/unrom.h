@@ -7,7 +7,7 @@
 
 /* Implementation of mapper struct function pointers */
 void unrom_initialize_mapper();
-int  unrom_check_address(uint16_t address);
+int  unrom_check_address(uint16_t address, uint8_t value);
 void unrom_switch_banks();
 void unrom_reset();
 void unrom_update();
@@ -0,0 +1,38 @@
+#ifndef vrc6_h
+#define vrc6_h
+
+#include <stdint.h>
+
+#include "mapper.h"
+
+#define VRC6A_ID (24)
+#define VRC6B_ID (26)
+
+/* VRC IRQ control register bits */
+#define VRC_IRQ_ENABLE_AFTER_ACK (0x01)
+#define VRC_IRQ_ENABLE           (0x02)
+#define VRC_IRQ_CYCLE_MODE       (0x04)
+
+/* Implementation of mapper struct function pointers.
+ * VRC6b only differs in the initialization */
+void vrc6_initialize_mapper();
+void vrc6b_initialize_mapper();
+int  vrc6_check_address(uint16_t address, uint8_t value);
+void vrc6_switch_banks();
+void vrc6_reset();
+void vrc6_update();
+void vrc6_clock_cpu(int cycles);
+void vrc6_end_mapper();
+
+/* The IRQ counter common to the VRC6 and VRC7 */
+void vrc_irq_reset();
+void vrc_irq_write_latch(uint8_t value);
+void vrc_irq_write_control(uint8_t value);
+void vrc_irq_acknowledge();
+void vrc_irq_clock(int cycles);
+
+/* IRQ counter variables, to be included in the VRC7 state */
+#define VRC_IRQ_STATES (4)
+extern const mapper_state vrc_irq_state[VRC_IRQ_STATES];
+
+#endif /* vrc6_h */
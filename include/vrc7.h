@@ -0,0 +1,17 @@
+#ifndef vrc7_h
+#define vrc7_h
+
+#include <stdint.h>
+
+#define VRC7_ID (85)
+
+/* Implementation of mapper struct function pointers */
+void vrc7_initialize_mapper();
+int  vrc7_check_address(uint16_t address, uint8_t value);
+void vrc7_switch_banks();
+void vrc7_reset();
+void vrc7_update();
+void vrc7_clock_cpu(int cycles);
+void vrc7_end_mapper();
+
+#endif /* vrc7_h */
@@ -25,6 +25,7 @@
 #include "clock.h"
 #include "cpu.h"
 #include "debug.h"
+#include "dma.h"
 #include "i18n.h"
 #include "imaconfig.h"
 #include "playback.h"
@@ -316,10 +317,8 @@ void clock_frame_sequencer() {
 
 	/* At any time, if the interrupt flag is set
 	 * and the IRQ disable is clear, CPU's IRQ is asserted */
-	if( APU->frame_seq.int_flag && !(APU->commons & DISABLE_FRAME_IRQ) ) {
-		CPU->SR &= ~B_FLAG;
-		execute_irq();
-	}
+	if( APU->frame_seq.int_flag && !(APU->commons & DISABLE_FRAME_IRQ) )
+		CPU->irq |= IRQ_FRAME;
 
 	/* Finally, we increase the step counter */
 	APU->frame_seq.step++;
@@ -508,8 +507,7 @@ void fill_dmc_sample_buffer() {
 
 	if( DMC->buffer_is_empty && DMC->dma_reader.bytes_remaining ) {
 
-		DMC->buffer = read_cpu_ram( DMC->dma_reader.address );
-		ADD_CPU_CYCLES(4);
+		DMC->buffer = dmc_dma( DMC->dma_reader.address );
 
 		/* Increment the address for the next read */
 		if( DMC->dma_reader.address == 0xFFFF )
@@ -526,7 +524,7 @@ void fill_dmc_sample_buffer() {
 				APU->dmc.dma_reader.bytes_remaining = APU->dmc.dma_reader.reset_bytes_remaining;
 			}
 			else if( DMC->int_flag )
-				execute_irq();
+				CPU->irq |= IRQ_DMC;
 
 		}
 
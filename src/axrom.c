@@ -0,0 +1,77 @@
+/*  ImaNES: I'm a NES. An intelligent NES emulator
+
+    axrom.c   -    AxROM Mapper emulation under ImaNES
+
+    Copyright (C) 2009   Rodrigo Tobar Carrizo
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "axrom.h"
+#include "cpu.h"
+#include "debug.h"
+#include "i18n.h"
+#include "mapper.h"
+#include "ppu.h"
+
+void axrom_initialize_mapper() {
+	mapper->regs = (uint8_t *)malloc(1);
+	mapper->regs[0] = 0;
+	return;
+}
+
+int axrom_check_address(uint16_t address, uint8_t value) {
+
+	if( 0x8000 <= address ) {
+		mapper->regs[0] = value;
+		return 1;
+	}
+
+	return 0;
+}
+
+void axrom_switch_banks() {
+
+	int bank;
+	int banks32k;
+
+	/* Bits 0-2 select a 32kb bank, bit 4 selects the name table page */
+	banks32k = mapper->file->romBanks16k/2;
+	bank = (mapper->regs[0] & 0x07) % (banks32k ? banks32k : 1);
+	DEBUG( printf(_("AxROM: Switching to 32 Kb ROM bank %d\n"), bank) );
+	SWAP_RAM_16K(0x8000, bank*2);
+	SWAP_RAM_16K(0xC000, bank*2 + 1);
+
+	if( mapper->regs[0] & 0x10 )
+		PPU->mirroring = SINGLE_SCREEN_MIRRORING_B;
+	else
+		PPU->mirroring = SINGLE_SCREEN_MIRRORING_A;
+}
+
+void axrom_reset() {
+
+	/* AxROM boards have CHR RAM, so only the PRG is switched */
+	axrom_switch_banks();
+}
+
+void axrom_update() {
+	return;
+}
+
+void axrom_end_mapper() {
+	free(mapper->regs);
+}
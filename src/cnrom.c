@@ -33,12 +33,12 @@ void cnrom_initialize_mapper() {
 	return;
 }
 
-int cnrom_check_address(uint16_t address) {
+int cnrom_check_address(uint16_t address, uint8_t value) {
 
 	/* It is not necessary to check <= 0xFFFF because of the data range
 	 * of a uint16_t :) */
 	if( 0x8000 <= address ) {
-		mapper->regs[0] = CPU->RAM[address] & 0x7;
+		mapper->regs[0] = value & 0x7;
 		return 1;
 	}
 
@@ -49,19 +49,19 @@ void cnrom_switch_banks() {
 
 	/* Copy the VROM bank to the 0x0000 of VRAM */
 	DEBUG( printf(_("Performing switch to bank %d of VROM\n"), mapper->regs[0]));
-	memcpy(PPU->VRAM, mapper->file->vrom + mapper->regs[0]*VROM_BANK_SIZE,
-	       VROM_BANK_SIZE);
+	SWAP_VRAM(0, mapper->file->vrom + mapper->regs[0]*VROM_BANK_SIZE,
+	          VROM_BANK_SIZE);
 
 }
 
 void cnrom_reset() 
 {
 	if( mapper->file->romBanks16k == 2 )
-		memcpy(CPU->RAM+0x8000, mapper->file->rom, ROM_BANK_SIZE*2);
+		SWAP_RAM(0x8000, mapper->file->rom, ROM_BANK_SIZE*2);
 	else
-		memcpy(CPU->RAM+0xC000, mapper->file->rom, ROM_BANK_SIZE);
+		SWAP_RAM(0xC000, mapper->file->rom, ROM_BANK_SIZE);
 
-	memcpy(PPU->VRAM, mapper->file->vrom, VROM_BANK_SIZE);
+	SWAP_VRAM(0, mapper->file->vrom, VROM_BANK_SIZE);
 }
 
 void cnrom_update() {
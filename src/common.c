@@ -23,7 +23,7 @@
 
 #include "platform.h"
 
-void inst_lowercase(char *inst_name, char *ret) {
+void inst_lowercase(const char *inst_name, char *ret) {
 
 	int i;
 
@@ -26,16 +26,18 @@
 #include "common.h"
 #include "cpu.h"
 #include "debug.h"
+#include "dma.h"
 #include "i18n.h"
 #include "instruction_set.h"
 #include "mapper.h"
 #include "pad.h"
 #include "palette.h"
 #include "ppu.h"
+#include "profiler.h"
 #include "screen.h"
+#include "telemetry.h"
+#include "trace.h"
 
-static int prev_a12_state  = 0;
-static int prev_a12_cycles = 0;
 nes_cpu *CPU;
 
 /**
@@ -56,7 +58,7 @@ inline void update_flags(int8_t value, uint8_t flags) {
 
 }
 
-void ADC_func(instruction *inst, operand *oper){
+void ADC_func(const instruction *inst, operand *oper){
 
 	uint16_t tmp16;
 
@@ -81,14 +83,14 @@ void ADC_func(instruction *inst, operand *oper){
 	update_flags(CPU->A, N_FLAG | Z_FLAG);
 }
 
-void AND_func(instruction *inst, operand *oper){
+void AND_func(const instruction *inst, operand *oper){
 	if( inst->addr_mode != ADDR_IMMEDIATE )
 		oper->value = read_cpu_ram(oper->address);
 	CPU->A &= oper->value;
 	update_flags(CPU->A, N_FLAG | Z_FLAG );
 }
 
-void ASL_func(instruction *inst, operand *oper){
+void ASL_func(const instruction *inst, operand *oper){
 
 	uint8_t tmp;
 
@@ -110,28 +112,28 @@ void ASL_func(instruction *inst, operand *oper){
 		CPU->SR &= ~C_FLAG;
 }
 
-void BCC_func(instruction *inst, operand *oper){
+void BCC_func(const instruction *inst, operand *oper){
 	if( ~CPU->SR & C_FLAG ) {
 		add_cycles(CYCLE_BRANCH, oper->value);
 		CPU->PC += (int8_t)oper->value;
 	}
 }
 
-void BCS_func(instruction *inst, operand *oper){
+void BCS_func(const instruction *inst, operand *oper){
 	if( CPU->SR & C_FLAG ) {
 		add_cycles(CYCLE_BRANCH, oper->value);
 		CPU->PC +=(int8_t)oper->value;
 	}
 }
 
-void BEQ_func(instruction *inst, operand *oper){
+void BEQ_func(const instruction *inst, operand *oper){
 	if( CPU->SR & Z_FLAG ) {
 		add_cycles(CYCLE_BRANCH, oper->value);
 		CPU->PC += (int8_t)oper->value;
 	}
 }
 
-void BIT_func(instruction *inst, operand *oper){
+void BIT_func(const instruction *inst, operand *oper){
 	oper->value = read_cpu_ram(oper->address);
 	if( (oper->value >> 6)  & 0x01 )
 		CPU->SR |= V_FLAG;
@@ -141,64 +143,64 @@ void BIT_func(instruction *inst, operand *oper){
 	update_flags(oper->value & CPU->A, Z_FLAG);
 }
 
-void BMI_func(instruction *inst, operand *oper){
+void BMI_func(const instruction *inst, operand *oper){
 	if( CPU->SR & N_FLAG ) {
 		add_cycles(CYCLE_BRANCH, oper->value);
 		CPU->PC += (int8_t)oper->value;
 	}
 }
 
-void BNE_func(instruction *inst, operand *oper){
+void BNE_func(const instruction *inst, operand *oper){
 	if( ~CPU->SR & Z_FLAG ) {
 		add_cycles(CYCLE_BRANCH, oper->value);
 		CPU->PC += (int8_t)oper->value;
 	}
 }
 
-void BPL_func(instruction *inst, operand *oper){
+void BPL_func(const instruction *inst, operand *oper){
 	if( ~CPU->SR & N_FLAG ) {
 		add_cycles(CYCLE_BRANCH, oper->value);
 		CPU->PC += (int8_t)oper->value;
 	}
 }
 
-void BRK_func(instruction *inst, operand *oper){
+void BRK_func(const instruction *inst, operand *oper){
 	CPU->SR |= B_FLAG;
 	execute_irq();
 	CPU->PC -= inst->size;
 }
 
-void BVC_func(instruction *inst, operand *oper){
+void BVC_func(const instruction *inst, operand *oper){
 	if( ~CPU->SR & V_FLAG ) {
 		add_cycles(CYCLE_BRANCH, oper->value);
 		CPU->PC += (int8_t)oper->value;
 	}
 }
 
-void BVS_func(instruction *inst, operand *oper){
+void BVS_func(const instruction *inst, operand *oper){
 	if( CPU->SR & V_FLAG ) {
 		add_cycles(CYCLE_BRANCH, oper->value);
 		CPU->PC += (int8_t)oper->value;
 	}
 }
 
-void CLC_func(instruction *inst, operand *oper){
+void CLC_func(const instruction *inst, operand *oper){
 	CPU->SR &= ~C_FLAG;
 }
 
-void CLD_func(instruction *inst, operand *oper){
+void CLD_func(const instruction *inst, operand *oper){
 	CPU->SR &= ~D_FLAG;
 }
 
-void CLI_func(instruction *inst, operand *oper){
+void CLI_func(const instruction *inst, operand *oper){
 	CPU->SR &= ~I_FLAG;
 }
 
-void CLV_func(instruction *inst, operand *oper){
+void CLV_func(const instruction *inst, operand *oper){
 	CPU->SR &= ~V_FLAG;
 }
 
-void CMP_func(instruction *inst, operand *oper){
+void CMP_func(const instruction *inst, operand *oper){
 	if( inst->addr_mode != ADDR_IMMEDIATE )
 		oper->value = read_cpu_ram(oper->address);
 	if( CPU->A >= oper->value)
@@ -208,7 +210,7 @@ void CMP_func(instruction *inst, operand *oper){
 	update_flags(CPU->A - oper->value, N_FLAG | Z_FLAG);
 }
 
-void CPX_func(instruction *inst, operand *oper){
+void CPX_func(const instruction *inst, operand *oper){
 	if( inst->addr_mode != ADDR_IMMEDIATE )
 		oper->value = read_cpu_ram(oper->address);
 	if( CPU->X >= oper->value)
@@ -218,7 +220,7 @@ void CPX_func(instruction *inst, operand *oper){
 	update_flags(CPU->X - oper->value, N_FLAG | Z_FLAG);
 }
 
-void CPY_func(instruction *inst, operand *oper){
+void CPY_func(const instruction *inst, operand *oper){
 	if( inst->addr_mode != ADDR_IMMEDIATE )
 		oper->value = read_cpu_ram(oper->address);
 	if( CPU->Y >= oper->value)
@@ -228,7 +230,7 @@ void CPY_func(instruction *inst, operand *oper){
 	update_flags(CPU->Y - oper->value, N_FLAG | Z_FLAG);
 }
 
-void DEC_func(instruction *inst, operand *oper){
+void DEC_func(const instruction *inst, operand *oper){
 
 	uint8_t tmp;
 
@@ -237,24 +239,24 @@ void DEC_func(instruction *inst, operand *oper){
 	update_flags( tmp , N_FLAG | Z_FLAG);
 }
 
-void DEX_func(instruction *inst, operand *oper){
+void DEX_func(const instruction *inst, operand *oper){
 	CPU->X--;
 	update_flags(CPU->X, N_FLAG | Z_FLAG);
 }
 
-void DEY_func(instruction *inst, operand *oper){
+void DEY_func(const instruction *inst, operand *oper){
 	CPU->Y--;
 	update_flags(CPU->Y, N_FLAG | Z_FLAG);
 }
 
-void EOR_func(instruction *inst, operand *oper){
+void EOR_func(const instruction *inst, operand *oper){
 	if( inst->addr_mode != ADDR_IMMEDIATE )
 		oper->value = read_cpu_ram(oper->address);
 	CPU->A ^= oper->value;
 	update_flags(CPU->A, N_FLAG | Z_FLAG);
 }
 
-void INC_func(instruction *inst, operand *oper){
+void INC_func(const instruction *inst, operand *oper){
 
 	uint8_t tmp;
 
@@ -263,48 +265,48 @@ void INC_func(instruction *inst, operand *oper){
 	update_flags(tmp, N_FLAG | Z_FLAG);
 }
 
-void INX_func(instruction *inst, operand *oper){
+void INX_func(const instruction *inst, operand *oper){
 	CPU->X++;
 	update_flags(CPU->X, N_FLAG | Z_FLAG);
 }
 
-void INY_func(instruction *inst, operand *oper){
+void INY_func(const instruction *inst, operand *oper){
 	CPU->Y++;
 	update_flags(CPU->Y, N_FLAG | Z_FLAG);
 }
 
-void JMP_func(instruction *inst, operand *oper){
+void JMP_func(const instruction *inst, operand *oper){
 	CPU->PC = oper->address - inst->size;
 }
 
-void JSR_func(instruction *inst, operand *oper){
+void JSR_func(const instruction *inst, operand *oper){
 	stack_push( (CPU->PC+2) >> 8 );
 	stack_push( (CPU->PC+2) & 0xFF );
 	CPU->PC = oper->address - inst->size;
 }
 
-void LDA_func(instruction *inst, operand *oper){
+void LDA_func(const instruction *inst, operand *oper){
 	if( inst->addr_mode != ADDR_IMMEDIATE )
 		oper->value = read_cpu_ram(oper->address);
 	CPU->A = oper->value;
 	update_flags(CPU->A, N_FLAG | Z_FLAG);
 }
 
-void LDX_func(instruction *inst, operand *oper){
+void LDX_func(const instruction *inst, operand *oper){
 	if( inst->addr_mode != ADDR_IMMEDIATE )
 		oper->value = read_cpu_ram(oper->address);
 	CPU->X = oper->value;
 	update_flags(CPU->X, N_FLAG | Z_FLAG);
 }
 
-void LDY_func(instruction *inst, operand *oper){
+void LDY_func(const instruction *inst, operand *oper){
 	if( inst->addr_mode != ADDR_IMMEDIATE )
 		oper->value = read_cpu_ram(oper->address);
 	CPU->Y = oper->value;
 	update_flags(CPU->Y, N_FLAG | Z_FLAG);
 }
 
-void LSR_func(instruction *inst, operand *oper){
+void LSR_func(const instruction *inst, operand *oper){
 
 	uint8_t tmp;
 
@@ -326,36 +328,36 @@ void LSR_func(instruction *inst, operand *oper){
 		CPU->SR &= ~C_FLAG;
 }
 
-void NOP_func(instruction *inst, operand *oper){
+void NOP_func(const instruction *inst, operand *oper){
 }
 
-void ORA_func(instruction *inst, operand *oper){
+void ORA_func(const instruction *inst, operand *oper){
 	if( inst->addr_mode != ADDR_IMMEDIATE )
 		oper->value = read_cpu_ram(oper->address);
 	CPU->A |= oper->value;
 	update_flags(CPU->A, N_FLAG | Z_FLAG);
 }
 
-void PHA_func(instruction *inst, operand *oper){
+void PHA_func(const instruction *inst, operand *oper){
 	stack_push( CPU->A );
 }
 
-void PHP_func(instruction *inst, operand *oper){
+void PHP_func(const instruction *inst, operand *oper){
 	CPU->SR |= B_FLAG;
 	stack_push( CPU->SR );
 }
 
-void PLA_func(instruction *inst, operand *oper){
+void PLA_func(const instruction *inst, operand *oper){
 	CPU->A = stack_pull();
 	update_flags(CPU->A, N_FLAG | Z_FLAG);
 }
 
-void PLP_func(instruction *inst, operand *oper){
+void PLP_func(const instruction *inst, operand *oper){
 	CPU->SR = stack_pull();
 	CPU->SR |= R_FLAG; /* R_FLAG should be _always_ set */
 }
 
-void ROL_func(instruction *inst, operand *oper){
+void ROL_func(const instruction *inst, operand *oper){
 
 	uint8_t tmp;
 
@@ -378,7 +380,7 @@ void ROL_func(instruction *inst, operand *oper){
 		CPU->SR &= ~C_FLAG;
 }
 
-void ROR_func(instruction *inst, operand *oper){
+void ROR_func(const instruction *inst, operand *oper){
 
 	uint8_t tmp;
 
@@ -401,7 +403,7 @@ void ROR_func(instruction *inst, operand *oper){
 		CPU->SR &= ~C_FLAG;
 }
 
-void RTI_func(instruction *inst, operand *oper){
+void RTI_func(const instruction *inst, operand *oper){
 	CPU->SR =  stack_pull();
 	CPU->SR |= R_FLAG; /* R_FLAG should be _always_ set */
 	CPU->PC =  stack_pull();
@@ -409,14 +411,14 @@ void RTI_func(instruction *inst, operand *oper){
 	CPU->PC -= inst->size;
 }
 
-void RTS_func(instruction *inst, operand *oper){
+void RTS_func(const instruction *inst, operand *oper){
 	CPU->PC =  stack_pull();
 	CPU->PC |= stack_pull() << 8;
 	CPU->PC++;
 	CPU->PC -= inst->size;
 }
 
-void SBC_func(instruction *inst, operand *oper){
+void SBC_func(const instruction *inst, operand *oper){
 
 	uint16_t tmp16;
 
@@ -442,61 +444,61 @@ void SBC_func(instruction *inst, operand *oper){
 	update_flags(CPU->A, N_FLAG | Z_FLAG);
 }
 
-void SEC_func(instruction *inst, operand *oper){
+void SEC_func(const instruction *inst, operand *oper){
 	CPU->SR |= C_FLAG;
 }
 
-void SED_func(instruction *inst, operand *oper){
+void SED_func(const instruction *inst, operand *oper){
 	CPU->SR |= D_FLAG;
 }
 
-void SEI_func(instruction *inst, operand *oper){
+void SEI_func(const instruction *inst, operand *oper){
 	CPU->SR |= I_FLAG;
 }
 
-void STA_func(instruction *inst, operand *oper){
+void STA_func(const instruction *inst, operand *oper){
 	write_cpu_ram(oper->address, CPU->A);
 }
 
-void STX_func(instruction *inst, operand *oper){
+void STX_func(const instruction *inst, operand *oper){
 	write_cpu_ram(oper->address, CPU->X);
 }
 
-void STY_func(instruction *inst, operand *oper){
+void STY_func(const instruction *inst, operand *oper){
 	write_cpu_ram(oper->address, CPU->Y);
 }
 
-void TAX_func(instruction *inst, operand *oper){
+void TAX_func(const instruction *inst, operand *oper){
 	CPU->X = CPU->A;
 	update_flags(CPU->X, N_FLAG | Z_FLAG);
 }
 
-void TAY_func(instruction *inst, operand *oper){
+void TAY_func(const instruction *inst, operand *oper){
 	CPU->Y = CPU->A;
 	update_flags(CPU->Y, N_FLAG | Z_FLAG);
 }
 
-void TSX_func(instruction *inst, operand *oper){
+void TSX_func(const instruction *inst, operand *oper){
 	CPU->X = CPU->SP;
 	update_flags(CPU->X, N_FLAG | Z_FLAG);
 }
 
-void TXA_func(instruction *inst, operand *oper){
+void TXA_func(const instruction *inst, operand *oper){
 	CPU->A = CPU->X;
 	update_flags(CPU->A, N_FLAG | Z_FLAG);
 }
 
-void TXS_func(instruction *inst, operand *oper){
+void TXS_func(const instruction *inst, operand *oper){
 	CPU->SP = CPU->X;
 }
 
-void TYA_func(instruction *inst, operand *oper){
+void TYA_func(const instruction *inst, operand *oper){
 	CPU->A = CPU->Y;
 	update_flags(CPU->A, N_FLAG | Z_FLAG);
 }
 
 /** Illegal opcodes **/
-void ANC_func(instruction *inst, operand *oper){
+void ANC_func(const instruction *inst, operand *oper){
 	CPU->A &= oper->value;
 	if( (int8_t)CPU->A < 0 )
 		CPU->SR |= C_FLAG;
@@ -505,7 +507,7 @@ void ANC_func(instruction *inst, operand *oper){
 	update_flags(CPU->A, N_FLAG | Z_FLAG );
 }
 
-void ALR_func(instruction *inst, operand *oper){
+void ALR_func(const instruction *inst, operand *oper){
 	CPU->A &= oper->value;
 	if( CPU->A & 0x01 )
 		CPU->SR |= C_FLAG;
@@ -515,7 +517,7 @@ void ALR_func(instruction *inst, operand *oper){
 	update_flags(CPU->A, N_FLAG | Z_FLAG );
 }
 
-void ARR_func(instruction *inst, operand *oper){
+void ARR_func(const instruction *inst, operand *oper){
 	CPU->A &= oper->value;
 	CPU->A >>= 1;
 	CPU->A |= (CPU->SR & C_FLAG) << 7;
@@ -530,7 +532,7 @@ void ARR_func(instruction *inst, operand *oper){
 	update_flags(CPU->A, N_FLAG | Z_FLAG );
 }
 
-void DCP_func(instruction *inst, operand *oper){
+void DCP_func(const instruction *inst, operand *oper){
 
 	uint8_t tmp;
 
@@ -543,7 +545,7 @@ void DCP_func(instruction *inst, operand *oper){
 	update_flags(CPU->A - tmp, N_FLAG | Z_FLAG);
 }
 
-void ISC_func(instruction *inst, operand *oper){
+void ISC_func(const instruction *inst, operand *oper){
 
 	uint8_t  tmp;
 	uint16_t tmp16;
@@ -571,7 +573,7 @@ void ISC_func(instruction *inst, operand *oper){
 	update_flags(CPU->A, N_FLAG | Z_FLAG);
 }
 
-void LAX_func(instruction *inst, operand *oper){
+void LAX_func(const instruction *inst, operand *oper){
 	if( inst->addr_mode != ADDR_IMMEDIATE )
 		oper->value = read_cpu_ram(oper->address);
 	CPU->A = oper->value;
@@ -579,7 +581,7 @@ void LAX_func(instruction *inst, operand *oper){
 	update_flags(CPU->A, N_FLAG | Z_FLAG);
 }
 
-void RLA_func(instruction *inst, operand *oper){
+void RLA_func(const instruction *inst, operand *oper){
 
 	uint8_t tmp;
 
@@ -596,7 +598,7 @@ void RLA_func(instruction *inst, operand *oper){
 	update_flags(CPU->A, N_FLAG | Z_FLAG);
 }
 
-void RRA_func(instruction *inst, operand *oper){
+void RRA_func(const instruction *inst, operand *oper){
 
 	uint8_t  tmp;
 	uint16_t tmp16;
@@ -633,7 +635,7 @@ void RRA_func(instruction *inst, operand *oper){
 	update_flags(CPU->A, N_FLAG | Z_FLAG);
 }
 
-void SAX_func(instruction *inst, operand *oper){
+void SAX_func(const instruction *inst, operand *oper){
 
 	uint8_t tmp;
 
@@ -642,7 +644,7 @@ void SAX_func(instruction *inst, operand *oper){
 	update_flags(tmp, N_FLAG | Z_FLAG);
 }
 
-void SBX_func(instruction *inst, operand *oper){
+void SBX_func(const instruction *inst, operand *oper){
 	CPU->X = CPU->A & CPU->X;
 
 	if( CPU->X >= oper->value)
@@ -653,7 +655,7 @@ void SBX_func(instruction *inst, operand *oper){
 	update_flags(CPU->X, N_FLAG | Z_FLAG);
 }
 
-void SHX_func(instruction *inst, operand *oper){
+void SHX_func(const instruction *inst, operand *oper){
 
 	uint8_t tmp;
 
@@ -661,7 +663,7 @@ void SHX_func(instruction *inst, operand *oper){
 	write_cpu_ram(oper->address, tmp);
 }
 
-void SHY_func(instruction *inst, operand *oper){
+void SHY_func(const instruction *inst, operand *oper){
 
 	uint8_t tmp;
 
@@ -669,7 +671,7 @@ void SHY_func(instruction *inst, operand *oper){
 	write_cpu_ram(oper->address, tmp);
 }
 
-void SLO_func(instruction *inst, operand *oper){
+void SLO_func(const instruction *inst, operand *oper){
 	oper->value = read_cpu_ram(oper->address);
 	if( oper->value & 0x80 )
 		CPU->SR |= C_FLAG;
@@ -681,7 +683,7 @@ void SLO_func(instruction *inst, operand *oper){
 	update_flags(CPU->A, N_FLAG | Z_FLAG);
 }
 
-void SRE_func(instruction *inst, operand *oper){
+void SRE_func(const instruction *inst, operand *oper){
 	oper->value = read_cpu_ram(oper->address);
 	if( oper->value & 0x01 )
 		CPU->SR |= C_FLAG;
@@ -693,87 +695,10 @@ void SRE_func(instruction *inst, operand *oper){
 	update_flags(CPU->A, N_FLAG | Z_FLAG);
 }
 
-void default_func(instruction *inst, operand *oper){
+void default_func(const instruction *inst, operand *oper){
 	fprintf(stderr,_("%s: Still unimplemented\n"), inst->name);
 }
 
-void (*ptr_to_inst[INSTRUCTIONS_NUMBER])(instruction *, operand *) = {
-	&ADC_func,
-	&AND_func,
-	&ASL_func,
-	&BCC_func,
-	&BCS_func,
-	&BEQ_func,
-	&BIT_func,
-	&BMI_func,
-	&BNE_func,
-	&BPL_func,
-	&BRK_func,
-	&BVC_func,
-	&BVS_func,
-	&CLC_func,
-	&CLD_func,
-	&CLI_func,
-	&CLV_func,
-	&CMP_func,
-	&CPX_func,
-	&CPY_func,
-	&DEC_func,
-	&DEX_func,
-	&DEY_func,
-	&EOR_func,
-	&INC_func,
-	&INX_func,
-	&INY_func,
-	&JMP_func,
-	&JSR_func,
-	&LDA_func,
-	&LDX_func,
-	&LDY_func,
-	&LSR_func,
-	&NOP_func,
-	&ORA_func,
-	&PHA_func,
-	&PHP_func,
-	&PLA_func,
-	&PLP_func,
-	&ROL_func,
-	&ROR_func,
-	&RTI_func,
-	&RTS_func,
-	&SBC_func,
-	&SEC_func,
-	&SED_func,
-	&SEI_func,
-	&STA_func,
-	&STX_func,
-	&STY_func,
-	&TAX_func,
-	&TAY_func,
-	&TSX_func,
-	&TXA_func,
-	&TXS_func,
-	&TYA_func,
-	&default_func,
-	&ANC_func,
-	&ALR_func,
-	&ARR_func,
-	&DCP_func,
-	&ISC_func,
-	&default_func,
-	&LAX_func,
-	&RLA_func,
-	&RRA_func,
-	&SAX_func,
-	&SBX_func,
-	&SHX_func,
-	&SHY_func,
-	&SLO_func,
-	&SRE_func,
-	&default_func,
-	&default_func
-};
-
 /* Reads the first PPU Control Register (0x2000) */
 uint8_t _read_ppu_cr1(uint16_t address) {
 	return PPU->CR1;
@@ -814,6 +739,8 @@ uint8_t _read_ppu_vram(uint16_t address) {
 	uint8_t ret_val = 0;
 	static uint8_t buffer = 0; /* Buffer when reading from 0x2007 */
 
+	COUNT(vram_accesses, 1);
+
 	if( PPU->vram_addr < 0x3F00 ) {
 		ret_val = buffer;
 		buffer = read_ppu_vram(PPU->vram_addr);
@@ -828,14 +755,8 @@ uint8_t _read_ppu_vram(uint16_t address) {
 	else
 		PPU->vram_addr++;
 
-	/* Check rising edge of A12 on PPU bus (needed by MMC3) */
-	if( (PPU->vram_addr & 0x1000) &&
-		!prev_a12_state )
-		mapper->update();
-
-	/* Save the A12 line status (needed by MMC3) */
-	prev_a12_state  = PPU->vram_addr & 0x1000;
-	prev_a12_cycles = CLK->ppu_cycles;
+	/* The new address goes through the PPU bus (A12 is needed by MMC3) */
+	a12_bus_access(PPU->vram_addr);
 
 	return ret_val;
 }
@@ -854,6 +775,7 @@ uint8_t _read_apu_sr(uint16_t address) {
 
 	/* Finally, clear the FS interrupt flag */
 	APU->frame_seq.int_flag = 0;
+	CPU->irq &= ~IRQ_FRAME;
 
 	return ret_val;
 }
@@ -865,7 +787,7 @@ uint8_t _read_joystick1(uint16_t address) {
 
 	/* If we should return a key state... */
 	if( pads[0].reads < 8 )
-		ret_val = ((pads[0].pressed_keys >> (pads[0].reads)) & 0x1);
+		ret_val = ((pads[0].latched >> (pads[0].reads)) & 0x1);
 
 	/* This is the signature */
 	else if ( pads[0].reads == 19 && pads[0].plugged )
@@ -885,7 +807,7 @@ uint8_t _read_joystick2(uint16_t address) {
 
 	/* If we should return a key state... */
 	if( pads[1].reads < 8 )
-		ret_val = ((pads[1].pressed_keys >> (pads[1].reads)) & 0x1);
+		ret_val = ((pads[1].latched >> (pads[1].reads)) & 0x1);
 
 	/* This is the signature */
 	else if ( pads[1].reads == 18 && pads[1].plugged )
@@ -915,6 +837,12 @@ uint8_t _read_ram(uint16_t address) {
 /* Normal RAM memory area */
 void _write_ram(uint16_t address, uint8_t value) {
 	CPU->RAM[address] = value;
+	DECODED_PAGE_WRITTEN(address);
+}
+
+/* PRG ROM can't be written, only the mapper listens to these writes */
+void _write_rom(uint16_t address, uint8_t value) {
+	return;
 }
 
 /* PPU Control Register 1 */
@@ -972,14 +900,8 @@ void _write_vram_address(uint16_t address, uint8_t value) {
 		PPU->temp_addr  = (PPU->temp_addr&0xFF00) | value;
 		PPU->vram_addr  = PPU->temp_addr;
 
-		/* Check rising edge of A12 on PPU bus (needed by MMC3) */
-		if( (PPU->vram_addr & 0x1000) &&
-		    !prev_a12_state )
-			mapper->update();
-
-		/* Save the A12 line status (needed by MMC3) */
-		prev_a12_state  = PPU->vram_addr & 0x1000;
-		prev_a12_cycles = CLK->ppu_cycles;
+		/* The new address goes through the PPU bus (A12 is needed by MMC3) */
+		a12_bus_access(PPU->vram_addr);
 		PPU->latch = 1;
 	}
 }
@@ -987,6 +909,8 @@ void _write_vram_address(uint16_t address, uint8_t value) {
 /* Data written into PPU->vram_address */
 void _write_vram_value(uint16_t address, uint8_t value) {
 
+	COUNT(vram_accesses, 1);
+
 	if( !(PPU->SR & IGNORE_VRAM_WRITE) ) {
 		write_ppu_vram(PPU->vram_addr, value);
 		if( PPU->CR1 & VERTICAL_WRITE)
@@ -994,14 +918,8 @@ void _write_vram_value(uint16_t address, uint8_t value) {
 		else
 			PPU->vram_addr++;
 
-		/* Check rising edge of A12 on PPU bus (needed by MMC3) */
-		if( (PPU->vram_addr & 0x1000) &&
-		    !prev_a12_state )
-			mapper->update();
-
-		/* Save the A12 line status (needed by MMC3) */
-		prev_a12_state  = PPU->vram_addr & 0x1000;
-		prev_a12_cycles = CLK->ppu_cycles;
+		/* The new address goes through the PPU bus (A12 is needed by MMC3) */
+		a12_bus_access(PPU->vram_addr);
 	}
 }
 
@@ -1166,6 +1084,8 @@ void _write_dmc_mode_frequency(uint16_t address, uint8_t value) {
 	APU->dmc.int_flag     = value & 0x80;
 	APU->dmc.loop         = value & 0x40;
 	APU->dmc.timer.period = dmc_timer_periods[value & 0x0F];
+	if( !APU->dmc.int_flag )
+		CPU->irq &= ~IRQ_DMC;
 }
 
 /* 0x4011: DMC's DAC value */
@@ -1185,13 +1105,7 @@ void _write_dmc_dma_bytes(uint16_t address, uint8_t value) {
 
 /* 0x4014: Sprite DMA */
 void _write_sprite_dma(uint16_t address, uint8_t value) {
-
-	int i;
-
-	address = value*0x100;
-	for(i=0;i!=256;i++)
-		PPU->SPR_RAM[PPU->spr_addr++] = read_cpu_ram(address+i);
-	ADD_CPU_CYCLES(512);
+	oam_dma(value);
 }
 
 /* 0x4015: APU lenght control flags */
@@ -1213,6 +1127,7 @@ void _write_apu_lc(uint16_t address, uint8_t value) {
 		APU->noise.lc.counter = 0;
 
 	APU->dmc.int_flag = 0;
+	CPU->irq &= ~IRQ_DMC;
 
 	/* DMC (re)start/stop */
 	if( value & 0x10 && !APU->dmc.dma_reader.bytes_remaining ) {
@@ -1233,8 +1148,7 @@ void _write_joystick_strobes(uint16_t address, uint8_t value) {
 		strobe_pad = 1;
 	else if( value == 0x00 && strobe_pad ) {
 		strobe_pad = 0;
-		pads[0].reads = 0;
-		pads[1].reads = 0;
+		latch_pads();
 	}
 }
 
@@ -1255,18 +1169,63 @@ void _write_apu_common(uint16_t address, uint8_t value) {
 			printf("[apu] APU mode set to %s\n", new_mode & STEP_MODE5 ? "5-steps" : "4-steps")
 	);
 	APU->commons = new_mode;
+	if( APU->commons & DISABLE_FRAME_IRQ ) {
+		APU->frame_seq.int_flag = 0;
+		CPU->irq &= ~IRQ_FRAME;
+	}
 
 	if( APU->commons & STEP_MODE5 )
 		clock_frame_sequencer();
 }
 
 
-static uint8_t (*read_cpu_ram_f[NES_RAM_SIZE])(uint16_t address);
-static void    (*write_cpu_ram_f[NES_RAM_SIZE])(uint16_t address, uint8_t value);
+/* Memory mapped registers, $2000-$2007 (mirrored up to $3FFF) */
+static uint8_t (* const read_ppu_f[PPU_REGISTERS])(uint16_t address) = {
+	&_read_ppu_cr1,     &_read_ppu_cr2,  &_read_ppu_st,   &_read_spr_ram_add,
+	&_read_spr_ram,     &_read_latch,    &_read_latch,    &_read_ppu_vram
+};
 
-void initialize_cpu() {
+static void (* const write_ppu_f[PPU_REGISTERS])(uint16_t address, uint8_t value) = {
+	&_write_ppu_cr1,        &_write_ppu_cr2,     &_write_ram,           &_write_spr_ram1,
+	&_write_spr_ram2,       &_write_ppu_scrolling, &_write_vram_address, &_write_vram_value
+};
+
+/* Memory mapped registers, $4000-$401F */
+static uint8_t (* const read_apu_f[APU_REGISTERS])(uint16_t address) = {
+	&_read_ram,         &_read_ram,      &_read_ram,      &_read_ram,
+	&_read_ram,         &_read_ram,      &_read_ram,      &_read_ram,
+	&_read_ram,         &_read_ram,      &_read_ram,      &_read_ram,
+	&_read_ram,         &_read_ram,      &_read_ram,      &_read_ram,
+	&_read_ram,         &_read_ram,      &_read_ram,      &_read_ram,
+	&_read_ram,         &_read_apu_sr,   &_read_joystick1, &_read_joystick2,
+	&_read_ram,         &_read_ram,      &_read_ram,      &_read_ram,
+	&_read_ram,         &_read_ram,      &_read_ram,      &_read_ram
+};
+
+static void (* const write_apu_f[APU_REGISTERS])(uint16_t address, uint8_t value) = {
+	&_write_square1_duty_env,   &_write_square1_sweep,
+	&_write_square1_period_low, &_write_square1_period_high_lc,
+	&_write_square2_duty_env,   &_write_square2_sweep,
+	&_write_square2_period_low, &_write_square2_period_high_lc,
+	&_write_tri_linearc_ctrl,   &_write_ram,
+	&_write_tri_period_low,     &_write_tri_period_high_lc,
+	&_write_noise_env,          &_write_ram,
+	&_write_noise_mode_period,  &_write_noise_lc,
+	&_write_dmc_mode_frequency, &_write_dmc_dac,
+	&_write_dmc_dma_address,    &_write_dmc_dma_bytes,
+	&_write_sprite_dma,         &_write_apu_lc,
+	&_write_joystick_strobes,   &_write_apu_common,
+	&_write_ram,                &_write_ram,
+	&_write_ram,                &_write_ram,
+	&_write_ram,                &_write_ram,
+	&_write_ram,                &_write_ram
+};
 
-	unsigned int i = 0;
+/* Mapper registers in the expansion area ($4020-$5FFF).
+ * Addresses without one just read the RAM */
+static uint8_t (*read_expansion_f[EXPANSION_SIZE])(uint16_t address);
+
+void initialize_cpu() {
 
 	CPU = (nes_cpu *)malloc(sizeof(nes_cpu));
 	CPU->A = 0;
@@ -1280,63 +1239,15 @@ void initialize_cpu() {
 	CPU->reset = 1;
 	CPU->sram_enabled = 0;
 	CPU->sram_enabled &= ~SRAM_ENABLE;
-
-	/* The default is to call _read_ram when reading the RAM */
-	for(i=0; i!= NES_RAM_SIZE; i++)
-		read_cpu_ram_f[i] = &_read_ram;
-
-	for(i=0x6000; i!=0x8000; i++)
-		read_cpu_ram_f[i] = &_read_sram;
-
-	read_cpu_ram_f[0x2000] = &_read_ppu_cr1;
-	read_cpu_ram_f[0x2001] = &_read_ppu_cr2;
-	read_cpu_ram_f[0x2002] = &_read_ppu_st;
-	read_cpu_ram_f[0x2003] = &_read_spr_ram_add;
-	read_cpu_ram_f[0x2004] = &_read_spr_ram;
-	read_cpu_ram_f[0x2005] = &_read_latch;
-	read_cpu_ram_f[0x2006] = &_read_latch;
-	read_cpu_ram_f[0x2007] = &_read_ppu_vram;
-	read_cpu_ram_f[0x4015] = &_read_apu_sr;
-	read_cpu_ram_f[0x4016] = &_read_joystick1;
-	read_cpu_ram_f[0x4017] = &_read_joystick2;
-
-
-	/* The default is to call _read_ram when reading the RAM */
-	for(i=0; i!= NES_RAM_SIZE; i++)
-		write_cpu_ram_f[i] = &_write_ram;
-	write_cpu_ram_f[0x2000] = &_write_ppu_cr1;
-	write_cpu_ram_f[0x2001] = &_write_ppu_cr2;
-	write_cpu_ram_f[0x2003] = &_write_spr_ram1;
-	write_cpu_ram_f[0x2004] = &_write_spr_ram2;
-	write_cpu_ram_f[0x2005] = &_write_ppu_scrolling;
-	write_cpu_ram_f[0x2006] = &_write_vram_address;
-	write_cpu_ram_f[0x2007] = &_write_vram_value;
-	write_cpu_ram_f[0x4000] = &_write_square1_duty_env;
-	write_cpu_ram_f[0x4001] = &_write_square1_sweep;
-	write_cpu_ram_f[0x4002] = &_write_square1_period_low;
-	write_cpu_ram_f[0x4003] = &_write_square1_period_high_lc;
-	write_cpu_ram_f[0x4004] = &_write_square2_duty_env;
-	write_cpu_ram_f[0x4005] = &_write_square2_sweep;
-	write_cpu_ram_f[0x4006] = &_write_square2_period_low;
-	write_cpu_ram_f[0x4007] = &_write_square2_period_high_lc;
-	write_cpu_ram_f[0x4008] = &_write_tri_linearc_ctrl;
-	write_cpu_ram_f[0x400A] = &_write_tri_period_low;
-	write_cpu_ram_f[0x400B] = &_write_tri_period_high_lc;
-	write_cpu_ram_f[0x400C] = &_write_noise_env;
-	write_cpu_ram_f[0x400E] = &_write_noise_mode_period;
-	write_cpu_ram_f[0x400F] = &_write_noise_lc;
-	write_cpu_ram_f[0x4010] = &_write_dmc_mode_frequency;
-	write_cpu_ram_f[0x4011] = &_write_dmc_dac;
-	write_cpu_ram_f[0x4012] = &_write_dmc_dma_address;
-	write_cpu_ram_f[0x4013] = &_write_dmc_dma_bytes;
-	write_cpu_ram_f[0x4014] = &_write_sprite_dma;
-	write_cpu_ram_f[0x4015] = &_write_apu_lc;
-	write_cpu_ram_f[0x4016] = &_write_joystick_strobes;
-	write_cpu_ram_f[0x4017] = &_write_apu_common;
+	CPU->irq = 0;
 
 	return;
 }
 
+void set_read_cpu_ram_f(uint16_t address, uint8_t (*read_f)(uint16_t address)) {
+	read_expansion_f[address - EXPANSION_START] = read_f;
+}
+
 void dump_cpu() {
 
 	printf("A:%02x  ", CPU->A);
@@ -1398,8 +1309,8 @@ void init_cpu_ram(ines_file *file) {
 	mapper->reset();
 }
 
-void execute_instruction(instruction *inst, operand *oper) {
-	(*ptr_to_inst[inst->instr_id])(inst, oper);
+void execute_instruction(const instruction *inst, operand *oper) {
+	inst->handler(inst, oper);
 }
 
 void write_cpu_ram(uint16_t address, uint8_t value) {
@@ -1430,11 +1341,21 @@ void write_cpu_ram(uint16_t address, uint8_t value) {
 		return;
 	}
 
+	if( 0x2000 <= address ) {
+		CPU->io_access = 1;
+		PROFILE_IO(address, 1);
+	}
+
 	/* Call the actual implementation for the given address */
-	(*write_cpu_ram_f[address])(address, value);
+	if( address < 0x2000 || (EXPANSION_START <= address && address < 0x8000) )
+		_write_ram(address, value);
+	else if( address < 0x4000 )
+		(*write_ppu_f[address & (PPU_REGISTERS-1)])(address, value);
+	else if( address < EXPANSION_START )
+		(*write_apu_f[address & (APU_REGISTERS-1)])(address, value);
 
 	/* Check if mapper need to come into action */
-	if( mapper->check_address(address) ) {
+	if( mapper->check_address(address, value) ) {
 		mapper->switch_banks();
 		return;
 	}
@@ -1466,10 +1387,24 @@ uint8_t read_cpu_ram(uint16_t address) {
 		DEBUG( printf("%04x\n",address) );
 	}
 
-	/* Read the value using the corresponding function pointer       */
-	/* Otherwise (without function pointers) we couldn't inline this */
-	/* method, as it would be too big (inlining to be done)          */
-	ret_val = (*read_cpu_ram_f[address])(address);
+	/* Only the registers need a function, the rest is plain memory */
+	if( address < 0x2000 || 0x8000 <= address )
+		ret_val = CPU->RAM[address];
+	else if( 0x6000 <= address )
+		ret_val = _read_sram(address);
+	else {
+		CPU->io_access = 1;
+		PROFILE_IO(address, 0);
+
+		if( address < 0x4000 )
+			ret_val = (*read_ppu_f[address & (PPU_REGISTERS-1)])(address);
+		else if( address < EXPANSION_START )
+			ret_val = (*read_apu_f[address & (APU_REGISTERS-1)])(address);
+		else if( read_expansion_f[address - EXPANSION_START] != NULL )
+			ret_val = (*read_expansion_f[address - EXPANSION_START])(address);
+		else
+			ret_val = CPU->RAM[address];
+	}
 
 	XTREME( printf(_("Returning %02x from %04x\n"), ret_val, address) );
 	return ret_val;
@@ -1498,6 +1433,8 @@ void execute_nmi() {
 	 * the interrupt flag on the processor status register */
 	DEBUG( printf(_("Executing NMI!\n")) );
 
+	PROFILE_INTERRUPT(PROFILE_NMI);
+
 	/* NMI clears the B_FLAG from CPU status */
 	CPU->SR &= ~B_FLAG;
 
@@ -1513,12 +1450,15 @@ void execute_nmi() {
 
 void execute_reset() {
 
+	PROFILE_INTERRUPT(PROFILE_RESET);
+
 	/* Let the mapper do its stuff */
 	mapper->reset();
 
 	/* Now, let's search for the RESET vector and point CPU->PC there */
 	CPU->PC = *(CPU->RAM + 0xFFFC) | ( *(CPU->RAM + 0xFFFD) << 8 );
 	CPU->reset = 0;
+	CPU->irq = 0;
 }
 
 /* This is called by BRK and mappers IRQ triggers */
@@ -1536,6 +1476,25 @@ void execute_irq() {
 
 }
 
+/* This is called between instructions for hardware IRQs */
+void check_irq_line() {
+
+	if( !CPU->irq || (CPU->SR & I_FLAG) )
+		return;
+
+	PROFILE_INTERRUPT(PROFILE_IRQ);
+
+	/* Unlike BRK, the return address is the next instruction
+	 * and the pushed status has the B flag cleared */
+	stack_push( (CPU->PC >> 8) & 0xFF );
+	stack_push( CPU->PC & 0xFF );
+	stack_push( CPU->SR & ~B_FLAG );
+	CPU->SR |= I_FLAG;
+	CPU->PC = ( CPU->RAM[0xFFFE] | ( CPU->RAM[0xFFFF]<<8 ) );
+
+	ADD_CPU_CYCLES(7);
+}
+
 void add_cycles(uint8_t type, int8_t value) {
 
 	if( type == CYCLE_BRANCH ) {
@@ -1552,6 +1511,141 @@ void add_cycles(uint8_t type, int8_t value) {
 
 }
 
+int skip_idle_loop(int budget) {
+
+	uint16_t address;
+	uint16_t branch;
+	uint8_t value;
+	uint8_t flags;
+	int taken;
+	int base;
+	int cycles;
+	int iterations;
+	const instruction *load;
+	const instruction *jump;
+
+	load = &instructions[CPU->RAM[CPU->PC]];
+	address = CPU->RAM[(uint16_t)(CPU->PC+1)];
+	if( load->addr_mode == ADDR_ABSOLUTE )
+		address |= CPU->RAM[(uint16_t)(CPU->PC+2)] << 8;
+
+	/* JMP to itself */
+	if( load->instr_id == JMP && load->addr_mode == ADDR_ABSOLUTE ) {
+		if( address != CPU->PC || (iterations = budget/load->cycles) <= 0 )
+			return 0;
+		ADD_CPU_CYCLES(iterations*load->cycles);
+		COUNT(instructions, iterations);
+		return iterations*load->cycles;
+	}
+
+	/* Otherwise, a load followed by a branch back to it */
+	if( (load->instr_id != LDA && load->instr_id != LDX &&
+	     load->instr_id != LDY && load->instr_id != BIT) ||
+	    (load->addr_mode != ADDR_ZEROPAGE && load->addr_mode != ADDR_ABSOLUTE) )
+		return 0;
+
+	branch = CPU->PC + load->size;
+	jump = &instructions[CPU->RAM[branch]];
+	if( jump->cycle_change != CYCLE_BRANCH ||
+	    (uint16_t)(branch + 2 + (int8_t)CPU->RAM[(uint16_t)(branch+1)]) != CPU->PC )
+		return 0;
+
+	/* Only values that can't change until the next event. $2002 is read
+	 * without side effects when VBLANK is clear and the latch is reset */
+	if( address < 0x2000 )
+		value = CPU->RAM[address & 0x7FF];
+	else if( address == 0x2002 && !(PPU->SR & VBLANK_FLAG) && PPU->latch == 1 )
+		value = PPU->SR;
+	else
+		return 0;
+
+	flags = (CPU->SR & ~(N_FLAG | Z_FLAG)) | (value & N_FLAG);
+	if( load->instr_id == BIT ) {
+		flags = (flags & ~V_FLAG) | (value & V_FLAG);
+		if( !(value & CPU->A) )
+			flags |= Z_FLAG;
+	}
+	else if( !value )
+		flags |= Z_FLAG;
+
+	switch( jump->instr_id ) {
+		case BPL: taken = !(flags & N_FLAG); break;
+		case BMI: taken =  (flags & N_FLAG); break;
+		case BVC: taken = !(flags & V_FLAG); break;
+		case BVS: taken =  (flags & V_FLAG); break;
+		case BCC: taken = !(flags & C_FLAG); break;
+		case BCS: taken =  (flags & C_FLAG); break;
+		case BNE: taken = !(flags & Z_FLAG); break;
+		case BEQ: taken =  (flags & Z_FLAG); break;
+		default:  taken = 0; break;
+	}
+	if( !taken )
+		return 0;
+
+	/* Taken branches add their extra cycles apart, like add_cycles() */
+	base = load->cycles + jump->cycles;
+	cycles = base + ( ((branch+2)&0x100) == (CPU->PC&0x100) ? 1 : 2 );
+	if( (iterations = budget/cycles) <= 0 )
+		return 0;
+
+	switch( load->instr_id ) {
+		case LDA: CPU->A = value; break;
+		case LDX: CPU->X = value; break;
+		case LDY: CPU->Y = value; break;
+	}
+	CPU->SR = flags;
+
+	ADD_CPU_CYCLES(iterations*cycles);
+	COUNT(instructions, 2*iterations);
+	return iterations*base;
+}
+
+int run_until(unsigned long int deadline) {
+
+	int budget;
+	int cycles = 0;
+	int done;
+	decoded_inst *d;
+	operand oper;
+
+	CPU->io_access = 0;
+	while( !CPU->io_access && !(CPU->irq && !(CPU->SR & I_FLAG)) &&
+	       CLK->ppu_cycles < deadline ) {
+
+		budget = (int)(deadline - CLK->ppu_cycles)/3;
+
+		if( config.skip_idle_loops && (done = skip_idle_loop(budget)) ) {
+			cycles += done;
+			continue;
+		}
+		if( config.translate_blocks && (done = execute_block(budget)) ) {
+			cycles += done;
+			continue;
+		}
+
+		/* Taken branches and page crossings may add up to 2 cycles.
+		 * Undocumented instructions are left to the main loop */
+		d = fetch_decoded(CPU->PC);
+		if( d->inst->size == 0 || d->inst->cycles + 2 > budget )
+			break;
+
+		TRACE_INSTRUCTION();
+		PROFILE_INSTRUCTION();
+		if( d->dynamic )
+			get_operand(d->inst, &oper);
+		else
+			oper = d->oper;
+
+		d->handler(d->inst, &oper);
+		CPU->PC += d->inst->size;
+		ADD_CPU_CYCLES(d->inst->cycles);
+		cycles += d->inst->cycles;
+		COUNT(instructions, 1);
+	}
+
+	return cycles;
+}
+
 void end_cpu() {
 
 	if( CPU->RAM != NULL )
@@ -0,0 +1,78 @@
+/*  ImaNES: I'm a NES. An intelligent NES emulator
+
+    dma.c   -    Direct memory access transfers
+
+    Copyright (C) 2009   Rodrigo Tobar Carrizo
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "clock.h"
+#include "cpu.h"
+#include "dma.h"
+#include "instruction_set.h"
+#include "ppu.h"
+
+/* Returns the CPU memory of a page, or NULL if it has to be read
+ * through read_cpu_ram (side effects, or disabled SRAM) */
+static uint8_t *dma_source(uint8_t page) {
+
+	/* Internal RAM and its mirrors */
+	if( page < 0x20 )
+		return CPU->RAM + ((page << 8) & 0x7FF);
+
+	/* PRG-ROM */
+	if( page >= 0x80 )
+		return CPU->RAM + (page << 8);
+
+	/* SRAM, which reads as 0 while it's disabled */
+	if( page >= 0x60 && (CPU->sram_enabled & SRAM_ENABLE) )
+		return CPU->RAM + (page << 8);
+
+	/* I/O registers and expansion area */
+	return NULL;
+}
+
+void oam_dma(uint8_t page) {
+
+	int i;
+	unsigned int first;
+	unsigned long int cycle;
+	uint8_t *source;
+
+	source = dma_source(page);
+	if( source != NULL ) {
+		first = 0x100 - PPU->spr_addr;
+		memcpy(PPU->SPR_RAM + PPU->spr_addr, source, first);
+		memcpy(PPU->SPR_RAM, source + first, PPU->spr_addr);
+	}
+	else {
+		for(i=0;i!=0x100;i++)
+			PPU->SPR_RAM[PPU->spr_addr++] = read_cpu_ram((page << 8) + i);
+	}
+
+	/* The transfer starts right after the write cycle, which is the
+	 * last one of the instruction being executed */
+	cycle = CLK->ppu_cycles/3 + instructions[CPU->RAM[CPU->PC]].cycles;
+	ADD_CPU_CYCLES(OAM_DMA_CYCLES + (cycle & 0x01));
+}
+
+uint8_t dmc_dma(uint16_t address) {
+
+	/* Samples are always read from $8000-$FFFF, which has no side effects */
+	ADD_CPU_CYCLES(DMC_DMA_CYCLES);
+	return CPU->RAM[address];
+}
@@ -0,0 +1,287 @@
+/*  ImaNES: I'm a NES. An intelligent NES emulator
+
+    fme7.c   -    Sunsoft FME-7 Mapper emulation under ImaNES
+
+    Copyright (C) 2009   Rodrigo Tobar Carrizo
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apu.h"
+#include "cpu.h"
+#include "debug.h"
+#include "fme7.h"
+#include "i18n.h"
+#include "mapper.h"
+#include "playback.h"
+#include "ppu.h"
+
+/* Sunsoft 5B audio: three square tone channels */
+typedef struct _fme7_tone {
+	uint16_t period;
+	uint8_t  volume;
+	uint8_t  enabled;
+	uint8_t  output;
+	int      timeout;
+} fme7_tone;
+
+static uint8_t command;
+static uint8_t audio_register;
+
+static int irq_enabled;
+static int irq_counter_enabled;
+static uint16_t irq_counter;
+
+/* 0x6000-0x7FFF can map either ROM or RAM. We keep the RAM
+ * contents while ROM is mapped there */
+static int ram_mapped;
+static uint8_t prg_ram[0x2000];
+
+static fme7_tone tones[3];
+static uint8_t last_sample;
+
+/* The 5B volume is logarithmic, 3 dB per step */
+static const uint8_t volume_outputs[16] = {
+	0, 0, 0, 0, 1, 1, 1, 2, 2, 3, 4, 6, 9, 12, 17, 24
+};
+
+static const mapper_state fme7_state[] = {
+	MAPPER_STATE(command),
+	MAPPER_STATE(audio_register),
+	MAPPER_STATE(irq_enabled),
+	MAPPER_STATE(irq_counter_enabled),
+	MAPPER_STATE(irq_counter),
+	MAPPER_STATE(ram_mapped),
+	MAPPER_STATE(prg_ram),
+	MAPPER_STATE(tones),
+	MAPPER_STATE(last_sample)
+};
+
+void fme7_initialize_mapper() {
+
+	/* 0-7: CHR banks, 8-B: PRG banks, C: mirroring */
+	mapper->regs = (uint8_t *)malloc(13);
+	memset(mapper->regs, 0, 13);
+
+	/* Keep the RAM mapped on 0x6000 until the game says otherwise */
+	mapper->regs[8] = 0xC0;
+
+	command = 0;
+	audio_register = 0;
+
+	irq_enabled = 0;
+	irq_counter_enabled = 0;
+	irq_counter = 0;
+
+	ram_mapped = 1;
+	memset(prg_ram, 0, sizeof(prg_ram));
+
+	memset(tones, 0, sizeof(tones));
+	last_sample = 0;
+
+	mapper->state = fme7_state;
+	mapper->state_count = MAPPER_STATES(fme7_state);
+	return;
+}
+
+static void fme7_write_audio(uint8_t value) {
+
+	fme7_tone *tone;
+
+	switch( audio_register ) {
+
+		/* Tone periods, 12 bits each */
+		case 0x00:
+		case 0x02:
+		case 0x04:
+			tone = tones + (audio_register >> 1);
+			tone->period = (tone->period & 0x0F00) | value;
+			break;
+		case 0x01:
+		case 0x03:
+		case 0x05:
+			tone = tones + (audio_register >> 1);
+			tone->period = (tone->period & 0x00FF) | ((value & 0x0F) << 8);
+			break;
+
+		/* Mixer, the tone bits are active low */
+		case 0x07:
+			tones[0].enabled = !(value & 0x01);
+			tones[1].enabled = !(value & 0x02);
+			tones[2].enabled = !(value & 0x04);
+			break;
+
+		case 0x08:
+		case 0x09:
+		case 0x0A:
+			tones[audio_register - 0x08].volume = value & 0x0F;
+			break;
+
+		/* Noise and envelope generators are not emulated */
+		default:
+			break;
+	}
+
+}
+
+int fme7_check_address(uint16_t address, uint8_t value) {
+
+	if( address < 0x8000 )
+		return 0;
+
+	switch( address & 0xE000 ) {
+
+		case 0x8000:
+			command = value & 0x0F;
+			break;
+
+		case 0xA000:
+
+			/* IRQ control and counter */
+			if( command == 0x0D ) {
+				irq_enabled = value & 0x01;
+				irq_counter_enabled = value & 0x80;
+				CPU->irq &= ~IRQ_MAPPER;
+			}
+			else if( command == 0x0E )
+				irq_counter = (irq_counter & 0xFF00) | value;
+			else if( command == 0x0F )
+				irq_counter = (irq_counter & 0x00FF) | (value << 8);
+
+			/* Banks and mirroring */
+			else {
+				mapper->regs[command] = value;
+				return 1;
+			}
+			break;
+
+		case 0xC000:
+			audio_register = value & 0x0F;
+			break;
+
+		case 0xE000:
+			fme7_write_audio(value);
+			break;
+	}
+
+	return 0;
+}
+
+void fme7_switch_banks() {
+
+	int i;
+	uint8_t value;
+
+	/* CHR 1kb banks */
+	if( mapper->file->vromBanks != 0 ) {
+		for(i=0;i!=8;i++)
+			SWAP_VRAM_1K(i*0x400, mapper->regs[i] % (mapper->file->vromBanks*8));
+	}
+
+	/* 0x6000 is either ROM or RAM */
+	value = mapper->regs[8];
+	if( value & 0x40 ) {
+		if( !ram_mapped ) {
+			memcpy(CPU->RAM + 0x6000, prg_ram, 0x2000);
+			invalidate_decoded(0x6000, 0x2000);
+			ram_mapped = 1;
+		}
+		CPU->sram_enabled = (value & 0x80) ? SRAM_ENABLE : 0;
+	}
+	else {
+		if( ram_mapped ) {
+			memcpy(prg_ram, CPU->RAM + 0x6000, 0x2000);
+			ram_mapped = 0;
+		}
+		SWAP_RAM_8K(0x6000, (value & 0x3F) % mapper->file->romBanks8k);
+		CPU->sram_enabled = SRAM_ENABLE | SRAM_RO;
+	}
+
+	/* PRG 8kb banks */
+	for(i=0;i!=3;i++)
+		SWAP_RAM_8K(0x8000 + i*0x2000, (mapper->regs[9+i] & 0x3F) % mapper->file->romBanks8k);
+
+	switch( mapper->regs[12] & 0x03 ) {
+		case 0:
+			PPU->mirroring = VERTICAL_MIRRORING;
+			break;
+		case 1:
+			PPU->mirroring = HORIZONTAL_MIRRORING;
+			break;
+		case 2:
+			PPU->mirroring = SINGLE_SCREEN_MIRRORING_A;
+			break;
+		case 3:
+			PPU->mirroring = SINGLE_SCREEN_MIRRORING_B;
+			break;
+	}
+
+}
+
+uint8_t *fme7_sram() {
+	return ram_mapped ? CPU->RAM + 0x6000 : prg_ram;
+}
+
+void fme7_reset() {
+
+	/* The last 8kb bank is always fixed into 0xE000-0xFFFF */
+	SWAP_RAM_8K(0xE000, mapper->file->romBanks8k - 1);
+	fme7_switch_banks();
+}
+
+void fme7_update() {
+	return;
+}
+
+void fme7_clock_cpu(int cycles) {
+
+	int i;
+	uint8_t sample;
+	fme7_tone *tone;
+
+	/* The IRQ counter decrements each CPU cycle, and
+	 * triggers the IRQ when wrapping from 0 to 0xFFFF */
+	if( irq_counter_enabled ) {
+		if( irq_counter < cycles && irq_enabled )
+			CPU->irq |= IRQ_MAPPER;
+		irq_counter -= cycles;
+	}
+
+	/* Tones toggle their output every 16*period CPU cycles */
+	sample = 0;
+	for(i=0;i!=3;i++) {
+		tone = tones + i;
+		tone->timeout -= cycles;
+		while( tone->timeout <= 0 ) {
+			tone->timeout += (tone->period ? tone->period : 1) << 4;
+			tone->output ^= 1;
+		}
+		if( tone->enabled && tone->output )
+			sample += volume_outputs[tone->volume];
+	}
+
+	if( sample != last_sample ) {
+		playback_add_sample(Expansion, sample);
+		last_sample = sample;
+	}
+
+}
+
+void fme7_end_mapper() {
+	free(mapper->regs);
+}
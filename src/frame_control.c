@@ -19,35 +19,150 @@
  */
 
 #include <time.h>
-#ifdef _MSC_VER
+#ifndef _MSC_VER
+#include <errno.h>
+#else
 #include <Windows.h>
 #endif
 
 #include "frame_control.h"
 #include "imaconfig.h"
+#include "mapper.h"
+#include "playback.h"
 #include "ppu.h"
 #include "screen.h"
+#include "telemetry.h"
+
+/* Maximum number of consecutive frames skipped in automatic mode */
+#define MAX_AUTO_SKIP  (4)
+
+/* Being this many frames behind means we were paused or running fast,
+ * and that catching up would only make the game run in bursts */
+#define MAX_LAG_FRAMES  (4)
+
+/* The sleep ends a bit before the deadline, and the rest is spun
+ * (the Windows scheduler needs a wider margin) */
+#ifndef _MSC_VER
+#define SPIN_NS  (200000ULL)
+#else
+#define SPIN_NS  (2000000ULL)
+#endif
+
+/* Maximum deadline correction applied per frame when following the
+ * audio clock; keeps the correction inaudible and the video smooth */
+#define MAX_AUDIO_CORRECTION  (250000LL)
 
 static int frames;
+static int late;     /* Last frame finished after its deadline */
+static int skipped;  /* Frames skipped since the last rendered one */
+
+/* The frame period is period + period_rem/period_den nanoseconds. The
+ * remainders are accumulated so the deadlines never drift */
+static uint64_t period;
+static uint64_t period_rem;
+static uint64_t period_den;
+static uint64_t deadline;
+static uint64_t deadline_rem;
+static uint64_t fps_second;
+
+/* Audio clock reference, and the corrections already applied */
+static uint64_t audio_start;
+static uint64_t audio_mono_start;
+static int64_t audio_correction;
+
+uint64_t frame_clock() {
+
 #ifndef _MSC_VER
-static struct timespec startTime;
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec*1000000000 + now.tv_nsec;
 #else
-static time_t secs;
-static LARGE_INTEGER freq;
-static LARGE_INTEGER startTime;
+	static LARGE_INTEGER freq;
+	LARGE_INTEGER now;
+
+	if( !freq.QuadPart )
+		QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&now);
+	return (uint64_t)(now.QuadPart / freq.QuadPart) * 1000000000 +
+	       (uint64_t)(now.QuadPart % freq.QuadPart) * 1000000000 / freq.QuadPart;
 #endif
+}
 
-void start_timing() {
+/* Sleeps until the given instant of frame_clock() */
+static void sleep_until(uint64_t when) {
 
 #ifndef _MSC_VER
-	clock_gettime(CLOCK_REALTIME, &startTime);
+	struct timespec sleepTime;
+
+	sleepTime.tv_sec  = (time_t)(when / 1000000000);
+	sleepTime.tv_nsec = (long)(when % 1000000000);
+	while( clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &sleepTime, NULL) == EINTR );
 #else
-	QueryPerformanceFrequency(&freq);
-	QueryPerformanceCounter(&startTime);
-	time(&secs);
+	uint64_t now = frame_clock();
+
+	if( when > now )
+		Sleep((DWORD)((when - now) / 1000000));
 #endif
+}
+
+/* Starts counting frame deadlines from now */
+static void rebase() {
+
+	deadline = frame_clock();
+	deadline_rem = 0;
+	audio_start = 0;
+	audio_correction = 0;
+}
+
+/* Moves the deadline slightly so the emulation follows the audio device
+ * clock instead of the monotonic one, so the device never starves */
+static void follow_audio_clock(uint64_t now) {
+
+	uint64_t audio_now = playback_clock(now);
+	int64_t drift;
+
+	if( audio_now == 0 )
+		return;
+
+	if( audio_start == 0 ) {
+		audio_start = audio_now;
+		audio_mono_start = now;
+		return;
+	}
+
+	/* If the audio runs slower than the monotonic clock we must wait
+	 * longer, and the other way around */
+	drift = (int64_t)(now - audio_mono_start) - (int64_t)(audio_now - audio_start);
+	drift -= audio_correction;
+	if( drift > MAX_AUDIO_CORRECTION )
+		drift = MAX_AUDIO_CORRECTION;
+	else if( drift < -MAX_AUDIO_CORRECTION )
+		drift = -MAX_AUDIO_CORRECTION;
+
+	deadline += drift;
+	audio_correction += drift;
+}
+
+void start_timing() {
+
+	if( mapper != NULL && mapper->file != NULL && mapper->file->pal ) {
+		period     = PAL_FRAME_NS_NUM / PAL_FRAME_NS_DEN;
+		period_rem = PAL_FRAME_NS_NUM % PAL_FRAME_NS_DEN;
+		period_den = PAL_FRAME_NS_DEN;
+	}
+	else {
+		period     = NTSC_FRAME_NS_NUM / NTSC_FRAME_NS_DEN;
+		period_rem = NTSC_FRAME_NS_NUM % NTSC_FRAME_NS_DEN;
+		period_den = NTSC_FRAME_NS_DEN;
+	}
+
+	rebase();
+	fps_second = deadline / 1000000000;
 
 	frames = 0;
+	late = 0;
+	skipped = 0;
 }
 
 void add_frame() {
@@ -56,81 +171,86 @@ void add_frame() {
 
 void frame_sleep() {
 
-#ifndef _MSC_VER
-	static long tmp;
-	static struct timespec endTime;
-	struct timespec sleepTime = { 0, (long)2e7 };
-#else
-	static time_t tmp;
-	static LARGE_INTEGER endTime;
-	LARGE_INTEGER sleepTime;
-#endif
+	uint64_t now;
 
 	frames++;
 
-	/* Calculate how much we should sleep for 50/60 FPS */
-	/* For this, we calculate the next "start" time,    */
-	/* and then we calculate the different between it   */
-	/* the actual time                                  */
-
-#ifndef _MSC_VER
-
-	/* Check current time, see if we should display the fps */
-	tmp = endTime.tv_sec;
-	clock_gettime(CLOCK_REALTIME, &endTime);
-	startTime.tv_nsec += (long)1.666666e7;
-
-	if( startTime.tv_nsec > 1e9 ) {
-		startTime.tv_sec++;
-		startTime.tv_nsec -= (long)1e9;
+	/* The next deadline is an absolute instant, so the time spent
+	 * emulating this frame is not added to the period */
+	deadline += period;
+	deadline_rem += period_rem;
+	if( deadline_rem >= period_den ) {
+		deadline++;
+		deadline_rem -= period_den;
 	}
 
-	if( endTime.tv_sec != tmp ) {
+	/* Check current time, see if we should display the fps */
+	now = frame_clock();
+	if( now / 1000000000 != fps_second ) {
+		fps_second = now / 1000000000;
 		show_fps(frames);
 		frames = 0;
 	}
 
-	if( config.run_fast )
+	if( config.run_fast ) {
+		late = 1;
 		return;
-
-	/* Calculate the sleep time */
-	sleepTime.tv_nsec = startTime.tv_nsec - endTime.tv_nsec;
-	sleepTime.tv_sec  = startTime.tv_sec  - endTime.tv_sec;
-	if( sleepTime.tv_nsec < 0 ) {
-		sleepTime.tv_sec--;
-		sleepTime.tv_nsec += (long)1e9;
 	}
 
+	late = (now > deadline);
+	COUNT(late_frames, late);
+
 	/* We were on pause or in fast run */
-	if( sleepTime.tv_sec > 0 || sleepTime.tv_nsec > 1.666666e7 ) {
-		clock_gettime(CLOCK_REALTIME, &startTime);
-		sleepTime.tv_sec = 0;
-		sleepTime.tv_nsec = 0;
+	if( now > deadline + MAX_LAG_FRAMES*period ) {
+		rebase();
+		return;
 	}
-	else
-		nanosleep(&sleepTime, NULL);
 
-#else
-	tmp = secs;
-	QueryPerformanceCounter(&endTime);
-	time(&secs);
-	startTime.QuadPart += (LONGLONG)(1.6666e-2 * freq.QuadPart);
-	sleepTime.QuadPart = startTime.QuadPart - endTime.QuadPart;
+	if( config.audio_pacing && !config.sound_mute )
+		follow_audio_clock(now);
 
-	if( tmp != secs ) {
-		show_fps(frames);
-		frames = 0;
-	}
+	if( late )
+		return;
 
-	/* We were on pause or in fast run */
-	if( sleepTime.QuadPart > (LONGLONG)(1.6666e-2 * freq.QuadPart) ) {
-		QueryPerformanceCounter(&startTime);
-		time(&secs);
-		sleepTime.QuadPart = 0;
+	/* Sleep most of the time, and spin the last part to
+	 * wake up as close to the deadline as possible */
+	if( deadline - now > SPIN_NS )
+		sleep_until(deadline - SPIN_NS);
+	do
+		now = frame_clock();
+	while( now < deadline );
+
+	COUNT(sleep_overshoot, (now - deadline)/1000);
+}
+
+int render_next_frame() {
+
+	int skip;
+
+	switch( config.frame_skip ) {
+
+		case FRAME_SKIP_NEVER:
+			return 0;
+
+		/* Skip while we are behind, but draw from time to time */
+		case FRAME_SKIP_AUTO:
+			skip = late && skipped < MAX_AUTO_SKIP;
+			break;
+
+		/* Running fast draws at most every other frame */
+		default:
+			if( config.run_fast && config.frame_skip == 0 )
+				skip = skipped < 1;
+			else
+				skip = skipped < config.frame_skip;
+			break;
 	}
 
-	if( !config.run_fast && sleepTime.QuadPart > 0 )
-		Sleep((DWORD)((double)sleepTime.QuadPart*1000/(double)freq.QuadPart));
-#endif
+	if( skip ) {
+		skipped++;
+		return 0;
+	}
 
+	skipped = 0;
+	return 1;
 }
@@ -78,11 +78,13 @@ void gui_loop() {
 	SDL_Event event;
 
 	config.run_fast = 0;
+	lock_video();
 	SDL_ShowCursor(SDL_ENABLE);
+	unlock_video();
 	start_timing();
 
 	while( config.pause ) {
-		while( SDL_PollEvent(&event) ) {
+		while( poll_event(&event) ) {
 			switch(event.type) {
 	
 				/* Alt-F4 in Windows should lead us to SDL_QUIT */
@@ -111,7 +113,9 @@ void gui_loop() {
 		frame_sleep();
 	}
 
+	lock_video();
 	SDL_ShowCursor(SDL_DISABLE);
+	unlock_video();
 }
 
 void gui_keydown(SDL_keysym keysym) {
@@ -130,6 +134,8 @@ void gui_keydown(SDL_keysym keysym) {
 
 void redraw_gui() {
 
+	int flipped;
+
 	/*SDL_Rect dst;*/
 
 	/* Copy first of all the background pixels */
@@ -140,7 +146,10 @@ void redraw_gui() {
 	dst.y = _cursor_y;
 	SDL_BlitSurface(imanes_cursor, NULL, nes_screen, &dst); */
 
-	if( SDL_Flip(nes_screen) == -1 ) {
+	lock_video();
+	flipped = SDL_Flip(nes_screen);
+	unlock_video();
+	if( flipped == -1 ) {
 		fprintf(stderr,_("Couldn't refresh screen :(\n"));
 		fprintf(stderr,_("I'm exiting now\n"));
 		SDL_Quit();
@@ -0,0 +1,189 @@
+/*  ImaNES: I'm a NES. An intelligent NES emulator
+
+    icon.c   -    ImaNES window icon
+
+    Copyright (C) 2009   Rodrigo Tobar Carrizo
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "icon.h"
+
+/* Pixels of icons/imanes-32.bmp, as 0xRRGGBB */
+const Uint32 imanes_icon[ICON_SIZE*ICON_SIZE] = {
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0x000E0E, 0x221515, 0x1F1718,
+	0x1D1818, 0x1D1717, 0x171516, 0x001213, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0x131112, 0x301D1C, 0x582827, 0x883432,
+	0x9E3C39, 0x7F2C2A, 0x421C1B, 0x241718, 0x0D1415, 0x051214, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0x111214, 0x4B2120, 0xAE413E, 0xEF5F5B, 0xDA5551,
+	0xD34541, 0xE13D38, 0xE93631, 0x9A2A26, 0x371A1A, 0x111415, 0x0D1415, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0x111415, 0x4B1E1D, 0xC03C38, 0xD0443F, 0x832826, 0x5E2626,
+	0x532120, 0x63201F, 0x9E2A27, 0xE33530, 0xB92E2A, 0x371A1A, 0x111415, 0x121415,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0x331919, 0xB72E2B, 0xC4312D, 0x522524, 0x212527, 0x151E1F,
+	0x0E191A, 0x061214, 0x271818, 0x752422, 0xDD342F, 0x9E2A27, 0x1E1617, 0x121415,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0x0B0C0D, 0x471E1E, 0xC82E2A, 0x532625, 0x212729, 0x1A1E1F, 0x121415,
+	0x0F1112, 0x111516, 0x001113, 0x1B1617, 0x8C2725, 0xB82E2A, 0x3C1B1B, 0x131516,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0x393F40, 0x929C9E, 0x372E2F, 0x222526, 0x1A1D1E, 0x101112, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0x001012, 0x571F1E, 0x7D2522, 0x662120, 0x161616,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0x08090A, 0x7F8E90, 0xA0BABC, 0x1B1E1F, 0x222527, 0x0B0C0C, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0x000F11, 0x441C1C, 0x6A2221, 0x5D1F1E, 0x1D1E1F,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0x272B2C, 0xC7E5E7, 0x445052, 0x232728, 0x0B0E0E, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0x001213, 0x571F1E, 0x952926, 0x311A19, 0x232628,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0x343A3A, 0x88A2A3, 0x1D1E20, 0x1C1F21, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0x001113, 0x331919, 0x982926, 0x8E2623, 0x2E2A2A, 0x1A1D1F,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0x010000, 0x1A1B1C, 0x1F2223, 0x030303, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0x0C0708, 0x431B1A, 0x982926, 0x9F2925, 0x312223, 0x262D2E, 0x131516,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0x7EC6C8, 0x7FC7C9, 0x7EC6C8, 0x7FC7C9,
+	0x82CCCE, 0x497071, 0x2A3D3E, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0x000000, 0x28292A, 0x592827, 0x852421, 0x2F2223, 0x242C2E, 0x171A1B, 0x131516,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0x7EC6C8, 0x7EC6C8, 0x7EC6C8, 0x7EC6C8,
+	0x81CACC, 0x93E7EA, 0xB8FFFF, 0x73B5B7, 0xFFFFFF, 0xFFFFFF, 0x000000, 0x141515,
+	0x62787A, 0x87ACAE, 0x3E3E3F, 0x272123, 0x232A2B, 0x181B1C, 0x121415, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0x7EC6C8, 0x7FC6C8, 0x7FC7C9, 0x7EC5C7, 0x060405, 0x242728, 0x6E7B7D, 0xB3D2D3,
+	0x7D9394, 0x2C3335, 0x2E3335, 0x202426, 0x141617, 0x121415, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0x7FC7C9, 0x7FC7C9, 0x7FC7C9,
+	0x7EC6C8, 0x7FC7C9, 0x7FC7C9, 0xB2FFFF, 0x1C2728, 0x1D2021, 0x657273, 0x383F40,
+	0x282C2E, 0x282C2E, 0x141617, 0x111314, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0x7EC6C8, 0x7FC7C9, 0x7FC6C8, 0x7EC7C9, 0xFFFFFF,
+	0x7EC6C8, 0x7FC7C9, 0x7EC6C8, 0x7EC6C8, 0xDFFFFF, 0x0E0E0F, 0x0D0E0F, 0x1A1D1E,
+	0x131516, 0x0F1111, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0x3E0900, 0x9C7657, 0xC4AC9A,
+	0xC5AD9A, 0x9E7859, 0x491300, 0x7FC7C9, 0x7EC6C8, 0x7FC7C9, 0xFFFFFF, 0x7DC6C8,
+	0x7EC7C9, 0x7EC6C8, 0x7EC6C8, 0x7EC6C8, 0xFFFFFF, 0xFFFFFF, 0x131516, 0x040506,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0x591900, 0xA0734E, 0xD7BDA8, 0xDFC8B4,
+	0xDFC8B4, 0xD7BFA9, 0xA47753, 0x622600, 0xFFFFFF, 0xFFFFFF, 0x7EC6C8, 0x7EC6C8,
+	0x7EC7C9, 0xFFFFFF, 0x7FC7C9, 0x7FC6C8, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0x6B2900, 0x9D673B, 0xCBA586, 0xD6B497, 0xD4B195,
+	0xD4B195, 0xD6B497, 0xCCA687, 0x9F6B40, 0x723200, 0x7EC6C8, 0x7FC6C8, 0x7FC7C9,
+	0xFFFFFF, 0xFFFFFF, 0x7EC6C8, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0x4A1D00, 0x6B3C17, 0x7C593D, 0x8B6C53, 0xB48966, 0xC99972,
+	0xC89972, 0xB58B68, 0x937760, 0x85664B, 0x757C69, 0x7BC0C1, 0x7FC7C9, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0x7EC6C8, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0x421100, 0x7F4312, 0x8F582C, 0x7B5A40, 0x7A7068, 0x726356, 0x966944,
+	0xA67248, 0x8A7A6C, 0xA4A3A2, 0x90887D, 0x829D8F, 0x7F8067, 0x5C2400, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0x6D3306, 0x733605, 0x8E4810, 0xA76128, 0xB19075, 0xCDCDCD, 0xADAFB0, 0x887D74,
+	0x75614F, 0xB1B3B4, 0xC6C8C9, 0xB5AEA7, 0x9C8564, 0x934B11, 0x783804, 0x853E03,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0x663005, 0x7F3C06, 0x984A0B, 0x9B5012, 0xAF957F, 0x858789, 0x717171, 0x5E5F5F,
+	0x9C9792, 0x5F5F60, 0x5B5C5C, 0x756D66, 0xA36B3D, 0x9B4B0A, 0x853F07, 0x612D04,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0x642F04, 0x894207, 0x9B4B0A, 0x9A4703, 0xA9876A, 0x797B7C, 0x101010, 0x434445,
+	0x946947, 0x6D7174, 0x272A2C, 0x7E6A5A, 0x9D551A, 0x9C4B08, 0x8E4508, 0x723605,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0x6A3205, 0x8B4308, 0x9C4B0A, 0x9D4A07, 0x97541E, 0xAE9E92, 0xA9A9AA, 0x9B704E,
+	0x9C4B09, 0x9D7758, 0xA68D7A, 0x995B27, 0x994E11, 0x9B4D0E, 0x8F4508, 0x723605,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0x5F2D05, 0x853F07, 0x9A4A09, 0x9B4C0B, 0x9B5820, 0x984F14, 0x974B0E, 0x9D4A05,
+	0x9B4B09, 0x994805, 0x974401, 0x985B2A, 0x946640, 0x934C11, 0x894106, 0x6A3205,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0x803E06, 0x7B3C07, 0x92480C, 0x934403, 0x8D6748, 0x855B39, 0x85420C, 0x86430C,
+	0x80410D, 0x7B4010, 0x753D10, 0x735034, 0x6D4D33, 0x6B360B, 0x763906, 0x703504,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0x764216, 0x884915, 0x7B4010, 0x683B16, 0x684122, 0x6A380F, 0x6C390F,
+	0x773E10, 0x81430F, 0x88440D, 0x8E4407, 0x904305, 0x7F471A, 0x703F18, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0x000000, 0x4E433A, 0x796351, 0x754925, 0x8C4A14, 0x94490D, 0x954809,
+	0x934606, 0x904406, 0x8B440A, 0x713708, 0x553114, 0x3C342C, 0x202224, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0x000000, 0x101112, 0x2A2B2B, 0x1B1611, 0x2B1C11, 0x906B50, 0x9E7554,
+	0x9C714F, 0x966C4C, 0x65462E, 0x0C0400, 0x070605, 0x070809, 0x060607, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0x000000, 0x020202, 0x020202, 0x000000, 0x030404, 0x52463E, 0x8A705B,
+	0x856A55, 0x947864, 0x342C27, 0x0F1010, 0x131314, 0x090909, 0x000000, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0x050505, 0x121212, 0x202020, 0x202020, 0x000000, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0x181817, 0x191919, 0x111111, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF,
+	0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF, 0xFFFFFF
+};
+
+/* Transparent pixels of the icon, one bit per pixel */
+const Uint8 imanes_icon_mask[ICON_SIZE*ICON_SIZE/8] = {
+	0x00, 0x00, 0x07, 0xF0,
+	0x00, 0x00, 0x0F, 0xFC,
+	0x00, 0x00, 0x1F, 0xFE,
+	0x00, 0x00, 0x3F, 0xFE,
+	0x00, 0x00, 0x3F, 0xFF,
+	0x00, 0x00, 0x7F, 0xFF,
+	0x00, 0x00, 0xFE, 0x1F,
+	0x00, 0x00, 0xFC, 0x1F,
+	0x00, 0x00, 0xF8, 0x1F,
+	0x00, 0x00, 0xF0, 0x3F,
+	0x00, 0x00, 0xF0, 0x7F,
+	0x00, 0x07, 0xE0, 0xFF,
+	0x00, 0x07, 0x73, 0xFE,
+	0x00, 0x03, 0xFF, 0xFC,
+	0x00, 0x0F, 0xFF, 0xF0,
+	0x00, 0x0E, 0xF7, 0xC0,
+	0x03, 0x89, 0xF3, 0x00,
+	0x07, 0xE3, 0xB0, 0x00,
+	0x0F, 0xF7, 0x20, 0x00,
+	0x1F, 0xFE, 0x00, 0x00,
+	0x3F, 0xFC, 0x00, 0x00,
+	0x7F, 0xFE, 0x00, 0x00,
+	0xFF, 0xFE, 0x00, 0x00,
+	0xFF, 0xFF, 0x00, 0x00,
+	0xFF, 0xFF, 0x00, 0x00,
+	0xFF, 0xFF, 0x00, 0x00,
+	0xFF, 0xFE, 0x00, 0x00,
+	0xFF, 0xFE, 0x00, 0x00,
+	0x7F, 0xFC, 0x00, 0x00,
+	0x7F, 0xFC, 0x00, 0x00,
+	0x7F, 0xFC, 0x00, 0x00,
+	0x3D, 0xBC, 0x00, 0x00
+};
@@ -18,6 +18,7 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -26,14 +27,13 @@
 #include "debug.h"
 #include "i18n.h"
 #include "imaconfig.h"
+#include "pad.h"
 #include "platform.h"
 
 imanes_config config;
 
 void initialize_configuration() {
 
-	char *dummy;
-
 	/* Emulator window */
 	config.show_bg  = 1;
 	config.show_front_spr = 1;
@@ -48,31 +48,69 @@ void initialize_configuration() {
 	config.apu_noise = 1;
 	config.apu_dmc = 1;
 	config.sound_mute = 0;
+	config.audio_pacing = 0;
 
-	/* Start on non-pause and at 60 fps */
+	/* Start on non-pause and at 60 fps, drawing every frame */
 	config.pause = 0;
 	config.run_fast = 0;
+	config.frame_skip = 0;
+
+	/* Show the frames without blocking the emulation */
+	config.present_thread = 1;
+
+	/* Interpret every instruction */
+	config.translate_blocks = 0;
+
+	/* Don't waste time interpreting idle loops */
+	config.skip_idle_loops = 1;
+
+	/* Don't trace instructions */
+	config.trace_file = NULL;
+
+	/* Don't profile the execution */
+	config.profile_file = NULL;
+
+	/* Don't report the performance counters */
+	config.telemetry = NULL;
 
 	/* Set default video scale factor */
 	if( config.video_scale == 0 )
 		config.video_scale = 1;
 
-	/* Use our color construction */
+	/* Use our color construction, without filters */
 	config.use_sdl_colors = 0;
+	config.ntsc_filter = 0;
+	config.palette_file = NULL;
 
 	/* Start with the state 0, but don't load nor save it */
 	config.current_state = 0;
 	config.save_state = 0;
 	config.load_state = 0;
 
+	/* PNG screenshots, and no frame dumps */
 	config.take_screenshot = 0;
+	config.capture_format = CAPTURE_PNG;
+	config.dump_dir = NULL;
+	config.record_file = NULL;
 
-	/* Create all directories if necessary */
-	dummy = get_imanes_dir(States);    free(dummy);
-	dummy = get_imanes_dir(Saves);     free(dummy);
-	dummy = get_imanes_dir(Snapshots); free(dummy);
+	/* Directories are only created when something is written in them */
 }
 
+/* Settings that can be given in the per-user configuration file */
+static const struct {
+	const char *key;
+	uint8_t *value;
+	const char *name;
+} rc_settings[] = {
+	{ "square1",  &config.apu_square1,  "Square 1 audio channel" },
+	{ "square2",  &config.apu_square2,  "Square 2 audio channel" },
+	{ "triangle", &config.apu_triangle, "Triangle audio channel" },
+	{ "noise",    &config.apu_noise,    "Noise audio channel" },
+	{ "dmc",      &config.apu_dmc,      "DMC audio channel" }
+};
+
+#define RC_SETTINGS  (sizeof(rc_settings)/sizeof(rc_settings[0]))
+
 int config_enabled(const char *value) {
 
 	if( !strcmp("1", value) ||
@@ -83,103 +121,114 @@ int config_enabled(const char *value) {
 	return 0;
 }
 
+/* Builds the name of the per-user imanes directory, without creating it.
+ * It returns 0 when returns gracefully, -1 otherwise */
+static int user_imanes_path(char *path, size_t size) {
+
+	char * user_home;
+#ifdef _MSC_VER
+	size_t len;
+
+	_dupenv_s(&user_home, &len, "APPDATA");
+#else
+	user_home = getenv("HOME");
+#endif
+
+	if( user_home == NULL ) {
+		fprintf(stderr, _("Couldn't find user's home directory. Will not load user configuration\n"));
+		return -1;
+	}
+
+	if( strlen(user_home) + strlen(IMANES_USER_DIR) + 2 > size )
+		return -1;
+
+	imanes_sprintf(path, size, "%s%c%s", user_home, DIR_SEP, IMANES_USER_DIR);
+	return 0;
+}
+
+/* Splits a "key = value" line in place. It returns 0 when the line
+ * has a setting, 1 when it's empty or a comment, and -1 if invalid */
+static int split_setting(char *line, char **key, char **value) {
+
+	char *c = line;
+
+	while( *c == ' ' || *c == '\t' )
+		c++;
+	if( *c == '\0' || *c == '\n' || *c == '\r' || *c == '#' )
+		return 1;
+
+	*key = c;
+	while( *c != '\0' && *c != '=' && *c != ' ' && *c != '\t' && *c != '\n' )
+		c++;
+	while( *c == ' ' || *c == '\t' )
+		*c++ = '\0';
+	if( *c != '=' )
+		return -1;
+	*c++ = '\0';
+
+	while( *c == ' ' || *c == '\t' )
+		c++;
+	*value = c;
+	while( *c != '\0' && *c != ' ' && *c != '\t' && *c != '\n' && *c != '\r' )
+		c++;
+	*c = '\0';
+
+	return (**key == '\0' || **value == '\0') ? -1 : 0;
+}
+
 void load_user_configuration() {
 
 	unsigned int line_count;
-	char *user_dir;
-	char *config_file;
+	unsigned int i;
+	char config_file[CONFIG_PATH_SIZE];
 	char line[1024];
-	char key[100];
-	char value[100];
+	char *key;
+	char *value;
 	FILE *file = NULL;
 
-	user_dir = get_user_imanes_dir();
-
-	if( user_dir == NULL ) {
+	if( user_imanes_path(config_file, sizeof(config_file) - 10) ) {
 		fprintf(stderr,_("Couldn't find user's configuration\n"));
 		return;
 	}
 
-	config_file = (char *)malloc(strlen(user_dir) + 11);
-	imanes_sprintf(config_file, strlen(user_dir) + 11, "%s%cimanes.rc", user_dir, DIR_SEP);
+	imanes_sprintf(config_file + strlen(config_file), 11, "%cimanes.rc", DIR_SEP);
 	file = fopen(config_file, "rt");
 
+	/* Not having a configuration file is fine, the defaults are used */
 	if( file == NULL ) {
+		if( errno == ENOENT ) {
+			INFO( printf(_("No configuration file '%s', using the defaults\n"), config_file) );
+			return;
+		}
 		fprintf(stderr,_("Error while opening configuration file '%s': "), config_file);
 		perror(NULL);
 		fprintf(stderr,_("No configuration will be loaded from configuration file\n"));
-		free(config_file);
-		free(user_dir);
 		return;
 	}
 
-	line_count = 1;
-	while( !feof(file) && fgets(line, 1024, file) != NULL ) {
-
-		/* Skip empty lines and comments */
-		if( strlen(line) == 0 )
-			continue;
-		if( line[0] == '#' )
-			continue;
+	for(line_count = 1; fgets(line, sizeof(line), file) != NULL; line_count++) {
 
-		/* Check that lines are valid */
-		if( sscanf(line, "%s = %s", key, value) != 2 ) {
-			fprintf(stderr, "Invalid configuration at line %d: %s", line_count, line);
+		switch( split_setting(line, &key, &value) ) {
+			case 1:
+				continue;
+			case -1:
+				fprintf(stderr,_("Invalid configuration at line %d\n"), line_count);
+				continue;
 		}
 
 		/* Actually configure imanes */
-
-		/* Square1 channel */
-		if( !strcmp("square1", key) ) {
-			if( config_enabled(value) )
-				config.apu_square1 = 1;
-			else
-				config.apu_square1 = 0;
-			INFO( printf("[config] Square 1 audio channel %s\n", (config.apu_square1 ? "enabled" : "disabled")) );
-			continue;
-		}
-		/* Square2 channel */
-		if( !strcmp("square2", key) ) {
-			if( config_enabled(value) )
-				config.apu_square2 = 1;
-			else
-				config.apu_square2 = 0;
-			INFO( printf("[config] Square 2 audio channel %s\n", (config.apu_square2 ? "enabled" : "disabled")) );
-			continue;
-		}
-		/* Triangle channel */
-		if( !strcmp("triangle", key) ) {
-			if( config_enabled(value) )
-				config.apu_triangle = 1;
-			else
-				config.apu_triangle = 0;
-			INFO( printf("[config] Triangle audio channel %s\n", (config.apu_triangle ? "enabled" : "disabled")) );
-			continue;
-		}
-		/* Noise channel */
-		if( !strcmp("noise", key) ) {
-			if( config_enabled(value) )
-				config.apu_noise = 1;
-			else
-				config.apu_noise = 0;
-			INFO( printf("[config] Noise audio channel %s\n", (config.apu_noise ? "enabled" : "disabled")) );
-			continue;
-		}
-		/* DMC channel */
-		if( !strcmp("dmc", key) ) {
-			if( config_enabled(value) )
-				config.apu_dmc = 1;
-			else
-				config.apu_dmc = 0;
-			INFO( printf("[config] DMC audio channel %s\n", (config.apu_dmc ? "enabled" : "disabled")) );
-			continue;
+		for(i=0; i!=RC_SETTINGS; i++) {
+			if( !strcmp(rc_settings[i].key, key) ) {
+				*rc_settings[i].value = config_enabled(value);
+				INFO( printf("[config] %s %s\n", rc_settings[i].name, (*rc_settings[i].value ? "enabled" : "disabled")) );
+				break;
+			}
 		}
-
-		line_count++;
+		if( i == RC_SETTINGS && configure_pad(key, value) == -1 )
+			fprintf(stderr,_("Unknown configuration '%s' at line %d\n"), key, line_count);
 	}
 
-	free(user_dir);
-	free(config_file);
+	fclose(file);
 	return;
 }
 
@@ -210,76 +259,60 @@ int check_and_create(char *dir) {
 
 char *get_user_imanes_dir() {
 
-	char * user_home;
-	char * user_imanes_dir;
-#ifdef _MSC_VER
-	size_t size;
-
-	_dupenv_s(&user_home, &size, "APPDATA");
-#else
-	user_home = getenv("HOME");
-#endif
-
-	if( user_home == NULL ) {
-		fprintf(stderr, _("Couldn't find user's home directory. Will not load user configuration\n"));
-		return NULL;
-	}
-
-	user_imanes_dir = (char *)malloc(strlen(user_home) + strlen(IMANES_USER_DIR) + 2);
-	imanes_sprintf(user_imanes_dir,
-	               strlen(user_home) + strlen(IMANES_USER_DIR) + 2,
-	               "%s%c%s",user_home, DIR_SEP,IMANES_USER_DIR);
+	char path[CONFIG_PATH_SIZE];
+	char *user_imanes_dir;
 
-	if( check_and_create(user_imanes_dir) )
+	if( user_imanes_path(path, sizeof(path)) || check_and_create(path) )
 		return NULL;
 
+	user_imanes_dir = (char *)malloc(strlen(path) + 1);
+	strcpy(user_imanes_dir, path);
 	return user_imanes_dir;
 }
 
-char *get_imanes_dir(imanes_dir dir) {
+char *imanes_dir_name(imanes_dir dir) {
 
-	char *user_imanes_dir;
+	char path[CONFIG_PATH_SIZE];
 	char *specific_dir;
+	const char *name = "";
+	size_t size;
 
-	user_imanes_dir = get_user_imanes_dir();
-	specific_dir = NULL;
-
-	if( user_imanes_dir == NULL )
+	if( user_imanes_path(path, sizeof(path)) )
 		return NULL;
 
 	switch(dir) {
-
 		case States:
-			specific_dir = (char *)malloc(strlen(user_imanes_dir) + 8);
-			imanes_sprintf(specific_dir,strlen(user_imanes_dir)+8,"%s%cstates",user_imanes_dir, DIR_SEP);
-			if( check_and_create(specific_dir) ) {
-				free(specific_dir);
-				free(user_imanes_dir);
-				return NULL;
-			}
+			name = "states";
 			break;
-
 		case Saves:
-			specific_dir = (char *)malloc(strlen(user_imanes_dir) + 7);
-			imanes_sprintf(specific_dir,strlen(user_imanes_dir)+7,"%s%csaves",user_imanes_dir, DIR_SEP);
-			if( check_and_create(specific_dir) ) {
-				free(specific_dir);
-				free(user_imanes_dir);
-				return NULL;
-			}
+			name = "saves";
 			break;
-
 		case Snapshots:
-			specific_dir = (char *)malloc(strlen(user_imanes_dir) + 13);
-			imanes_sprintf(specific_dir,strlen(user_imanes_dir)+13,"%s%cscreenshots",user_imanes_dir, DIR_SEP);
-			if( check_and_create(specific_dir) ) {
-				free(specific_dir);
-				free(user_imanes_dir);
-				return NULL;
-			}
+			name = "screenshots";
 			break;
 	}
 
+	size = strlen(path) + strlen(name) + 2;
+	specific_dir = (char *)malloc(size);
+	imanes_sprintf(specific_dir, (int)size, "%s%c%s", path, DIR_SEP, name);
+	return specific_dir;
+}
+
+char *get_imanes_dir(imanes_dir dir) {
+
+	char *user_imanes_dir;
+	char *specific_dir;
+
+	user_imanes_dir = get_user_imanes_dir();
+	if( user_imanes_dir == NULL )
+		return NULL;
 	free(user_imanes_dir);
+
+	specific_dir = imanes_dir_name(dir);
+	if( specific_dir != NULL && check_and_create(specific_dir) ) {
+		free(specific_dir);
+		return NULL;
+	}
+
 	return specific_dir;
 }
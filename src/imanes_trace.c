@@ -0,0 +1,160 @@
+/*  ImaNES: I'm a NES. An intelligent NES emulator
+
+    imanes_trace.c   -    ImaNES trace files decoder
+
+    Copyright (C) 2009   Rodrigo Tobar Carrizo
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+#include "XGetopt.h"
+#else
+#include <unistd.h>
+#endif
+
+#include "common.h"
+#include "i18n.h"
+#include "instruction_set.h"
+#include "trace.h"
+
+void usage(FILE *file, char *argv[]) {
+	fprintf(file,_("\nUsage: %s [options] <trace file>\n\n"), argv[0]);
+	fprintf(file,_("Decodes and disassembles a trace recorded by ImaNES with -T\n\n"));
+	fprintf(file,_("Options:\n"));
+	fprintf(file,_("  -n <n>    Show only the last n instructions. Default: all\n"));
+	fprintf(file,_("  -h,-?     Show this help and exit\n\n"));
+}
+
+/* Writes the disassembled instruction of a record into str */
+void disassemble(trace_record *r, trace_opcode *op, char *str) {
+
+	uint16_t word = r->operands[0] | (r->operands[1] << 8);
+	uint8_t  byte = r->operands[0];
+
+	switch( op->addr_mode ) {
+		case ADDR_IMMEDIATE: sprintf(str, "%s #$%02X",     op->name, byte); break;
+		case ADDR_ABSOLUTE:  sprintf(str, "%s $%04X",      op->name, word); break;
+		case ADDR_ZEROPAGE:  sprintf(str, "%s $%02X",      op->name, byte); break;
+		case ADDR_INDIRECT:  sprintf(str, "%s ($%04X)",    op->name, word); break;
+		case ADDR_ABS_INDX:  sprintf(str, "%s $%04X,X",    op->name, word); break;
+		case ADDR_ABS_INDY:  sprintf(str, "%s $%04X,Y",    op->name, word); break;
+		case ADDR_ZERO_INDX: sprintf(str, "%s $%02X,X",    op->name, byte); break;
+		case ADDR_ZERO_INDY: sprintf(str, "%s $%02X,Y",    op->name, byte); break;
+		case ADDR_IND_INDIR: sprintf(str, "%s ($%02X,X)",  op->name, byte); break;
+		case ADDR_INDIR_IND: sprintf(str, "%s ($%02X),Y",  op->name, byte); break;
+		case ADDR_ACCUM:     sprintf(str, "%s A",          op->name);       break;
+		case ADDR_RELATIVE:
+			sprintf(str, "%s $%04X", op->name, (uint16_t)(r->PC + 2 + (int8_t)byte));
+			break;
+		default:
+			sprintf(str, "%s", op->name);
+			break;
+	}
+
+	if( op->size == 0 )
+		sprintf(str, "??? ($%02X)", r->opcode);
+}
+
+int main(int args, char *argv[]) {
+
+	int opt;
+	unsigned long int i;
+	unsigned long int last = 0;
+	unsigned long int count;
+	unsigned long int first;
+	char bytes[9];
+	char inst[16];
+	FILE *file;
+	trace_header header;
+	trace_record r;
+	trace_opcode *op;
+
+	setlocale(LC_ALL, "");
+	bindtextdomain(PACKAGE, LOCALEDIR);
+	textdomain(PACKAGE);
+
+	while( (opt = getopt(args, argv, "n:h?")) != -1 ) {
+		switch(opt) {
+			case 'n':
+				last = strtoul(optarg, NULL, 10);
+				break;
+			default:
+				usage(stderr, argv);
+				return EXIT_FAILURE;
+		}
+	}
+	if( optind != args - 1 ) {
+		usage(stderr, argv);
+		return EXIT_FAILURE;
+	}
+
+	file = fopen(argv[optind], "rb");
+	if( file == NULL ) {
+		fprintf(stderr,_("Error while opening trace file '%s': "), argv[optind]);
+		perror(NULL);
+		return EXIT_FAILURE;
+	}
+
+	if( fread(&header, sizeof(trace_header), 1, file) != 1 ||
+	    memcmp(header.magic, TRACE_MAGIC, 8) ||
+	    header.version != TRACE_VERSION ||
+	    header.record_size != sizeof(trace_record) ||
+	    header.capacity == 0 || header.next >= header.capacity ) {
+		fprintf(stderr,_("'%s' is not a valid ImaNES trace file\n"), argv[optind]);
+		fclose(file);
+		return EXIT_FAILURE;
+	}
+
+	/* Records are in the ring from the oldest one */
+	count = header.total < header.capacity ? (unsigned long int)header.total : header.capacity;
+	if( last && last < count )
+		count = last;
+	first = (header.next + header.capacity - count) % header.capacity;
+
+	printf(_("# %llu instructions traced, showing the last %lu\n"),
+	       (unsigned long long)header.total, count);
+	printf("# %-8s %4s %12s  %-4s %-8s  %-13s %s\n", _("frame"), _("line"),
+	       _("cycle"), "PC", _("bytes"), _("instruction"), _("registers"));
+
+	for(i=0; i!=count; i++) {
+
+		fseek(file, TRACE_HEADER_SIZE + sizeof(trace_record)*((first + i) % header.capacity), SEEK_SET);
+		if( fread(&r, sizeof(trace_record), 1, file) != 1 ) {
+			fprintf(stderr,_("Trace file '%s' is truncated\n"), argv[optind]);
+			fclose(file);
+			return EXIT_FAILURE;
+		}
+
+		op = &header.opcodes[r.opcode];
+		switch( op->size ) {
+			case 2:  sprintf(bytes, "%02X %02X",      r.opcode, r.operands[0]); break;
+			case 3:  sprintf(bytes, "%02X %02X %02X", r.opcode, r.operands[0], r.operands[1]); break;
+			default: sprintf(bytes, "%02X",           r.opcode); break;
+		}
+		disassemble(&r, op, inst);
+
+		printf("  %-8u %4d %12llu  %04X %-8s  %-13s A:%02X X:%02X Y:%02X P:%02X SP:%02X\n",
+		       r.frame, r.scanline, (unsigned long long)r.cycle, r.PC, bytes, inst,
+		       r.A, r.X, r.Y, r.SR, r.SP);
+	}
+
+	fclose(file);
+	return EXIT_SUCCESS;
+}
@@ -32,10 +32,16 @@
 #include "instruction_set.h"
 #include "loop.h"
 #include "mapper.h"
+#include "pad.h"
 #include "playback.h"
 #include "ppu.h"
+#include "present.h"
+#include "profiler.h"
 #include "screen.h"
+#include "sram.h"
 #include "states.h"
+#include "telemetry.h"
+#include "trace.h"
 
 /* When VBLANK ends, we clear some flags */
 #define END_VBLANK() \
@@ -51,16 +57,61 @@
 
 int run_loop;
 
+/* Lowers budget to the given limit */
+#define LIMIT_BUDGET(budget, limit) \
+	do { \
+		if( (limit) < (budget) ) \
+			(budget) = (limit); \
+	} while(0)
+
+/* Returns how many CPU cycles can be run before any of the events that
+ * the main loop checks between instructions may happen. Instructions
+ * are run in batches that fit in this budget */
+static int cycles_to_next_event() {
+
+	int budget;
+
+	/* Unmasked pending IRQs and mappers clocked by the CPU need
+	 * to be checked after each instruction */
+	if( (CPU->irq && !(CPU->SR & I_FLAG)) || mapper->clock_cpu )
+		return 0;
+
+	/* End of the scanline, and VBLANK flag set near the end of line 240 */
+	budget = (PPU->scanline_timeout - 2)/3;
+
+	/* Next A12 rising edge */
+	if( PPU->a12_next_edge < PPU->a12_edge_count )
+		LIMIT_BUDGET(budget, (PPU->a12_edges[PPU->a12_next_edge] -
+		             (CYCLES_PER_SCANLINE - PPU->scanline_timeout) - 1)/3);
+
+	/* VBLANK flag clear */
+	if( PPU->SR & VBLANK_FLAG )
+		LIMIT_BUDGET(budget, (6820 - (int)CLK->nmi_pcycles - 1)/3);
+
+	/* APU timers */
+	LIMIT_BUDGET(budget, (APU->frame_seq.clock_timeout - 1)/3);
+	LIMIT_BUDGET(budget, APU->triangle.timer.timeout - 1);
+	LIMIT_BUDGET(budget, APU->square1.timer.timeout - 1);
+	LIMIT_BUDGET(budget, APU->square2.timer.timeout - 1);
+	LIMIT_BUDGET(budget, APU->noise.timer.timeout - 1);
+	LIMIT_BUDGET(budget, APU->dmc.timer.timeout - 1);
+
+	return budget;
+}
+
 int main_loop(void *args) {
 
 	uint8_t opcode;
 	int added_cycles;
+	int inst_cycles;
+	int budget;
 	int standard_lines;
 	int vblank_ended = 0;
-	int a12_raised = 0;
+	int render = 1;
 	unsigned long int ppu_cycles;
 	operand operand = { 0, 0 };
-	instruction inst;
+	const instruction *inst;
+	decoded_inst *decoded;
 
 	ppu_cycles = 0;
 	standard_lines = 0;
@@ -73,6 +124,7 @@ int main_loop(void *args) {
 
 	playback_pause(0);
 	execute_reset();
+	schedule_a12_edges((int)PPU->lines);
 
 	/* This is the main loop */
 	for(run_loop = 1;run_loop;) {
@@ -83,6 +135,7 @@ int main_loop(void *args) {
 		 * We also check if the user wants to quit the emulation */
 		if( config.pause && run_loop ) {
 			playback_pause(1);
+			present_flush();
 			gui_set_background();
 			gui_loop();
 			playback_pause(0);
@@ -94,12 +147,17 @@ int main_loop(void *args) {
 		if( CPU->reset )
 			execute_reset();
 
-		/* A12 rising edge occurs at PPU cycle #260 on the scanline */
-		if( !a12_raised && PPU->scanline_timeout <= 76 && (int)PPU->lines < NES_SCREEN_HEIGHT ) {
+		/* Signal the A12 rising edges that the PPU fetches
+		 * have produced so far in this scanline */
+		while( PPU->a12_next_edge < PPU->a12_edge_count &&
+		       CYCLES_PER_SCANLINE - PPU->scanline_timeout >= PPU->a12_edges[PPU->a12_next_edge] ) {
 			mapper->update();
-			a12_raised = 1;
+			PPU->a12_next_edge++;
 		}
 
+		/* Service any pending hardware IRQ */
+		check_irq_line();
+
 		/* If we want to save our current state or load a new one,
 		 * now is the time to do it! */
 		if( config.save_state == 1 ) {
@@ -112,57 +170,80 @@ int main_loop(void *args) {
 			ppu_cycles = CLK->ppu_cycles;
 		}
 
-		/* Read opcode and full instruction :) */
-		/* We don't read with read_cpu_ram since we're in PGR RAM section
-		   and there's nor mirroring nor mm IOs there */
-		opcode = CPU->RAM[CPU->PC];
-		inst = instructions[opcode];
-
-		DEBUG( printf("%04.0f 0x%04x - %02x: ",CLK->nmi_pcycles/3., CPU->PC, opcode) );
-		/* Undocumented instruction */
-		if( inst.size == 0 ) {
-			fprintf(stderr,_("\n\nUndocumented instruction: %02X\n"),opcode);
-			fprintf(stderr,_("I'm exiting now... sorry :(\n"));
-			fprintf(stderr,_("Close the window when finished\n"));
-			return -1;
-		}
-
-		/* Select operand depending on the addressing node */
-		get_operand(&inst, &operand);
+		/* Run all the instructions that fit before the next event in
+		 * a batch. They are not traced, so keep out when debugging */
+		inst_cycles = 0;
+		if( !VERBOSE(DEBUG_LEVEL) && (budget = cycles_to_next_event()) > 0 )
+			inst_cycles = run_until(CLK->ppu_cycles + 3*budget);
+
+		if( !inst_cycles ) {
+
+			/* Read opcode and full instruction :) */
+			/* We don't read with read_cpu_ram since we're in PGR RAM section
+			   and there's nor mirroring nor mm IOs there */
+			opcode = CPU->RAM[CPU->PC];
+			decoded = fetch_decoded(CPU->PC);
+			inst = decoded->inst;
+
+			TRACE_INSTRUCTION();
+			PROFILE_INSTRUCTION();
+			DEBUG( printf("%04.0f 0x%04x - %02x: ",CLK->nmi_pcycles/3., CPU->PC, opcode) );
+			/* Undocumented instruction */
+			if( inst->size == 0 ) {
+				fprintf(stderr,_("\n\nUndocumented instruction: %02X\n"),opcode);
+				fprintf(stderr,_("I'm exiting now... sorry :(\n"));
+				fprintf(stderr,_("Close the window when finished\n"));
+				return -1;
+			}
 
-		/* Clear the VBLANK flag if the execution of the instruction
-		 * passes the instant when the VBLANK flag is cleared */
-		if( CLK->nmi_pcycles + inst.cycles*3 >= 6820 &&
-		    (PPU->SR&VBLANK_FLAG) )
-			END_VBLANK();
+			/* Select operand depending on the addressing node. Operands
+			 * that don't depend on the registers come already decoded */
+			if( decoded->dynamic || VERBOSE(DEBUG_LEVEL) )
+				get_operand(inst, &operand);
+			else
+				operand = decoded->oper;
+
+			/* Clear the VBLANK flag if the execution of the instruction
+			 * passes the instant when the VBLANK flag is cleared */
+			if( CLK->nmi_pcycles + inst->cycles*3 >= 6820 &&
+			    (PPU->SR&VBLANK_FLAG) )
+				END_VBLANK();
+
+			/* Set the VBLANK flag if the execution of the instruction
+			 * passes the instant when the VBLANK flag is set */
+			if( (PPU->lines == NES_SCREEN_HEIGHT) && PPU->scanline_timeout <= 1 )
+				PPU->SR |= VBLANK_FLAG;
 
-		/* Set the VBLANK flag if the execution of the instruction
-		 * passes the instant when the VBLANK flag is set */
-		if( (PPU->lines == NES_SCREEN_HEIGHT) && PPU->scanline_timeout <= 1 )
-			PPU->SR |= VBLANK_FLAG;
+			/* Execute the given instruction */
+			decoded->handler(inst, &operand);
 
-		/* Execute the given instruction */
-		execute_instruction(&inst, &operand);
+			XTREME( dump_cpu() );
+			CPU->PC += inst->size;
 
-		XTREME( dump_cpu() );
-		CPU->PC += inst.size;
+			/* Update cycles count */
+			ADD_CPU_CYCLES(inst->cycles);
+			inst_cycles = inst->cycles;
+			COUNT(instructions, 1);
+		}
 
-		/* Update cycles count */
-		ADD_CPU_CYCLES(inst.cycles);
 		added_cycles = (int)(CLK->ppu_cycles - ppu_cycles);
 		ppu_cycles = CLK->ppu_cycles;
 
 		/* Decrement PPU scanline timeout */
 		PPU->scanline_timeout -= added_cycles;
 
+		/* Some mappers have counters and audio driven by the CPU clock */
+		if( mapper->clock_cpu )
+			mapper->clock_cpu(added_cycles/3);
+
 		/* Decrement APU timers. Only the frame sequencer is measured
 		 * in PPU cycles; the rest are driven by the CPU clock. */
 		APU->frame_seq.clock_timeout -= added_cycles;
-		APU->triangle.timer.timeout -= inst.cycles;
-		APU->square1.timer.timeout -= inst.cycles;
-		APU->square2.timer.timeout -= inst.cycles;
-		APU->noise.timer.timeout -= inst.cycles;
-		APU->dmc.timer.timeout -= inst.cycles;
+		APU->triangle.timer.timeout -= inst_cycles;
+		APU->square1.timer.timeout -= inst_cycles;
+		APU->square2.timer.timeout -= inst_cycles;
+		APU->noise.timer.timeout -= inst_cycles;
+		APU->dmc.timer.timeout -= inst_cycles;
 
 		/* Check if we need to clock any of the
 		 * APU timers.
@@ -191,12 +272,6 @@ int main_loop(void *args) {
 		/* A line has ended its scanning, draw it */
 		if( PPU->scanline_timeout <= 0 ) {
 
-			/* Clear A12 flag to check again in the next line */
-			a12_raised = 0;
-
-			/* Get the user's input and process it */
-			screen_loop();
-
 			/* Set again the timeout to check the scanline */
 			PPU->scanline_timeout += CYCLES_PER_SCANLINE;
 			if( (PPU->CR2 & SHOW_BACKGROUND) && !(PPU->frames%2) && (PPU->lines == 19) )
@@ -215,10 +290,11 @@ int main_loop(void *args) {
 			 **/
 
 			if( (int)PPU->lines < NES_SCREEN_HEIGHT ) {
-				draw_line(PPU->lines++, PPU->frames);
-				if( PPU->lines == (NES_SCREEN_HEIGHT - 8) &&
-				    (!config.run_fast || !(PPU->frames%2)) )
-					redraw_screen();
+				TELEMETRY_TIMER(PPUTime);
+				draw_line(PPU->lines++, render);
+				if( PPU->lines == (NES_SCREEN_HEIGHT - 8) && render )
+					publish_frame();
+				TELEMETRY_TIMER(CPUTime);
 			}
 
 			/* Start VBLANK period */
@@ -246,10 +322,25 @@ int main_loop(void *args) {
 					PPU->lines = -1;
 					END_VBLANK();
 					vblank_ended = 0;
+					telemetry_frame(render);
+					check_sram();
+					TELEMETRY_TIMER(SleepTime);
 					frame_sleep();
 
+					/* Get the user's input, unless the game
+					 * already did it when reading the pads */
+					TELEMETRY_TIMER(HostTime);
+					end_input_frame();
+					TELEMETRY_TIMER(CPUTime);
+					render = render_next_frame();
+
 				}
 			}
+
+			/* Calculate the A12 edges for the new scanline */
+			schedule_a12_edges((int)PPU->lines);
+			if( mapper->scanline )
+				mapper->scanline((int)PPU->lines);
 		}
 
 	}
@@ -18,9 +18,12 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <errno.h>
+#include <limits.h>
 #include <locale.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifdef _MSC_VER
 #include "XGetopt.h"
@@ -44,8 +47,15 @@
 #include "parse_file.h"
 #include "playback.h"
 #include "ppu.h"
+#include "profiler.h"
+#include "recorder.h"
 #include "screen.h"
+#include "screenshot.h"
 #include "sram.h"
+#include "states.h"
+#include "telemetry.h"
+#include "trace.h"
+#include "translator.h"
 
 void usage(FILE *file, char *argv[]) {
 	fprintf(file,_("\n%s: I'm a NES\n\n"), PACKAGE_NAME);
@@ -53,10 +63,33 @@ void usage(FILE *file, char *argv[]) {
 	fprintf(file,_("For bug reports, please refer to %s\n\n"), PACKAGE_BUGREPORT);
 	fprintf(file,_("Usage: %s [options] <rom file>\n\n"),argv[0]);
 	fprintf(file,_("Options:\n"));
-	fprintf(file,_("  -v        Increase verbosity. More -v, more verbose. Default: 0\n"));
+	fprintf(file,_("  -v        Increase verbosity. More -v, more verbose. Levels above %d\n"
+	               "            need the imanes-debug build. Default: 0\n"), MAX_VERBOSITY);
 	fprintf(file,_("  -s <n>    Video scaling factor. Default: 1\n"));
 	fprintf(file,_("  -c        Use SDL color construction. Default: no\n"));
-	fprintf(file,_("  -m        Mute sound. Default: no\n\n"));
+	fprintf(file,_("  -y        Show frames from the emulation thread. Default: no\n"));
+	fprintf(file,_("  -n        Simulate the NTSC composite video signal. Needs a video\n"
+	               "            scaling factor of 2 or more. Default: no\n"));
+	fprintf(file,_("  -p <file> Load the system palette from a .pal file of 64 or 512\n"
+	               "            RGB colors. Default: built-in palette\n"));
+	fprintf(file,_("  -f <n>    Frames skipped after each drawn one. 'auto' skips frames to\n"
+	               "            keep real time, 'never' doesn't draw at all. Default: 0\n"));
+	fprintf(file,_("  -m        Mute sound. Default: no\n"));
+	fprintf(file,_("  -a        Pace frames following the audio device clock. Default: no\n"));
+	fprintf(file,_("  -t        Translate PRG-ROM code into native code (x86-64). Default: no\n"));
+	fprintf(file,_("  -i        Interpret idle loops instead of skipping them. Default: no\n"));
+	fprintf(file,_("  -T <file> Record the last executed instructions in a binary trace\n"
+	               "            file, to be read with imanes-trace. Default: no\n"));
+	fprintf(file,_("  -P <file> Count executions and cycles per address, opcode and I/O\n"
+	               "            register, and write the report and the collapsed call\n"
+	               "            stacks (<file>.folded) at exit. Default: no\n"));
+	fprintf(file,_("  -M <dest> Report performance counters every second to a file, or to\n"
+	               "            a Unix datagram socket with 'unix:<path>'. Default: no\n"));
+	fprintf(file,_("  -D <dir>  Save every shown frame into the given directory. Default: no\n"));
+	fprintf(file,_("  -F <fmt>  Format of screenshots and frame dumps: 'png', or 'raw' for\n"
+	               "            one palette index per pixel. Default: png\n"));
+	fprintf(file,_("  -R <file> Record the shown frames and the played audio, losslessly\n"
+	               "            encoded against the previous frame. Default: no\n\n"));
 	fprintf(file,_("  -h,-?     Show this help and exit\n"));
 	fprintf(file,_("  -V        Show the current version of ImaNES and exit\n\n"));
 	fprintf(file,_("ImaNES development is maintained by Rodrigo Tobar <rtobar@csrg.inf.utfsm.cl>\n"));
@@ -75,16 +108,22 @@ void print_version() {
 int parse_options(int args, char *argv[]) {
 
 	int opt;
+	long frame_skip;
+	char *end;
 
 	config.verbosity = 0;
 
-	while( (opt = getopt(args, argv, "mcvhHVs:?")) != -1 ) {
+	while( (opt = getopt(args, argv, "mactinvyhHVs:f:p:T:P:M:D:F:R:?")) != -1 ) {
 
 		switch(opt) {
 			case 'm':
 				config.sound_mute = 1;
 				break;
 
+			case 'a':
+				config.audio_pacing = 1;
+				break;
+
 			case 'v':
 				config.verbosity++;
 				break;
@@ -101,6 +140,74 @@ int parse_options(int args, char *argv[]) {
 				config.use_sdl_colors = 1;
 				break;
 
+			case 'y':
+				config.present_thread = 0;
+				break;
+
+			case 'n':
+				config.ntsc_filter = 1;
+				break;
+
+			case 'p':
+				config.palette_file = optarg;
+				break;
+
+			case 't':
+				config.translate_blocks = 1;
+				break;
+
+			case 'i':
+				config.skip_idle_loops = 0;
+				break;
+
+			case 'T':
+				config.trace_file = optarg;
+				break;
+
+			case 'P':
+				config.profile_file = optarg;
+				break;
+
+			case 'M':
+				config.telemetry = optarg;
+				break;
+
+			case 'D':
+				config.dump_dir = optarg;
+				break;
+
+			case 'R':
+				config.record_file = optarg;
+				break;
+
+			case 'F':
+				if( !strcmp(optarg, "png") )
+					config.capture_format = CAPTURE_PNG;
+				else if( !strcmp(optarg, "raw") )
+					config.capture_format = CAPTURE_RAW;
+				else {
+					fprintf(stderr,_("Error: invalid capture format. Must be 'png' or 'raw'\n"));
+					return -1;
+				}
+				break;
+
+			case 'f':
+				if( !strcmp(optarg, "auto") )
+					config.frame_skip = FRAME_SKIP_AUTO;
+				else if( !strcmp(optarg, "never") )
+					config.frame_skip = FRAME_SKIP_NEVER;
+				else {
+					errno = 0;
+					frame_skip = strtol(optarg, &end, 10);
+					if( end == optarg || *end != '\0' || errno == ERANGE ||
+					    frame_skip < 0 || frame_skip > INT_MAX ) {
+						fprintf(stderr,_("Error: invalid frame skipping. Must be a positive integer, 'auto' or 'never'\n"));
+						return -1;
+					}
+					config.frame_skip = (int)frame_skip;
+				}
+				break;
+
 			case '?':
 			case 'h':
 			case 'H':
@@ -122,14 +229,18 @@ int parse_options(int args, char *argv[]) {
 		return -1;
 	}
 
+	if( config.verbosity > MAX_VERBOSITY )
+		fprintf(stderr,_("Warning: this build is only verbose up to level %d, use imanes-debug for more\n"), MAX_VERBOSITY);
+
 	return 1;
 }
 
 int main(int args, char *argv[]) {
 
-	char *save_file;
 	ines_file *nes_rom;
 
+	telemetry_startup();
+
 	/* Print NOW everything :D */
 #ifdef _MSC_VER
 	setvbuf(stdout,NULL,_IONBF,0);
@@ -172,24 +283,54 @@ int main(int args, char *argv[]) {
 	config.rom_file = argv[optind];
 	nes_rom = check_ines_file(config.rom_file);
 	map_rom_memory(nes_rom);
-	save_file = load_sram(config.rom_file);
+	initialize_translator(nes_rom);
+	initialize_states();
+
+	/* Every instruction is traced or profiled, so none can
+	 * be skipped or translated */
+	if( config.trace_file != NULL ) {
+		if( initialize_trace(config.trace_file) )
+			exit(EXIT_FAILURE);
+		config.skip_idle_loops = 0;
+		config.translate_blocks = 0;
+	}
+	if( config.profile_file != NULL ) {
+		initialize_profiler((unsigned long)nes_rom->romBanks16k * ROM_BANK_SIZE);
+		config.skip_idle_loops = 0;
+		config.translate_blocks = 0;
+	}
+	initialize_sram(config.rom_file);
 
 	/* Init the graphics engine */
 	init_screen();
 	init_gui();
+	initialize_capture();
+	if( config.record_file != NULL && initialize_recording(config.record_file) )
+		exit(EXIT_FAILURE);
+
+	if( config.telemetry != NULL && initialize_telemetry(config.telemetry) )
+		exit(EXIT_FAILURE);
 
 	/* Main execution loop */
 	main_loop();
+	end_telemetry();
 
-	/* After finishing the emulation, save the SRAM if necessary */
-	save_sram(save_file);
-	free(save_file);
+	/* After finishing the emulation, save the last SRAM changes */
+	end_sram();
 
 	/* Free all the used resources */
+	end_states();
 	mapper->end_mapper();
+	end_capture();
+	end_recording();
+	end_pads();
 	end_screen();
 	end_gui();
 	end_ppu();
+	end_translator();
+	end_trace();
+	end_profiler(config.profile_file);
+	end_instruction_set();
 	end_cpu();
 	end_apu();
 	end_playback();
@@ -21,13 +21,19 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "axrom.h"
 #include "cnrom.h"
+#include "fme7.h"
 #include "i18n.h"
 #include "mapper.h"
 #include "mmc1.h"
+#include "mmc2.h"
 #include "mmc3.h"
+#include "mmc5.h"
 #include "nrom.h"
 #include "unrom.h"
+#include "vrc6.h"
+#include "vrc7.h"
 
 nes_mapper *mapper;
 
@@ -42,6 +48,29 @@ nes_mapper mapper_list[] = {
 	  cnrom_switch_banks, cnrom_reset, cnrom_update, cnrom_end_mapper } ,
 	{ MMC3_ID , "MMC3" , 8, mmc3_initialize_mapper , mmc3_check_address,
 	  mmc3_switch_banks , mmc3_reset,  mmc3_update , mmc3_end_mapper } ,
+	{ MMC5_ID , "MMC5" , 0, mmc5_initialize_mapper , mmc5_check_address,
+	  mmc5_switch_banks , mmc5_reset,  mmc5_update , mmc5_end_mapper,
+	  mmc5_clock_cpu, mmc5_scanline, NULL, mmc5_fetch_bg_tile } ,
+	{ AXROM_ID, "AxROM", 1, axrom_initialize_mapper, axrom_check_address,
+	  axrom_switch_banks, axrom_reset, axrom_update, axrom_end_mapper } ,
+	{ MMC2_ID , "MMC2" , 6, mmc2_initialize_mapper , mmc2_check_address,
+	  mmc2_switch_banks , mmc2_reset,  mmc2_update , mmc2_end_mapper,
+	  NULL, NULL, mmc2_latch_chr, NULL } ,
+	{ MMC4_ID , "MMC4" , 6, mmc4_initialize_mapper , mmc2_check_address,
+	  mmc2_switch_banks , mmc2_reset,  mmc2_update , mmc2_end_mapper,
+	  NULL, NULL, mmc2_latch_chr, NULL } ,
+	{ VRC6A_ID, "VRC6a", 11, vrc6_initialize_mapper, vrc6_check_address,
+	  vrc6_switch_banks, vrc6_reset, vrc6_update, vrc6_end_mapper,
+	  vrc6_clock_cpu, NULL, NULL, NULL } ,
+	{ VRC6B_ID, "VRC6b", 11, vrc6b_initialize_mapper, vrc6_check_address,
+	  vrc6_switch_banks, vrc6_reset, vrc6_update, vrc6_end_mapper,
+	  vrc6_clock_cpu, NULL, NULL, NULL } ,
+	{ FME7_ID , "FME-7", 13, fme7_initialize_mapper, fme7_check_address,
+	  fme7_switch_banks, fme7_reset, fme7_update, fme7_end_mapper,
+	  fme7_clock_cpu, NULL, NULL, NULL, fme7_sram } ,
+	{ VRC7_ID , "VRC7" , 12, vrc7_initialize_mapper, vrc7_check_address,
+	  vrc7_switch_banks, vrc7_reset, vrc7_update, vrc7_end_mapper,
+	  vrc7_clock_cpu, NULL, NULL, NULL } ,
 	{ 98, "UNROM", 1, unrom_initialize_mapper, unrom_check_address,
 	  unrom_switch_banks, unrom_reset, unrom_update, unrom_end_mapper } ,
 	{ -1 }
@@ -62,3 +91,40 @@ void dump_mapper() {
 		printf(_("<no registers>\n"));
 	}
 }
+
+unsigned int mapper_state_size() {
+
+	unsigned int i;
+	unsigned int size = mapper->reg_count;
+
+	for(i=0; i!=mapper->state_count; i++)
+		size += mapper->state[i].size;
+
+	return size;
+}
+
+void save_mapper_state(uint8_t *buffer) {
+
+	unsigned int i;
+
+	memcpy(buffer, mapper->regs, mapper->reg_count);
+	buffer += mapper->reg_count;
+
+	for(i=0; i!=mapper->state_count; i++) {
+		memcpy(buffer, mapper->state[i].data, mapper->state[i].size);
+		buffer += mapper->state[i].size;
+	}
+}
+
+void load_mapper_state(const uint8_t *buffer) {
+
+	unsigned int i;
+
+	memcpy(mapper->regs, buffer, mapper->reg_count);
+	buffer += mapper->reg_count;
+
+	for(i=0; i!=mapper->state_count; i++) {
+		memcpy(mapper->state[i].data, buffer, mapper->state[i].size);
+		buffer += mapper->state[i].size;
+	}
+}
@@ -28,6 +28,14 @@
 #include "mmc1.h"
 #include "ppu.h"
 
+/* Serial port: bits written so far, and their value */
+static uint8_t shifts;
+static int saved;
+
+static const mapper_state mmc1_state[] = {
+	MAPPER_STATE(shifts),
+	MAPPER_STATE(saved)
+};
 
 void mmc1_initialize_mapper() {
 
@@ -35,21 +43,21 @@ void mmc1_initialize_mapper() {
 	memset(mapper->regs,0,4);
 
 	mapper->regs[0] = 0x04; /* Swap 0x8000 by default */
+
+	shifts = 0;
+	saved = 0;
+	mapper->state = mmc1_state;
+	mapper->state_count = MAPPER_STATES(mmc1_state);
 	return;
 }
 
-int  mmc1_check_address(uint16_t address) {
+int  mmc1_check_address(uint16_t address, uint8_t value) {
 
-	uint8_t value;
 	static uint8_t prev[4] = {0,0,0,0};
-	static uint8_t shifts = 0;
-	static int saved = 0;
 
 	/* Save the entering value */
 	if( 0x8000 <= address ) {
 
-		value = CPU->RAM[address];
-
 		if( value & 0x80 ) {
 			shifts = 0;
 			saved = 0;
@@ -156,7 +164,7 @@ void mmc1_switch_banks() {
 			DEBUG( printf(_("MMC1: Switching 8 Kb VROM bank %d. Offset is "),  bank) );
 			offset = bank * VROM_BANK_SIZE/2;
 			DEBUG( printf("%04x\n", offset) );
-			memcpy( PPU->VRAM, mapper->file->vrom+offset, VROM_BANK_SIZE);
+			SWAP_VRAM(0, mapper->file->vrom+offset, VROM_BANK_SIZE);
 		}
 		else {
 			bank = mapper->regs[1]&0x1F;
@@ -164,13 +172,13 @@ void mmc1_switch_banks() {
 
 			offset = bank * VROM_BANK_SIZE/2;
 			DEBUG( printf("%04x/", offset) );
-			memcpy( PPU->VRAM, mapper->file->vrom + offset,
-			        VROM_BANK_SIZE/2);
+			SWAP_VRAM(0, mapper->file->vrom + offset,
+			          VROM_BANK_SIZE/2);
 			bank = (mapper->regs[2] & 0x1F);
 			offset = bank * VROM_BANK_SIZE/2;
 			DEBUG( printf("%04x\n", offset) );
-			memcpy( PPU->VRAM+0x1000, mapper->file->vrom + offset,
-			        VROM_BANK_SIZE/2);
+			SWAP_VRAM(0x1000, mapper->file->vrom + offset,
+			          VROM_BANK_SIZE/2);
 		}
 
 	}
@@ -199,8 +207,8 @@ void mmc1_switch_banks() {
 			bank = (mapper->regs[3] & 0x0E);
 			offset += bank * ROM_BANK_SIZE;
 			DEBUG( printf(_("MMC1: Switching 32 Kb ROM bank %d and offset %04x to 0x8000\n"), bank, offset) );
-			memcpy( CPU->RAM+0x8000, mapper->file->rom + offset,
-			        ROM_BANK_SIZE*2);
+			SWAP_RAM(0x8000, mapper->file->rom + offset,
+			         ROM_BANK_SIZE*2);
 		}
 		else {
 			bank = (mapper->regs[3] & 0x0F);
@@ -208,11 +216,11 @@ void mmc1_switch_banks() {
 			DEBUG( printf(_("MMC1: Switching 16 Kb ROM bank %d and offset %04x to %04x\n"), bank, offset, 0x8000 + (mapper->regs[0]&0x04?0:0x4000)) );
 
 			/* Depending where we switch banks, the other remains hard-wired */
-			memcpy( CPU->RAM+0x8000 + ( mapper->regs[0]&0x04 ? 0 : 0x4000),
-			        mapper->file->rom + offset, ROM_BANK_SIZE);
+			SWAP_RAM(0x8000 + ( mapper->regs[0]&0x04 ? 0 : 0x4000),
+			         mapper->file->rom + offset, ROM_BANK_SIZE);
 			offset = ( mapper->regs[0]&0x04 ? mapper->file->romBanks16k-1 : 0) * ROM_BANK_SIZE;
-			memcpy( CPU->RAM+0xC000 - ( mapper->regs[0]&0x04 ? 0 : 0x4000),
-			        mapper->file->rom + offset, ROM_BANK_SIZE);
+			SWAP_RAM(0xC000 - ( mapper->regs[0]&0x04 ? 0 : 0x4000),
+			         mapper->file->rom + offset, ROM_BANK_SIZE);
 		}
 	}
 
@@ -220,10 +228,10 @@ void mmc1_switch_banks() {
 
 void mmc1_reset() {
 
-	memcpy(CPU->RAM+0x8000, mapper->file->rom, ROM_BANK_SIZE);
-	memcpy(CPU->RAM+0xC000,
-	       mapper->file->rom + (mapper->file->romBanks16k-1)*ROM_BANK_SIZE,
-	       ROM_BANK_SIZE);
+	SWAP_RAM(0x8000, mapper->file->rom, ROM_BANK_SIZE);
+	SWAP_RAM(0xC000,
+	         mapper->file->rom + (mapper->file->romBanks16k-1)*ROM_BANK_SIZE,
+	         ROM_BANK_SIZE);
 
 }
 
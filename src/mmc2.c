@@ -0,0 +1,174 @@
+/*  ImaNES: I'm a NES. An intelligent NES emulator
+
+    mmc2.c   -    MMC2 and MMC4 Mappers emulation under ImaNES
+
+    Copyright (C) 2009   Rodrigo Tobar Carrizo
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cpu.h"
+#include "debug.h"
+#include "i18n.h"
+#include "mapper.h"
+#include "mmc2.h"
+#include "ppu.h"
+
+/* MMC4 is almost the same chip, with 16kb PRG banks
+ * and a slightly different latch 0 */
+static int is_mmc4;
+
+/* Latches selecting which CHR register is used for each
+ * pattern table. They hold either 0xFD or 0xFE */
+static uint8_t latch[2];
+
+static const mapper_state mmc2_state[] = {
+	MAPPER_STATE(latch)
+};
+
+void mmc2_initialize_mapper() {
+
+	mapper->regs = (uint8_t *)malloc(6);
+	memset(mapper->regs, 0, 6);
+
+	is_mmc4 = 0;
+	latch[0] = 0xFE;
+	latch[1] = 0xFE;
+
+	mapper->state = mmc2_state;
+	mapper->state_count = MAPPER_STATES(mmc2_state);
+	return;
+}
+
+void mmc4_initialize_mapper() {
+
+	mmc2_initialize_mapper();
+	is_mmc4 = 1;
+
+	return;
+}
+
+static void mmc2_perform_vram_swap(int table) {
+
+	int bank;
+
+	/* Register for 0xFD comes first, then 0xFE */
+	bank = mapper->regs[1 + table*2 + (latch[table] == 0xFE)];
+	bank %= (mapper->file->vromBanks*2);
+	SWAP_VRAM(table*0x1000, mapper->file->vrom + bank*0x1000, 0x1000);
+
+}
+
+int mmc2_check_address(uint16_t address, uint8_t value) {
+
+	if( address < 0xA000 )
+		return 0;
+
+	switch( address & 0xF000 ) {
+
+		/* PRG bank */
+		case 0xA000:
+			mapper->regs[0] = value & 0x0F;
+			return 1;
+
+		/* CHR banks: $0000/FD, $0000/FE, $1000/FD, $1000/FE */
+		case 0xB000:
+		case 0xC000:
+		case 0xD000:
+		case 0xE000:
+			mapper->regs[1 + ((address - 0xB000) >> 12)] = value & 0x1F;
+			return 1;
+
+		case 0xF000:
+			mapper->regs[5] = value & 0x01;
+			return 1;
+
+	}
+
+	return 0;
+}
+
+void mmc2_switch_banks() {
+
+	int bank;
+
+	if( is_mmc4 ) {
+		bank = mapper->regs[0] % mapper->file->romBanks16k;
+		SWAP_RAM_16K(0x8000, bank);
+	}
+	else {
+		bank = mapper->regs[0] % mapper->file->romBanks8k;
+		SWAP_RAM_8K(0x8000, bank);
+	}
+
+	mmc2_perform_vram_swap(0);
+	mmc2_perform_vram_swap(1);
+
+	PPU->mirroring = mapper->regs[5] ? HORIZONTAL_MIRRORING : VERTICAL_MIRRORING;
+
+}
+
+void mmc2_reset() {
+
+	/* The last three 8kb banks are fixed (the last 16kb for MMC4) */
+	if( is_mmc4 )
+		SWAP_RAM_16K(0xC000, mapper->file->romBanks16k - 1);
+	else {
+		SWAP_RAM_8K(0xA000, mapper->file->romBanks8k - 3);
+		SWAP_RAM_8K(0xC000, mapper->file->romBanks8k - 2);
+		SWAP_RAM_8K(0xE000, mapper->file->romBanks8k - 1);
+	}
+
+	mmc2_switch_banks();
+}
+
+void mmc2_update() {
+	return;
+}
+
+void mmc2_latch_chr(uint16_t address) {
+
+	int table;
+	uint8_t value;
+
+	/* MMC2 only latches at the exact 0x0FD8/0x0FE8 addresses
+	 * for the first pattern table, the rest use the whole tile row */
+	table = (address & 0x1000) >> 12;
+	if( table || is_mmc4 )
+		address &= 0xFFF8;
+
+	switch( address & 0x0FFF ) {
+		case 0x0FD8:
+			value = 0xFD;
+			break;
+		case 0x0FE8:
+			value = 0xFE;
+			break;
+		default:
+			return;
+	}
+
+	if( latch[table] != value ) {
+		latch[table] = value;
+		mmc2_perform_vram_swap(table);
+	}
+
+}
+
+void mmc2_end_mapper() {
+	free(mapper->regs);
+}
@@ -32,15 +32,25 @@
 static int powering_on;
 
 static int irq_enabled;
-static int irq_triggered;
-static int zero_written;
-static uint8_t irq_tmp;
+static int irq_reload;
+static uint8_t irq_latch;
 static uint8_t irq_counter;
 
 static uint8_t address_cmd;
 static uint8_t prev_address_cmd;
 static uint8_t prev_regs[8];
 
+static const mapper_state mmc3_state[] = {
+	MAPPER_STATE(powering_on),
+	MAPPER_STATE(irq_enabled),
+	MAPPER_STATE(irq_reload),
+	MAPPER_STATE(irq_latch),
+	MAPPER_STATE(irq_counter),
+	MAPPER_STATE(address_cmd),
+	MAPPER_STATE(prev_address_cmd),
+	MAPPER_STATE(prev_regs)
+};
+
 void mmc3_initialize_mapper() {
 
 	mapper->regs = (uint8_t *)malloc(8);
@@ -54,12 +64,12 @@ void mmc3_initialize_mapper() {
 	memset(&prev_regs, 0, 8);
 
 	irq_counter = 0;
-	irq_tmp = 0;
-
-	/* This will prevent for initial updates on the counter */
-	zero_written = 1;
-	irq_triggered = 0;
+	irq_latch = 0;
+	irq_reload = 0;
+	irq_enabled = 0;
 
+	mapper->state = mmc3_state;
+	mapper->state_count = MAPPER_STATES(mmc3_state);
 	return;
 }
 
@@ -124,18 +134,15 @@ void mmc3_perform_ram_swap() {
 
 }
 
-int mmc3_check_address(uint16_t address) {
+int mmc3_check_address(uint16_t address, uint8_t value) {
 
-	uint8_t value;
 	uint8_t tmp;
 
 	if( address < 0x8000 )
 		return 0;
 
-	/* After 0x8000 there's no mirroring, so we can go and
-	 * directly read the RAM memory */
+	/* Registers are mirrored through their whole 8kb ranges */
 	address &= 0xE001;
-	value = CPU->RAM[address];
 
 	/* This only set values, does not take any action */
 	switch(address) {
@@ -206,29 +213,20 @@ int mmc3_check_address(uint16_t address) {
 			break;
 
 		case 0xC000:
-
 			DEBUG( printf(_("MMC3: Writting %02x to 0xC000\n"), value) );
-			if( value ) {
-				irq_tmp = value;
-				zero_written = 0;
-			}
-			else {
-				irq_tmp = 0;
-				if( !zero_written )
-					irq_triggered = 1;
-				zero_written = 1;
-			}
+			irq_latch = value;
 			break;
 
 		case 0xC001:
-			DEBUG( printf(_("MMC3: Resetting counter to 0\n")) );
+			DEBUG( printf(_("MMC3: Reloading counter in the next A12 edge\n")) );
 			irq_counter = 0;
-			zero_written = 0;
-			irq_triggered = 0;
+			irq_reload = 1;
 			break;
 
+		/* Disabling the IRQ also acknowledges any pending one */
 		case 0xE000:
 			irq_enabled = 0;
+			CPU->irq &= ~IRQ_MAPPER;
 			break;
 
 		case 0xE001:
@@ -244,7 +242,15 @@ int mmc3_check_address(uint16_t address) {
 	return 0;
 }
 
+/* Banks are switched as soon as the registers are written, this is
+ * only used to map them again after loading a state */
 void mmc3_switch_banks() {
+
+	SWAP_RAM_8K(0xE000, mapper->file->romBanks8k - 1);
+	mmc3_perform_ram_swap();
+	if( mapper->file->vromBanks != 0 )
+		mmc3_perform_vram_swap();
+
 	return;
 }
 
@@ -268,34 +274,22 @@ void mmc3_reset() {
 
 void mmc3_update() {
 
-	/* Writting 0x00 to 0xC000 will produce a single IRQ 
-	 * The process will be stopped until a non-zero value 
-	 * is written in 0xC000*/
-	if( zero_written ) {
-		if( irq_triggered && irq_enabled ) {
-			DEBUG( printf(_("MMC3: Triggering IRQ caused by 0 writing to 0xC000\n")) );
-			CPU->SR &= ~B_FLAG;
-			execute_irq();
-			irq_triggered = 0;
-		}
-		return;
-	}
-
-	if( irq_counter == 0 ) {
-		irq_counter = irq_tmp+1;
+	/* The counter is reloaded when it reaches 0 or when
+	 * 0xC001 was written, otherwise it is decremented */
+	if( irq_counter == 0 || irq_reload ) {
+		irq_counter = irq_latch;
+		irq_reload = 0;
 		DEBUG( printf(_("MMC3: Setting irq_counter to %u\n"), irq_counter) );
 	}
 	else {
-		if( PPU->CR2 & (SHOW_BACKGROUND|SHOW_SPRITES) ) {
-			irq_counter--;
-			DEBUG( printf(_("MMC3: Decrementing irq_counter. New value: %u\n"), irq_counter) );
-		}
-
-		if( irq_counter == 0 && irq_enabled ) {
-			DEBUG( printf(_("MMC3: Triggering IRQ\n")) );
-			CPU->SR &= ~B_FLAG;
-			execute_irq();
-		}
+		irq_counter--;
+		DEBUG( printf(_("MMC3: Decrementing irq_counter. New value: %u\n"), irq_counter) );
+	}
+
+	/* The IRQ line stays asserted until 0xE000 is written */
+	if( irq_counter == 0 && irq_enabled ) {
+		DEBUG( printf(_("MMC3: Asserting IRQ\n")) );
+		CPU->irq |= IRQ_MAPPER;
 	}
 
 	return;
@@ -0,0 +1,590 @@
+/*  ImaNES: I'm a NES. An intelligent NES emulator
+
+    mmc5.c   -    MMC5 Mapper emulation under ImaNES
+
+    Copyright (C) 2009   Rodrigo Tobar Carrizo
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apu.h"
+#include "cpu.h"
+#include "debug.h"
+#include "i18n.h"
+#include "mapper.h"
+#include "mmc5.h"
+#include "playback.h"
+#include "ppu.h"
+#include "screen.h"
+
+/* ExRAM is kept in its place of the CPU memory map */
+#define EXRAM (CPU->RAM + 0x5C00)
+
+/* CPU cycles between envelope and length counter clocks (240 Hz) */
+#define MMC5_FRAME_CYCLES (7457)
+
+/* MMC5 pulse channels, like the APU ones but without sweep */
+typedef struct _mmc5_pulse {
+	uint16_t period;
+	uint8_t  duty;
+	uint8_t  step;
+	uint8_t  halt;
+	uint8_t  constant;
+	uint8_t  volume;
+	uint8_t  enabled;
+	uint8_t  length;
+	uint8_t  env_start;
+	uint8_t  env_divider;
+	uint8_t  env_counter;
+	int      timeout;
+} mmc5_pulse;
+
+static const uint8_t mmc5_duty_output[4][8] = {
+	{0, 1, 0, 0, 0, 0, 0, 0},
+	{0, 1, 1, 0, 0, 0, 0, 0},
+	{0, 1, 1, 1, 1, 0, 0, 0},
+	{1, 0, 0, 1, 1, 1, 1, 1}
+};
+
+static uint8_t prg_mode;
+static uint8_t chr_mode;
+static uint8_t exram_mode;
+static uint8_t nt_mapping;
+static uint8_t fill_tile;
+static uint8_t fill_attr;
+static uint8_t chr_upper;
+static uint8_t prg_regs[4];
+
+/* CHR registers, and the resulting 1kb banks of both sets.
+ * Set A is used for sprites, set B for the background in 8x16 mode */
+static uint16_t chr_regs[12];
+static int chr_a[8];
+static int chr_b[8];
+static int last_set_b;
+static int vram_set_b;
+
+static uint8_t split_control;
+static uint8_t split_scroll;
+static uint8_t split_bank;
+
+static uint8_t irq_compare;
+static int irq_enabled;
+static int irq_pending;
+static int in_frame;
+static int irq_line;
+
+static uint8_t mult_a;
+static uint8_t mult_b;
+
+static mmc5_pulse pulses[2];
+static uint8_t pcm;
+static int frame_timeout;
+static uint8_t last_sample;
+
+/* The EXRAM lives in 0x5C00-0x5FFF, and is saved with the CPU RAM */
+static const mapper_state mmc5_state[] = {
+	MAPPER_STATE(prg_mode),
+	MAPPER_STATE(chr_mode),
+	MAPPER_STATE(exram_mode),
+	MAPPER_STATE(nt_mapping),
+	MAPPER_STATE(fill_tile),
+	MAPPER_STATE(fill_attr),
+	MAPPER_STATE(chr_upper),
+	MAPPER_STATE(prg_regs),
+	MAPPER_STATE(chr_regs),
+	MAPPER_STATE(chr_a),
+	MAPPER_STATE(chr_b),
+	MAPPER_STATE(last_set_b),
+	MAPPER_STATE(split_control),
+	MAPPER_STATE(split_scroll),
+	MAPPER_STATE(split_bank),
+	MAPPER_STATE(irq_compare),
+	MAPPER_STATE(irq_enabled),
+	MAPPER_STATE(irq_pending),
+	MAPPER_STATE(in_frame),
+	MAPPER_STATE(irq_line),
+	MAPPER_STATE(mult_a),
+	MAPPER_STATE(mult_b),
+	MAPPER_STATE(pulses),
+	MAPPER_STATE(pcm),
+	MAPPER_STATE(frame_timeout),
+	MAPPER_STATE(last_sample)
+};
+
+static uint8_t mmc5_read_irq_status(uint16_t address) {
+
+	uint8_t value;
+
+	/* Reading the status acknowledges the IRQ */
+	value = (irq_pending << 7) | (in_frame << 6);
+	irq_pending = 0;
+	CPU->irq &= ~IRQ_MAPPER;
+
+	return value;
+}
+
+void mmc5_initialize_mapper() {
+
+	/* The last bank is mapped at 0xE000 on power on */
+	prg_mode = 3;
+	memset(prg_regs, 0xFF, 4);
+
+	chr_mode = 0;
+	exram_mode = 0;
+	nt_mapping = 0;
+	fill_tile = 0;
+	fill_attr = 0;
+	chr_upper = 0;
+	memset(chr_regs, 0, sizeof(chr_regs));
+	last_set_b = 0;
+	vram_set_b = 0;
+
+	split_control = 0;
+	split_scroll = 0;
+	split_bank = 0;
+
+	irq_compare = 0;
+	irq_enabled = 0;
+	irq_pending = 0;
+	in_frame = 0;
+	irq_line = 0;
+
+	mult_a = 0xFF;
+	mult_b = 0xFF;
+
+	memset(pulses, 0, sizeof(pulses));
+	pcm = 0;
+	frame_timeout = MMC5_FRAME_CYCLES;
+	last_sample = 0;
+
+	set_read_cpu_ram_f(0x5204, &mmc5_read_irq_status);
+
+	mapper->state = mmc5_state;
+	mapper->state_count = MAPPER_STATES(mmc5_state);
+	return;
+}
+
+/* Calculates the 1kb banks for each one of the CHR sets */
+static void mmc5_calculate_chr_banks() {
+
+	int i;
+
+	for(i=0;i!=8;i++) {
+		switch( chr_mode ) {
+			case 0:
+				chr_a[i] = chr_regs[7]*8 + i;
+				chr_b[i] = chr_regs[11]*8 + i;
+				break;
+			case 1:
+				chr_a[i] = chr_regs[(i & 0x04) + 3]*4 + (i & 0x03);
+				chr_b[i] = chr_regs[11]*4 + (i & 0x03);
+				break;
+			case 2:
+				chr_a[i] = chr_regs[(i & 0x06) + 1]*2 + (i & 0x01);
+				chr_b[i] = chr_regs[8 + (i & 0x02) + 1]*2 + (i & 0x01);
+				break;
+			case 3:
+				chr_a[i] = chr_regs[i];
+				chr_b[i] = chr_regs[8 + (i & 0x03)];
+				break;
+		}
+		chr_a[i] %= (mapper->file->vromBanks*8);
+		chr_b[i] %= (mapper->file->vromBanks*8);
+	}
+
+}
+
+/* The VRAM holds the last written set, which is the one used by both
+ * sprites and background in 8x8 mode. In 8x16 mode it holds set A for
+ * the sprites, and the background is fetched from set B by
+ * mmc5_fetch_bg_tile(). The sprite size can change after the banks have
+ * been written, so this is also checked on each scanline */
+static void mmc5_swap_chr() {
+
+	int i;
+
+	vram_set_b = last_set_b && !(PPU->CR1 & SPRITE_SIZE_8x16);
+	for(i=0;i!=8;i++)
+		SWAP_VRAM_1K(i*0x400, vram_set_b ? chr_b[i] : chr_a[i]);
+}
+
+static void mmc5_write_pulse(mmc5_pulse *pulse, int reg, uint8_t value) {
+
+	switch( reg ) {
+		case 0:
+			pulse->duty     = value >> 6;
+			pulse->halt     = value & 0x20;
+			pulse->constant = value & 0x10;
+			pulse->volume   = value & 0x0F;
+			break;
+		case 2:
+			pulse->period = (pulse->period & 0x0700) | value;
+			break;
+		case 3:
+			pulse->period = (pulse->period & 0x00FF) | ((value & 0x07) << 8);
+			if( pulse->enabled )
+				pulse->length = length_counter_reload_values[value >> 3];
+			pulse->step = 0;
+			pulse->env_start = 1;
+			break;
+	}
+
+}
+
+int mmc5_check_address(uint16_t address, uint8_t value) {
+
+	uint16_t product;
+
+	if( address < 0x5000 || 0x5C00 <= address )
+		return 0;
+
+	/* Audio registers */
+	if( address < 0x5010 ) {
+		mmc5_write_pulse(pulses + ((address & 0x04) >> 2), address & 0x03, value);
+		return 0;
+	}
+
+	switch( address ) {
+
+		case 0x5011:
+			pcm = value;
+			break;
+
+		case 0x5015:
+			pulses[0].enabled = value & 0x01;
+			pulses[1].enabled = value & 0x02;
+			if( !pulses[0].enabled )
+				pulses[0].length = 0;
+			if( !pulses[1].enabled )
+				pulses[1].length = 0;
+			break;
+
+		case 0x5100:
+			prg_mode = value & 0x03;
+			return 1;
+
+		case 0x5101:
+			chr_mode = value & 0x03;
+			return 1;
+
+		case 0x5104:
+			exram_mode = value & 0x03;
+			break;
+
+		case 0x5105:
+			nt_mapping = value;
+			return 1;
+
+		case 0x5106:
+			fill_tile = value;
+			break;
+
+		case 0x5107:
+			fill_attr = value & 0x03;
+			break;
+
+		case 0x5114:
+		case 0x5115:
+		case 0x5116:
+		case 0x5117:
+			prg_regs[address - 0x5114] = value;
+			return 1;
+
+		case 0x5120: case 0x5121: case 0x5122: case 0x5123:
+		case 0x5124: case 0x5125: case 0x5126: case 0x5127:
+		case 0x5128: case 0x5129: case 0x512A: case 0x512B:
+			chr_regs[address - 0x5120] = (chr_upper << 8) | value;
+			last_set_b = (address >= 0x5128);
+			return 1;
+
+		case 0x5130:
+			chr_upper = value & 0x03;
+			break;
+
+		case 0x5200:
+			split_control = value;
+			break;
+
+		case 0x5201:
+			split_scroll = value;
+			break;
+
+		case 0x5202:
+			split_bank = value;
+			break;
+
+		case 0x5203:
+			irq_compare = value;
+			break;
+
+		case 0x5204:
+			irq_enabled = value & 0x80;
+			if( irq_enabled && irq_pending )
+				CPU->irq |= IRQ_MAPPER;
+			else
+				CPU->irq &= ~IRQ_MAPPER;
+			break;
+
+		/* The unsigned multiplier, the result is read back from these addresses */
+		case 0x5205:
+		case 0x5206:
+			if( address == 0x5205 )
+				mult_a = value;
+			else
+				mult_b = value;
+			product = mult_a * mult_b;
+			CPU->RAM[0x5205] = product & 0xFF;
+			CPU->RAM[0x5206] = product >> 8;
+			break;
+	}
+
+	return 0;
+}
+
+void mmc5_switch_banks() {
+
+	int i;
+	int banks8k;
+
+	/* PRG banks are always expressed in 8kb units */
+	banks8k = mapper->file->romBanks8k;
+	switch( prg_mode ) {
+		case 0:
+			for(i=0;i!=4;i++)
+				SWAP_RAM_8K(0x8000 + i*0x2000, ((prg_regs[3] & 0x7C) + i) % banks8k);
+			break;
+		case 1:
+			for(i=0;i!=2;i++) {
+				SWAP_RAM_8K(0x8000 + i*0x2000, ((prg_regs[1] & 0x7E) + i) % banks8k);
+				SWAP_RAM_8K(0xC000 + i*0x2000, ((prg_regs[3] & 0x7E) + i) % banks8k);
+			}
+			break;
+		case 2:
+			for(i=0;i!=2;i++)
+				SWAP_RAM_8K(0x8000 + i*0x2000, ((prg_regs[1] & 0x7E) + i) % banks8k);
+			SWAP_RAM_8K(0xC000, (prg_regs[2] & 0x7F) % banks8k);
+			SWAP_RAM_8K(0xE000, (prg_regs[3] & 0x7F) % banks8k);
+			break;
+		case 3:
+			for(i=0;i!=4;i++)
+				SWAP_RAM_8K(0x8000 + i*0x2000, (prg_regs[i] & 0x7F) % banks8k);
+			break;
+	}
+
+	if( mapper->file->vromBanks != 0 ) {
+		mmc5_calculate_chr_banks();
+		mmc5_swap_chr();
+	}
+
+	/* The CPU side of the PPU only knows about the standard mirrorings.
+	 * The rest of combinations are only seen by the background rendering */
+	switch( nt_mapping ) {
+		case 0x44:
+			PPU->mirroring = VERTICAL_MIRRORING;
+			break;
+		case 0x50:
+			PPU->mirroring = HORIZONTAL_MIRRORING;
+			break;
+		case 0x00:
+			PPU->mirroring = SINGLE_SCREEN_MIRRORING_A;
+			break;
+		case 0x55:
+			PPU->mirroring = SINGLE_SCREEN_MIRRORING_B;
+			break;
+	}
+
+}
+
+void mmc5_reset() {
+
+	mmc5_switch_banks();
+}
+
+void mmc5_update() {
+	return;
+}
+
+void mmc5_scanline(int line) {
+
+	if( mapper->file->vromBanks != 0 &&
+	    vram_set_b != (last_set_b && !(PPU->CR1 & SPRITE_SIZE_8x16)) )
+		mmc5_swap_chr();
+
+	/* The scanline counter only works while rendering */
+	if( line < 0 || line >= NES_SCREEN_HEIGHT ||
+	    !(PPU->CR2 & (SHOW_BACKGROUND|SHOW_SPRITES)) ) {
+		in_frame = 0;
+		return;
+	}
+
+	if( !in_frame ) {
+		in_frame = 1;
+		irq_line = 0;
+		irq_pending = 0;
+		return;
+	}
+
+	if( ++irq_line == irq_compare ) {
+		irq_pending = 1;
+		if( irq_enabled )
+			CPU->irq |= IRQ_MAPPER;
+	}
+
+}
+
+/* Reads one byte of the given name table, following the 0x5105 mapping */
+static uint8_t mmc5_read_nt(uint16_t address) {
+
+	uint16_t offset;
+
+	offset = address & 0x3FF;
+	switch( (nt_mapping >> (((address >> 10) & 0x03) << 1)) & 0x03 ) {
+		case 0:
+			return PPU->VRAM[0x2000 + offset];
+		case 1:
+			return PPU->VRAM[0x2400 + offset];
+		case 2:
+			return exram_mode <= 1 ? EXRAM[offset] : 0;
+		default:
+			if( offset >= 0x3C0 )
+				return fill_attr * 0x55;
+			return fill_tile;
+	}
+
+}
+
+/* Reads one byte of the CHR ROM given a 4kb bank */
+#define CHR_4K(bank, offset) \
+	(mapper->file->vrom[((bank)*0x1000 + (offset)) % (mapper->file->vromBanks*VROM_BANK_SIZE)])
+
+int mmc5_fetch_bg_tile(int column, int line, uint16_t nt_address, uint8_t fine_y,
+                       uint8_t *byte1, uint8_t *byte2, uint8_t *palette) {
+
+	int y;
+	int split;
+	uint8_t tile;
+	uint8_t attr;
+	uint8_t exbyte;
+	uint16_t offset;
+	uint16_t address;
+
+	if( mapper->file->vromBanks == 0 )
+		return 0;
+
+	/* Vertical split: the tiles at one side of the screen come from
+	 * ExRAM, with their own scroll and CHR bank */
+	if( (split_control & 0x80) && exram_mode <= 1 ) {
+		if( split_control & 0x40 )
+			split = column >= (split_control & 0x1F);
+		else
+			split = column < (split_control & 0x1F);
+
+		if( split ) {
+			y = split_scroll + line;
+			if( y >= 240 )
+				y -= 240;
+			column &= 0x1F;
+			tile = EXRAM[(y >> 3)*32 + column];
+			attr = EXRAM[0x3C0 + (y >> 5)*8 + (column >> 2)];
+			*palette = (attr >> ((((y >> 4) & 0x01) << 2) | (column & 0x02))) & 0x03;
+			*byte1 = CHR_4K(split_bank, (tile << 4) + (y & 0x07));
+			*byte2 = CHR_4K(split_bank, (tile << 4) + (y & 0x07) + 8);
+			return 1;
+		}
+	}
+
+	tile = mmc5_read_nt(nt_address);
+	offset = nt_address & 0x3FF;
+
+	/* Extended attributes: each tile selects its 4kb bank and palette */
+	if( exram_mode == 1 ) {
+		exbyte = EXRAM[offset];
+		*palette = exbyte >> 6;
+		*byte1 = CHR_4K((chr_upper << 6) | (exbyte & 0x3F), (tile << 4) + fine_y);
+		*byte2 = CHR_4K((chr_upper << 6) | (exbyte & 0x3F), (tile << 4) + fine_y + 8);
+		return 1;
+	}
+
+	attr = mmc5_read_nt((nt_address & 0xFC00) + 0x3C0 + ((offset >> 7) << 3) + ((offset & 0x1F) >> 2));
+	*palette = (attr >> ((((offset >> 6) & 0x01) << 2) | (offset & 0x02))) & 0x03;
+
+	address = ((PPU->CR1 & SCR_PATTERN_ADDRESS) << 8) + (tile << 4) + fine_y;
+	if( PPU->CR1 & SPRITE_SIZE_8x16 ) {
+		*byte1 = mapper->file->vrom[chr_b[(address >> 10) & 0x07]*0x400 + (address & 0x3FF)];
+		*byte2 = mapper->file->vrom[chr_b[((address + 8) >> 10) & 0x07]*0x400 + ((address + 8) & 0x3FF)];
+	}
+	else {
+		*byte1 = PPU->VRAM[address];
+		*byte2 = PPU->VRAM[address + 8];
+	}
+
+	return 1;
+}
+
+void mmc5_clock_cpu(int cycles) {
+
+	int i;
+	uint8_t sample;
+	mmc5_pulse *pulse;
+
+	/* Envelopes and length counters are clocked at 240 Hz */
+	frame_timeout -= cycles;
+	if( frame_timeout <= 0 ) {
+		frame_timeout += MMC5_FRAME_CYCLES;
+		for(i=0;i!=2;i++) {
+			pulse = pulses + i;
+			if( pulse->env_start ) {
+				pulse->env_start = 0;
+				pulse->env_counter = 15;
+				pulse->env_divider = pulse->volume;
+			}
+			else if( pulse->env_divider-- == 0 ) {
+				pulse->env_divider = pulse->volume;
+				if( pulse->env_counter )
+					pulse->env_counter--;
+				else if( pulse->halt )
+					pulse->env_counter = 15;
+			}
+			if( !pulse->halt && pulse->length )
+				pulse->length--;
+		}
+	}
+
+	/* Timers are clocked every other CPU cycle, like in the APU */
+	sample = pcm >> 3;
+	for(i=0;i!=2;i++) {
+		pulse = pulses + i;
+		pulse->timeout -= cycles;
+		while( pulse->timeout <= 0 ) {
+			pulse->timeout += (pulse->period + 1) << 1;
+			pulse->step = (pulse->step + 1) & 0x07;
+		}
+		if( pulse->length && mmc5_duty_output[pulse->duty][pulse->step] )
+			sample += pulse->constant ? pulse->volume : pulse->env_counter;
+	}
+
+	if( sample != last_sample ) {
+		playback_add_sample(Expansion, sample);
+		last_sample = sample;
+	}
+
+}
+
+void mmc5_end_mapper() {
+	return;
+}
@@ -32,7 +32,7 @@ void nrom_initialize_mapper() {
 	return;
 }
 
-int nrom_check_address(uint16_t address) {
+int nrom_check_address(uint16_t address, uint8_t value) {
 	return 0;
 }
 
@@ -46,20 +46,20 @@ void nrom_reset()
    /* 1 ROM bank games load twice to ensure vector tables */
    /* Free the file ROM (we don't need it anymore) */
    if( mapper->file->romBanks16k == 1 ) {
-      memcpy( CPU->RAM + 0x8000, mapper->file->rom, ROM_BANK_SIZE);
-      memcpy( CPU->RAM + 0xC000, CPU->RAM + 0x8000, ROM_BANK_SIZE);
+      SWAP_RAM( 0x8000, mapper->file->rom, ROM_BANK_SIZE);
+      SWAP_RAM( 0xC000, mapper->file->rom, ROM_BANK_SIZE);
    }
    /* 2 ROM bank games load one in 0x8000 and other in 0xC000 */
    /* Free the file ROM (we don't need it anymore) */
    else if (mapper->file->romBanks16k == 2 ) {
-      memcpy( CPU->RAM + 0x8000, mapper->file->rom, ROM_BANK_SIZE);
-      memcpy( CPU->RAM + 0xC000, mapper->file->rom + ROM_BANK_SIZE, ROM_BANK_SIZE);
+      SWAP_RAM( 0x8000, mapper->file->rom, ROM_BANK_SIZE);
+      SWAP_RAM( 0xC000, mapper->file->rom + ROM_BANK_SIZE, ROM_BANK_SIZE);
    }
 
 	/* Dump the VROM into the PPU VRAM area */
 	if( mapper->file->vromBanks == 1 ) {
 		INFO( printf(_("Copying VROM to VRAM\n")) );
-		memcpy( PPU->VRAM , mapper->file->vrom, 0x2000);
+		SWAP_VRAM(0, mapper->file->vrom, 0x2000);
 	}
 
 	return;
@@ -0,0 +1,192 @@
+/*  ImaNES: I'm a NES. An intelligent NES emulator
+
+    ntsc.c   -    NTSC composite signal filter
+
+    Copyright (C) 2009   Rodrigo Tobar Carrizo
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <string.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "ntsc.h"
+#include "ppu.h"
+#include "screen.h"
+
+/* The signal is simulated at twice the master clock: a pixel lasts
+ * 8 samples, and a cycle of the color subcarrier 12 */
+#define SAMPLES_PER_PIXEL  (8)
+#define SAMPLES_PER_CYCLE  (12)
+
+/* Delay of the decoder against the generated signal, tunes the hue */
+#define HUE_OFFSET  (3.9)
+
+/* Neighbors contributing to the filtered pixels of a NES pixel */
+#define NTSC_TAPS  (3)
+
+#ifndef M_PI
+#define M_PI  (3.14159265358979323846)
+#endif
+
+/* Contribution of a color, drawn at the given tap from a NES pixel
+ * starting at the given phase, to each of the filtered pixels of the
+ * latter. Channels are stored as B, G, R and 0 */
+static float kernel[NTSC_COLORS][NTSC_PHASES][NTSC_TAPS][NTSC_OUT_PER_PIXEL][4]
+#if defined(__GNUC__)
+	__attribute__((aligned(32)))
+#endif
+	;
+
+/* Composite signal of a color at a subcarrier phase, where black is 0
+ * and white is 1. Levels are the ones measured on an NTSC 2C02 */
+static float ntsc_signal(int color, int phase) {
+
+	static const float low[4]  = { 0.350f, 0.518f, 0.962f, 1.550f };
+	static const float high[4] = { 1.094f, 1.506f, 1.962f, 1.962f };
+	const float black = 0.518f, white = 1.962f;
+	int hue   = color & 0x0F;
+	int level = (color >> 4) & 0x03;
+	float lo, hi, signal;
+
+	if( hue > 13 )
+		level = 1;
+	lo = low[level];
+	hi = high[level];
+	if( hue == 0 )
+		lo = hi;
+	if( hue > 12 )
+		hi = lo;
+
+	signal = ((hue + phase) % SAMPLES_PER_CYCLE < 6) ? hi : lo;
+
+	/* Emphasized colors are attenuated during their part of the cycle */
+	if( ((color & 0x40)  && (0x0C + phase) % SAMPLES_PER_CYCLE < 6) ||
+	    ((color & 0x80)  && (0x04 + phase) % SAMPLES_PER_CYCLE < 6) ||
+	    ((color & 0x100) && (0x08 + phase) % SAMPLES_PER_CYCLE < 6) )
+		signal *= 0.746f;
+
+	return (signal - black) / (white - black);
+}
+
+void initialize_ntsc_filter() {
+
+	int color, phase, tap, out, m, sample;
+	int start, end;
+	double y, i, q, s, angle;
+	float *k;
+
+	for(color=0; color!=NTSC_COLORS; color++) {
+		for(phase=0; phase!=NTSC_PHASES; phase++) {
+			for(tap=0; tap!=NTSC_TAPS; tap++) {
+				for(out=0; out!=NTSC_OUT_PER_PIXEL; out++) {
+
+					/* The TV averages a whole subcarrier cycle
+					 * around the center of the filtered pixel */
+					start = SAMPLES_PER_PIXEL*out/NTSC_OUT_PER_PIXEL
+					      + SAMPLES_PER_PIXEL/NTSC_OUT_PER_PIXEL/2 - SAMPLES_PER_CYCLE/2;
+					end   = start + SAMPLES_PER_CYCLE;
+
+					y = i = q = 0;
+					for(m=start; m!=end; m++) {
+
+						/* Only the samples of the neighbor at this tap */
+						if( m < SAMPLES_PER_PIXEL*(tap-1) || m >= SAMPLES_PER_PIXEL*tap )
+							continue;
+
+						sample = (phase*4 + m + 2*SAMPLES_PER_CYCLE) % SAMPLES_PER_CYCLE;
+						s = ntsc_signal(color, sample);
+						angle = M_PI * (sample + HUE_OFFSET) / 6;
+						y += s;
+						i += s * cos(angle);
+						q += s * sin(angle);
+					}
+					y /= SAMPLES_PER_CYCLE;
+					i /= SAMPLES_PER_CYCLE;
+					q /= SAMPLES_PER_CYCLE;
+
+					k = kernel[color][phase][tap][out];
+					k[0] = (float)(255.0 * (y - 1.108545*i + 1.709007*q));
+					k[1] = (float)(255.0 * (y - 0.274788*i - 0.635691*q));
+					k[2] = (float)(255.0 * (y + 0.946882*i + 0.623557*q));
+					k[3] = 0;
+				}
+			}
+		}
+	}
+}
+
+void ntsc_filter_line(const uint8_t *pixels, uint8_t cr2, int phase, uint32_t *out) {
+
+	int x, tap;
+	int mask = (cr2 & MONOCHROME_MODE) ? 0x30 : 0x3F;
+	int emphasis = (cr2 & EMPHASIS_MASK) << 1;
+	int colors[NTSC_TAPS];
+#if defined(__AVX2__)
+	__m256 sum;
+	__m128i packed;
+#elif defined(__SSE2__)
+	__m128 sum0, sum1;
+	__m128i packed;
+#else
+	int c, v, value;
+	float sum[NTSC_OUT_PER_PIXEL][4];
+#endif
+
+	for(x=0; x!=NES_SCREEN_WIDTH; x++, out += NTSC_OUT_PER_PIXEL) {
+
+		/* The screen borders repeat the first and last pixels */
+		colors[0] = (pixels[x > 0 ? x-1 : x] & mask) | emphasis;
+		colors[1] = (pixels[x] & mask) | emphasis;
+		colors[2] = (pixels[x < NES_SCREEN_WIDTH-1 ? x+1 : x] & mask) | emphasis;
+
+#if defined(__AVX2__)
+		sum = _mm256_load_ps(kernel[colors[0]][phase][0][0]);
+		for(tap=1; tap!=NTSC_TAPS; tap++)
+			sum = _mm256_add_ps(sum, _mm256_load_ps(kernel[colors[tap]][phase][tap][0]));
+		packed = _mm_packs_epi32(_mm256_castsi256_si128(_mm256_cvtps_epi32(sum)),
+		                         _mm256_extracti128_si256(_mm256_cvtps_epi32(sum), 1));
+		_mm_storel_epi64((__m128i *)out, _mm_packus_epi16(packed, packed));
+#elif defined(__SSE2__)
+		sum0 = _mm_load_ps(kernel[colors[0]][phase][0][0]);
+		sum1 = _mm_load_ps(kernel[colors[0]][phase][0][1]);
+		for(tap=1; tap!=NTSC_TAPS; tap++) {
+			sum0 = _mm_add_ps(sum0, _mm_load_ps(kernel[colors[tap]][phase][tap][0]));
+			sum1 = _mm_add_ps(sum1, _mm_load_ps(kernel[colors[tap]][phase][tap][1]));
+		}
+		packed = _mm_packs_epi32(_mm_cvtps_epi32(sum0), _mm_cvtps_epi32(sum1));
+		_mm_storel_epi64((__m128i *)out, _mm_packus_epi16(packed, packed));
+#else
+		memset(sum, 0, sizeof(sum));
+		for(tap=0; tap!=NTSC_TAPS; tap++)
+			for(c=0; c!=NTSC_OUT_PER_PIXEL*4; c++)
+				sum[c/4][c%4] += kernel[colors[tap]][phase][tap][c/4][c%4];
+		for(c=0; c!=NTSC_OUT_PER_PIXEL; c++) {
+			out[c] = 0;
+			for(v=0; v!=3; v++) {
+				value = (int)(sum[c][v] + 0.5f);
+				out[c] |= (uint32_t)(value < 0 ? 0 : value > 255 ? 255 : value) << (8*v);
+			}
+		}
+#endif
+
+		/* The next pixel starts 8 samples later in the cycle */
+		phase = (phase + 2) % NTSC_PHASES;
+	}
+}
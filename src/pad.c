@@ -18,6 +18,9 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdio.h>
+#include <string.h>
+
 #include "cpu.h"
 #include "debug.h"
 #include "i18n.h"
@@ -25,140 +28,256 @@
 #include "screen.h"
 #include "pad.h"
 #include "ppu.h"
+#include "states.h"
 
 nes_pad pads[2];
 
+/* Name of each pad button in imanes.rc, in bit order */
+static const char *button_names[PAD_BUTTONS] = {
+	"a", "b", "select", "start", "up", "down", "left", "right"
+};
+
+/* Names of the non-printable keys that can be bound in imanes.rc.
+ * Letters and digits are bound by themselves (e.g., "pad1.a = k") */
+static const struct {
+	const char *name;
+	SDLKey key;
+} key_names[] = {
+	{ "up",        SDLK_UP        },
+	{ "down",      SDLK_DOWN      },
+	{ "left",      SDLK_LEFT      },
+	{ "right",     SDLK_RIGHT     },
+	{ "return",    SDLK_RETURN    },
+	{ "space",     SDLK_SPACE     },
+	{ "tab",       SDLK_TAB       },
+	{ "backspace", SDLK_BACKSPACE },
+	{ "lshift",    SDLK_LSHIFT    },
+	{ "rshift",    SDLK_RSHIFT    },
+	{ "lctrl",     SDLK_LCTRL     },
+	{ "rctrl",     SDLK_RCTRL     },
+	{ "lalt",      SDLK_LALT      },
+	{ "ralt",      SDLK_RALT      }
+};
+#define KEY_NAMES  (sizeof(key_names)/sizeof(key_names[0]))
+
+/* Keys used by ImaNES itself, which can't be bound to the pads */
+static const SDLKey hotkeys[] = {
+	SDLK_1, SDLK_2, SDLK_3, SDLK_4, SDLK_5, SDLK_6, SDLK_7, SDLK_8, SDLK_9,
+	SDLK_F1, SDLK_F2, SDLK_F3, SDLK_F4, SDLK_F5, SDLK_F6, SDLK_F7, SDLK_F8,
+	SDLK_ESCAPE, SDLK_BACKSPACE
+};
+#define HOTKEYS  (sizeof(hotkeys)/sizeof(hotkeys[0]))
+
+/* Keys bound to each button of each pad, in bit order.
+ * These are the defaults, which can be changed in imanes.rc */
+static SDLKey bound_keys[2][PAD_BUTTONS] = {
+	{ SDLK_k, SDLK_j, SDLK_RCTRL, SDLK_RETURN, SDLK_w, SDLK_s, SDLK_a, SDLK_d },
+	{ SDLK_m, SDLK_n, SDLK_LCTRL, SDLK_LSHIFT, SDLK_UP, SDLK_DOWN, SDLK_LEFT, SDLK_RIGHT }
+};
+
+/* Joystick buttons bound to each button of each pad (-1 if none).
+ * Pad 1 uses the first joystick, and pad 2 the second one */
+static int bound_joy_buttons[2][PAD_BUTTONS] = {
+	{ -1, -1, -1, -1, -1, -1, -1, -1 },
+	{ -1, -1, -1, -1, -1, -1, -1, -1 }
+};
+
+/* Pad buttons of each key, built from the bindings in initialize_pads
+ * so pressing a key is a single table lookup */
+static uint8_t key_buttons[2][SDLK_LAST];
+
+static SDL_Joystick *joysticks[2];
+
+/* Whether the input has already been polled in the current frame */
+static int input_polled;
+
 void initialize_pads() {
 
-	pads[0].plugged = 1;
-	pads[0].pressed_keys = 0;
-	pads[0].reads = 0;
+	int p, b;
+	int use_joysticks = 0;
 
-	pads[1].plugged = 1;
-	pads[1].pressed_keys = 0;
-	pads[1].reads = 0;
+	memset(key_buttons, 0, sizeof(key_buttons));
+	for(p=0; p!=2; p++) {
+
+		pads[p].plugged = 1;
+		pads[p].pressed_keys = 0;
+		pads[p].pressed_joy = 0;
+		pads[p].latched = 0;
+		pads[p].reads = 0;
+
+		for(b=0; b!=PAD_BUTTONS; b++) {
+			if( bound_keys[p][b] != SDLK_UNKNOWN )
+				key_buttons[p][bound_keys[p][b]] |= (1 << b);
+			if( bound_joy_buttons[p][b] != -1 )
+				use_joysticks = 1;
+		}
+	}
+
+	/* Joysticks are only opened if some of their buttons is bound */
+	if( !use_joysticks )
+		return;
+
+	if( SDL_InitSubSystem(SDL_INIT_JOYSTICK) < 0 ) {
+		fprintf(stderr,_("Error when initializing joysticks: %s\n"), SDL_GetError());
+		return;
+	}
+
+	for(p=0; p!=2 && p < SDL_NumJoysticks(); p++) {
+		joysticks[p] = SDL_JoystickOpen(p);
+		if( joysticks[p] == NULL )
+			fprintf(stderr,_("Cannot open joystick %d: %s\n"), p + 1, SDL_GetError());
+		else
+			INFO( printf(_("Using joystick %d for pad %d\n"), p + 1, p + 1) );
+	}
+	SDL_JoystickEventState(SDL_ENABLE);
 
 }
 
-void dump_pad(int p) {
+void end_pads() {
 
-	printf(_("Pad %d. Pressed button: "), p);
+	int p;
 
-	if( pads[p].pressed_keys == 0 )
-		printf("<none>");
-	else {
-		if( pads[p].pressed_keys & NES_A )
-			printf("A ");
-		if( pads[p].pressed_keys & NES_B )
-			printf("B ");
-		if( pads[p].pressed_keys & NES_SELECT )
-			printf("SELECT ");
-		if( pads[p].pressed_keys & NES_START )
-			printf("START ");
-		if( pads[p].pressed_keys & NES_UP )
-			printf("UP ");
-		if( pads[p].pressed_keys & NES_DOWN )
-			printf("DOWN ");
-		if( pads[p].pressed_keys & NES_LEFT )
-			printf("LEFT ");
-		if( pads[p].pressed_keys & NES_RIGHT )
-			printf("RIGHT ");
+	for(p=0; p!=2; p++) {
+		if( joysticks[p] != NULL ) {
+			SDL_JoystickClose(joysticks[p]);
+			joysticks[p] = NULL;
+		}
 	}
-	printf("\n");
 
 }
 
-void nes_keydown(SDL_keysym keysym) {
+/* Translates a key name from imanes.rc into its SDL key */
+static SDLKey key_from_name(const char *name) {
 
-	int i;
+	unsigned int i;
 
-	switch( keysym.sym ) {
+	if( strlen(name) == 1 ) {
+		if( name[0] >= 'a' && name[0] <= 'z' )
+			return SDLK_a + (name[0] - 'a');
+		if( name[0] >= '0' && name[0] <= '9' )
+			return SDLK_0 + (name[0] - '0');
+	}
 
-		/****************/
-		/* First player */
-		/****************/
-		/* Up */
-		case SDLK_w:
-			pads[0].pressed_keys |= NES_UP;
-			break;
+	for(i=0; i!=KEY_NAMES; i++) {
+		if( !strcmp(key_names[i].name, name) )
+			return key_names[i].key;
+	}
 
-		/* Down */
-		case SDLK_s:
-			pads[0].pressed_keys |= NES_DOWN;
-			break;
+	return SDLK_UNKNOWN;
+}
 
-		/* Left */
-		case SDLK_a:
-			pads[0].pressed_keys |= NES_LEFT;
-			break;
+int configure_pad(char *key, char *value) {
 
-		/* Right */
-		case SDLK_d:
-			pads[0].pressed_keys |= NES_RIGHT;
-			break;
+	unsigned int i;
+	int p, b;
+	int joy_button;
+	SDLKey sdl_key;
 
-		/* A button */
-		case SDLK_k:
-			pads[0].pressed_keys |= NES_A;
-			break;
+	if( strncmp(key, "pad", 3) || (key[3] != '1' && key[3] != '2') || key[4] != '.' )
+		return -1;
 
-		/* B button */
-		case SDLK_j:
-			pads[0].pressed_keys |= NES_B;
+	p = key[3] - '1';
+	for(b=0; b!=PAD_BUTTONS; b++) {
+		if( !strcmp(button_names[b], key + 5) )
 			break;
+	}
+	if( b == PAD_BUTTONS )
+		return -1;
 
-		/* Start button */
-		case SDLK_RETURN:
-			pads[0].pressed_keys |= NES_START;
-			break;
+	/* "none" unbinds the button */
+	if( !strcmp(value, "none") ) {
+		bound_keys[p][b] = SDLK_UNKNOWN;
+		bound_joy_buttons[p][b] = -1;
+	}
 
-		/* Select button */
-		case SDLK_RCTRL:
-			pads[0].pressed_keys |= NES_SELECT;
-			break;
+	/* "buttonN" binds a button of the pad's joystick, the key stays bound */
+	else if( sscanf(value, "button%d", &joy_button) == 1 && joy_button >= 0 )
+		bound_joy_buttons[p][b] = joy_button;
 
-		/*****************/
-		/* Second player */
-		/*****************/
-		/* Up */
-		case SDLK_UP:
-			pads[1].pressed_keys |= NES_UP;
-			break;
+	else {
+		sdl_key = key_from_name(value);
+		if( sdl_key == SDLK_UNKNOWN ) {
+			fprintf(stderr,_("Unknown key '%s' for '%s'\n"), value, key);
+			return 0;
+		}
+		for(i=0; i!=HOTKEYS; i++) {
+			if( hotkeys[i] == sdl_key ) {
+				fprintf(stderr,_("Key '%s' for '%s' is already used by ImaNES\n"), value, key);
+				return 0;
+			}
+		}
+		bound_keys[p][b] = sdl_key;
+	}
 
-		/* Down */
-		case SDLK_DOWN:
-			pads[1].pressed_keys |= NES_DOWN;
-			break;
+	INFO( printf("[config] %s bound to %s\n", key, value) );
+	return 0;
+}
 
-		/* Left */
-		case SDLK_LEFT:
-			pads[1].pressed_keys |= NES_LEFT;
-			break;
+void poll_input() {
 
-		/* Right */
-		case SDLK_RIGHT:
-			pads[1].pressed_keys |= NES_RIGHT;
-			break;
+	if( input_polled )
+		return;
 
-		/* A button */
-		case SDLK_m:
-			pads[1].pressed_keys |= NES_A;
-			break;
+	screen_loop();
+	input_polled = 1;
 
-		/* B button */
-		case SDLK_n:
-			pads[1].pressed_keys |= NES_B;
-			break;
+}
 
-		/* Start button */
-		case SDLK_LSHIFT:
-			pads[1].pressed_keys |= NES_START;
-			break;
+void end_input_frame() {
 
-		/* Select button */
-		case SDLK_LCTRL:
-			pads[1].pressed_keys |= NES_SELECT;
-			break;
+	poll_input();
+	input_polled = 0;
+
+}
+
+void latch_pads() {
+
+	/* Sample the input as late as possible, right when the game asks for it */
+	poll_input();
+
+	pads[0].latched = pads[0].pressed_keys | pads[0].pressed_joy;
+	pads[0].reads = 0;
+	pads[1].latched = pads[1].pressed_keys | pads[1].pressed_joy;
+	pads[1].reads = 0;
+
+}
+
+void dump_pad(int p) {
+
+	uint8_t pressed = pads[p].pressed_keys | pads[p].pressed_joy;
+
+	printf(_("Pad %d. Pressed button: "), p);
+
+	if( pressed == 0 )
+		printf("<none>");
+	else {
+		if( pressed & NES_A )
+			printf("A ");
+		if( pressed & NES_B )
+			printf("B ");
+		if( pressed & NES_SELECT )
+			printf("SELECT ");
+		if( pressed & NES_START )
+			printf("START ");
+		if( pressed & NES_UP )
+			printf("UP ");
+		if( pressed & NES_DOWN )
+			printf("DOWN ");
+		if( pressed & NES_LEFT )
+			printf("LEFT ");
+		if( pressed & NES_RIGHT )
+			printf("RIGHT ");
+	}
+	printf("\n");
+
+}
+
+void nes_keydown(SDL_keysym keysym) {
+
+	pads[0].pressed_keys |= key_buttons[0][keysym.sym];
+	pads[1].pressed_keys |= key_buttons[1][keysym.sym];
+
+	switch( keysym.sym ) {
 
 		/*****************/
 		/* ImaNES layers */
@@ -237,7 +356,7 @@ void nes_keydown(SDL_keysym keysym) {
 		/* Choose which state to use */
 		case SDLK_F3:
 			config.current_state++;
-			if( config.current_state == 10 )
+			if( config.current_state == STATE_SLOTS )
 				config.current_state = 0;
 			break;
 
@@ -261,10 +380,6 @@ void nes_keydown(SDL_keysym keysym) {
 		/* This is for debugging */
 		case SDLK_F7:
 			dump_spr_ram();
-			INFO( printf(_("Instructions never executed:\n")) );
-			for(i=0;i!=INSTRUCTIONS_NUMBER;i++)
-				if(instructions[i].size != 0 && !instructions[i].executed )
-					printf("%02x - %s\n", instructions[i].opcode, instructions[i].name);
 			break;
 
 		case SDLK_F8:
@@ -291,102 +406,59 @@ void nes_keydown(SDL_keysym keysym) {
 
 void nes_keyup(SDL_keysym keysym) {
 
-	switch( keysym.sym ) {
-
-		/****************/
-		/* First player */
-		/****************/
-		/* Up */
-		case SDLK_w:
-			pads[0].pressed_keys &= ~NES_UP;
-			break;
-
-		/* Down */
-		case SDLK_s:
-			pads[0].pressed_keys &= ~NES_DOWN;
-			break;
-
-		/* Left */
-		case SDLK_a:
-			pads[0].pressed_keys &= ~NES_LEFT;
-			break;
+	pads[0].pressed_keys &= ~key_buttons[0][keysym.sym];
+	pads[1].pressed_keys &= ~key_buttons[1][keysym.sym];
 
-		/* Right */
-		case SDLK_d:
-			pads[0].pressed_keys &= ~NES_RIGHT;
-			break;
+	switch( keysym.sym ) {
 
-		/* A button */
-		case SDLK_k:
-			pads[0].pressed_keys &= ~NES_A;
+		/* Run at 60 fps */
+		case SDLK_BACKSPACE:
+			config.run_fast = 0;
 			break;
 
-		/* B button */
-		case SDLK_j:
-			pads[0].pressed_keys &= ~NES_B;
+		default:
 			break;
+	}
 
-		/* Start button */
-		case SDLK_RETURN:
-			pads[0].pressed_keys &= ~NES_START;
-			break;
+}
 
-		/* Select button */
-		case SDLK_RCTRL:
-			pads[0].pressed_keys &= ~NES_SELECT;
-			break;
+void nes_joybutton(SDL_JoyButtonEvent *event) {
 
-		/*****************/
-		/* Second player */
-		/*****************/
-		/* Up */
-		case SDLK_UP:
-			pads[1].pressed_keys &= ~NES_UP;
-			break;
+	int b;
+	uint8_t buttons = 0;
 
-		/* Down */
-		case SDLK_DOWN:
-			pads[1].pressed_keys &= ~NES_DOWN;
-			break;
+	if( event->which > 1 )
+		return;
 
-		/* Left */
-		case SDLK_LEFT:
-			pads[1].pressed_keys &= ~NES_LEFT;
-			break;
+	for(b=0; b!=PAD_BUTTONS; b++) {
+		if( bound_joy_buttons[event->which][b] == event->button )
+			buttons |= (1 << b);
+	}
 
-		/* Right */
-		case SDLK_RIGHT:
-			pads[1].pressed_keys &= ~NES_RIGHT;
-			break;
+	if( event->type == SDL_JOYBUTTONDOWN )
+		pads[event->which].pressed_joy |= buttons;
+	else
+		pads[event->which].pressed_joy &= ~buttons;
 
-		/* A button */
-		case SDLK_m:
-			pads[1].pressed_keys &= ~NES_A;
-			break;
+}
 
-		/* B button */
-		case SDLK_n:
-			pads[1].pressed_keys &= ~NES_B;
-			break;
+void nes_joyaxis(SDL_JoyAxisEvent *event) {
 
-		/* Start button */
-		case SDLK_LSHIFT:
-			pads[1].pressed_keys &= ~NES_START;
-			break;
+	uint8_t negative, positive;
+	nes_pad *pad;
 
-		/* Select button */
-		case SDLK_LCTRL:
-			pads[1].pressed_keys &= ~NES_SELECT;
-			break;
+	/* Axis 0 is the horizontal one, and axis 1 the vertical one */
+	if( event->which > 1 || event->axis > 1 )
+		return;
 
-		/* Run at 60 fps */
-		case SDLK_BACKSPACE:
-			config.run_fast = 0;
-			break;
+	pad = &pads[event->which];
+	negative = (event->axis == 0 ? NES_LEFT : NES_UP);
+	positive = (event->axis == 0 ? NES_RIGHT : NES_DOWN);
 
-		default:
-			break;
-	}
+	pad->pressed_joy &= ~(negative | positive);
+	if( event->value <= -JOY_AXIS_THRESHOLD )
+		pad->pressed_joy |= negative;
+	else if( event->value >= JOY_AXIS_THRESHOLD )
+		pad->pressed_joy |= positive;
 
 }
-
@@ -20,9 +20,11 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "common.h"
 #include "i18n.h"
+#include "imaconfig.h"
 #include "palette.h"
 #include "ppu.h"
 
@@ -30,9 +32,72 @@ nes_palette *system_palette;
 
 static nes_palette loopy_palette[NES_PALETTE_COLORS];
 static nes_palette other_palette[NES_PALETTE_COLORS];
+static nes_palette emphasis_palette[NES_EMPHASIS_COLORS];
+
+/* Reads a .pal file, returns the number of colors read or 0 on error */
+static int load_palette_file(const char *file_name) {
+
+	FILE *file;
+	uint8_t rgb[3*NES_EMPHASIS_COLORS];
+	size_t read_bytes;
+	int i;
+
+	file = fopen(file_name, "rb");
+	if( file == NULL ) {
+		fprintf(stderr,_("Error while opening palette file '%s': "), file_name);
+		perror(NULL);
+		return 0;
+	}
+	read_bytes = fread(rgb, 1, sizeof(rgb), file);
+	fclose(file);
+
+	if( read_bytes != 3*NES_PALETTE_COLORS && read_bytes != 3*NES_EMPHASIS_COLORS ) {
+		fprintf(stderr,_("Error: palette file '%s' must have %d or %d colors\n"),
+		        file_name, NES_PALETTE_COLORS, NES_EMPHASIS_COLORS);
+		return 0;
+	}
+
+	for(i=0; i!=(int)read_bytes/3; i++) {
+		FILL_NES_PALETTE(emphasis_palette, i, rgb[3*i], rgb[3*i+1], rgb[3*i+2]);
+	}
+	return (int)read_bytes/3;
+}
+
+/* Calculates the emphasized colors from the first NES_PALETTE_COLORS */
+static void calculate_emphasis() {
+
+	int i, emphasis;
+	double red, green, blue;
+	nes_palette *color;
+
+	for(emphasis=1; emphasis!=8; emphasis++) {
+
+		/* Emphasizing a channel attenuates the other ones */
+		red   = (emphasis & 0x6) ? EMPHASIS_ATTENUATION : 1;
+		green = (emphasis & 0x5) ? EMPHASIS_ATTENUATION : 1;
+		blue  = (emphasis & 0x3) ? EMPHASIS_ATTENUATION : 1;
+
+		for(i=0; i!=NES_PALETTE_COLORS; i++) {
+			color = emphasis_palette + i;
+
+			/* Blacks of the $xE and $xF columns are not affected */
+			if( (i & 0x0E) == 0x0E ) {
+				emphasis_palette[emphasis*NES_PALETTE_COLORS + i] = *color;
+				continue;
+			}
+
+			FILL_NES_PALETTE(emphasis_palette, emphasis*NES_PALETTE_COLORS + i,
+			                 (uint8_t)(color->red * red + 0.5),
+			                 (uint8_t)(color->green * green + 0.5),
+			                 (uint8_t)(color->blue * blue + 0.5));
+		}
+	}
+}
 
 void initialize_palette() {
 
+	int colors = 0;
+
 	/* Loopy palette */
 	FILL_NES_PALETTE(loopy_palette, 0x00, 0x75, 0x75, 0x75);
 	FILL_NES_PALETTE(loopy_palette, 0x01, 0x27, 0x1B, 0x8F);
@@ -165,7 +230,15 @@ void initialize_palette() {
 	FILL_NES_PALETTE(other_palette, 0x3E, 0x11, 0x11, 0x11);
 	FILL_NES_PALETTE(other_palette, 0x3F, 0x11, 0x11, 0x11);
 
-	system_palette = loopy_palette;
+	/* The loaded or built-in colors go at the start of the full palette */
+	if( config.palette_file != NULL )
+		colors = load_palette_file(config.palette_file);
+	if( colors == 0 )
+		memcpy(emphasis_palette, loopy_palette, sizeof(loopy_palette));
+	if( colors != NES_EMPHASIS_COLORS )
+		calculate_emphasis();
+
+	system_palette = emphasis_palette;
 }
 
 void dump_palette() {
@@ -106,7 +106,7 @@ ines_file *check_ines_file(const char *file_path) {
 	INFO( printf(_("SRAM is %s\n"), (CPU->sram_enabled ? _("enabled") : _("disabled")) ) );
 	rom_file->has_trainer  = buff[0] & 0x04;
 
-	rom_file->mapper_id = (buff[1] & 0xF0) | (buff[0] >> 4);
+	rom_file->mapper_id = ((uint8_t)buff[1] & 0xF0) | ((uint8_t)buff[0] >> 4);
 
 	/* Check which mappers we do support */
 	mapper = NULL;
@@ -134,6 +134,9 @@ ines_file *check_ines_file(const char *file_path) {
 		exit(EXIT_FAILURE);
 	}
 
+	rom_file->pal = buff[1] & 0x01;
+	INFO( printf(_("TV system is %s\n"), (rom_file->pal ? "PAL" : "NTSC")) );
+
 	if( rom_file->has_trainer ) {
 
 		INFO( printf(_("Trainer present in ROM file\n")) );
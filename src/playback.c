@@ -25,15 +25,24 @@
 #include "clock.h"
 #include "cpu.h"
 #include "debug.h"
+#include "frame_control.h"
 #include "i18n.h"
 #include "imaconfig.h"
 #include "playback.h"
 #include "queue.h"
+#include "recorder.h"
+#include "telemetry.h"
 
-static dac_queue *dac[5];
+static dac_queue *dac[APU_CHANNELS];
 static SDL_AudioSpec audio_spec;
 static uint8_t *normal_ppu_cycle_samples;
 
+/* Audio device clock: samples handed to the device before and after the
+ * last callback, and the frame_clock() instant of that callback */
+static uint64_t played_before;
+static uint64_t played_after;
+static uint64_t played_stamp;
+
 void initialize_playback() {
 
 	int i;
@@ -93,6 +102,7 @@ void initialize_playback() {
 	dac[2] = NULL;
 	dac[3] = NULL;
 	dac[4] = NULL;
+	dac[5] = NULL;
 
 	/* The array where we'll store the information about which samples
 	 * should take extra PPU cycles on each callback iteration */
@@ -112,8 +122,9 @@ void playback_fill_sound_card(void *userdata, Uint8 *stream, int len) {
 	static Uint8 last_triangle_sample = 0;
 	static Uint8 last_noise_sample = 0;
 	static Uint8 last_dmc_sample = 0;
+	static Uint8 last_expansion_sample = 0;
 
-	Uint8 sample;
+	int sample;
 	int pos;
 	unsigned int channel;
 	unsigned int removed;
@@ -136,12 +147,18 @@ void playback_fill_sound_card(void *userdata, Uint8 *stream, int len) {
 	uint8_t triangle_sample;
 	uint8_t noise_sample;
 	uint8_t dmc_sample;
+	uint8_t expansion_sample;
 
 	/* First of all, get the current PPU cycles. They will
 	 * serve as an indication of the samples that we must
 	 * process during this callback. */
 	ppu_cycles = CLK->ppu_cycles;
 
+	/* The device has consumed everything we gave it until now */
+	played_stamp = frame_clock();
+	played_before = played_after;
+	played_after += len / audio_spec.channels;
+
 	/* Some debugging information, proves useful from time to time */
 	DEBUG(
 
@@ -186,6 +203,11 @@ void playback_fill_sound_card(void *userdata, Uint8 *stream, int len) {
 	 * how many cycles must be taken into account when constructing each
 	 * sample */
 	elapsed_ppu_cycles = (ppu_cycles - previous_ppu_cycles);
+
+	/* The emulation didn't produce even half of the requested audio */
+	if( (uint64_t)elapsed_ppu_cycles < (uint64_t)len*(3*CPU_CLOCK_HERTZ/2)/audio_spec.freq )
+		COUNT(audio_underruns, 1);
+
 	ppu_steps_per_sample = elapsed_ppu_cycles/len;
 	remained_ppu_cycles  = elapsed_ppu_cycles%len;
 
@@ -276,7 +298,7 @@ void playback_fill_sound_card(void *userdata, Uint8 *stream, int len) {
 			step_ppu_cycles++;
 
 		/* Remove old samples from the queues */
-		for(channel = 0; channel != 5; channel++) {
+		for(channel = 0; channel != APU_CHANNELS; channel++) {
 			removed = 0;
 			while( dac[channel] != NULL && dac[channel]->ppu_cycles <= previous_step_ppu_cycles ) {
 				dac[channel] = pop(dac[channel]);
@@ -294,6 +316,7 @@ void playback_fill_sound_card(void *userdata, Uint8 *stream, int len) {
 		noise_sample    = last_noise_sample;
 		dmc_sample      = last_dmc_sample;
 		triangle_sample = last_triangle_sample;
+		expansion_sample = last_expansion_sample;
 
 		if( dac[Square1] != NULL && config.apu_square1 )
 			square1_sample = dac[Square1]->sample;
@@ -305,13 +328,16 @@ void playback_fill_sound_card(void *userdata, Uint8 *stream, int len) {
 			noise_sample = dac[Noise]->sample;
 		if( dac[DMC] != NULL && config.apu_dmc )
 			dmc_sample = dac[DMC]->sample;
+		if( dac[Expansion] != NULL )
+			expansion_sample = dac[Expansion]->sample;
 
 		sample  = 0;
 		sample += square_dac_outputs[square1_sample + square2_sample];
 		sample += tnd_dac_outputs[3*triangle_sample + 2*noise_sample + dmc_sample];
+		sample += expansion_sample;
 
 		/* Finally! This is our little sample */
-		stream[pos] = sample;
+		stream[pos] = (sample > 0xFF ? 0xFF : sample);
 
 		/* Reset for later use */
 		last_square1_sample  = square1_sample;
@@ -319,10 +345,13 @@ void playback_fill_sound_card(void *userdata, Uint8 *stream, int len) {
 		last_triangle_sample = triangle_sample;
 		last_noise_sample    = noise_sample;
 		last_dmc_sample      = dmc_sample;
+		last_expansion_sample = expansion_sample;
 
 		previous_step_ppu_cycles = step_ppu_cycles;
 	}
 
+	record_audio(stream, len);
+
 	/* Finally, set the 'previous' variables */
 	INFO(
 		previousTime.tv_sec = currentTime.tv_sec;
@@ -338,6 +367,32 @@ void playback_fill_sound_card(void *userdata, Uint8 *stream, int len) {
 	previous_ppu_cycles = ppu_cycles;
 }
 
+int playback_rate() {
+	return config.sound_mute ? 0 : audio_spec.freq;
+}
+
+uint64_t playback_clock(uint64_t now) {
+
+	uint64_t clock;
+
+	if( config.sound_mute )
+		return 0;
+
+	/* The device keeps playing after the last callback, but it can't
+	 * go beyond the samples we have given to it */
+	SDL_LockAudio();
+	if( played_stamp == 0 || now < played_stamp )
+		clock = 0;
+	else {
+		clock = played_before * 1000000000 / audio_spec.freq + (now - played_stamp);
+		if( clock > played_after * 1000000000 / audio_spec.freq )
+			clock = played_after * 1000000000 / audio_spec.freq;
+	}
+	SDL_UnlockAudio();
+
+	return clock;
+}
+
 void playback_pause(int pause_on) {
 	if( config.sound_mute )
 		return;
@@ -368,7 +423,7 @@ void end_playback() {
 		return;
 
 	playback_pause(1);
-	for(i=0; i!=5; i++)
+	for(i=0; i!=APU_CHANNELS; i++)
 		while(dac[i]!=NULL)
 			dac[i] = pop(dac[i]);
 }
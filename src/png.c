@@ -0,0 +1,238 @@
+/*  ImaNES: I'm a NES. An intelligent NES emulator
+
+    png.c   -    PNG encoding of indexed images
+
+    Copyright (C) 2009   Rodrigo Tobar Carrizo
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "png.h"
+
+/* Longest match, and the minimum worth encoding */
+#define MAX_MATCH  (258)
+#define MIN_MATCH  (3)
+
+typedef struct _bit_writer {
+	uint8_t *out;
+	size_t pos;
+	uint32_t bits;
+	int nbits;
+} bit_writer;
+
+static const uint16_t length_base[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t length_extra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t distance_base[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t distance_extra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+static uint32_t crc_table[256];
+
+/* Deflate streams are written starting from the least significant bit */
+static void put_bits(bit_writer *w, uint32_t value, int n) {
+
+	w->bits |= value << w->nbits;
+	w->nbits += n;
+	while( w->nbits >= 8 ) {
+		w->out[w->pos++] = (uint8_t)w->bits;
+		w->bits >>= 8;
+		w->nbits -= 8;
+	}
+}
+
+/* ...but Huffman codes start from their most significant bit */
+static void put_code(bit_writer *w, uint32_t code, int n) {
+
+	uint32_t reversed = 0;
+	int i;
+
+	for(i=0; i!=n; i++)
+		reversed |= ((code >> i) & 1) << (n - 1 - i);
+	put_bits(w, reversed, n);
+}
+
+/* Literal/length symbol with the fixed Huffman codes */
+static void put_symbol(bit_writer *w, int symbol) {
+
+	if( symbol < 144 )
+		put_code(w, 0x30 + symbol, 8);
+	else if( symbol < 256 )
+		put_code(w, 0x190 + symbol - 144, 9);
+	else if( symbol < 280 )
+		put_code(w, symbol - 256, 7);
+	else
+		put_code(w, 0xC0 + symbol - 280, 8);
+}
+
+static void put_match(bit_writer *w, int length, int distance) {
+
+	int i;
+
+	for(i=28; length_base[i] > length; i--);
+	put_symbol(w, 257 + i);
+	put_bits(w, length - length_base[i], length_extra[i]);
+
+	for(i=29; distance_base[i] > distance; i--);
+	put_code(w, i, 5);
+	put_bits(w, distance - distance_base[i], distance_extra[i]);
+}
+
+static int match_length(const uint8_t *data, size_t pos, size_t size, size_t distance) {
+
+	size_t len = 0;
+	size_t max = size - pos;
+
+	if( distance > pos )
+		return 0;
+	if( max > MAX_MATCH )
+		max = MAX_MATCH;
+	while( len < max && data[pos + len] == data[pos + len - distance] )
+		len++;
+	return (int)len;
+}
+
+/* A single fixed Huffman block. Screens are mostly runs of the same color
+ * and repeated lines, so we only look for matches at one pixel and at
+ * one line of distance */
+static size_t deflate(uint8_t *out, const uint8_t *data, size_t size, size_t stride) {
+
+	bit_writer w = { out, 0, 0, 0 };
+	size_t pos = 0;
+	int run, up;
+
+	put_bits(&w, 1, 1);  /* Last block */
+	put_bits(&w, 1, 2);  /* Fixed codes */
+
+	while( pos < size ) {
+		run = match_length(data, pos, size, 1);
+		up  = match_length(data, pos, size, stride);
+
+		if( up >= MIN_MATCH && up >= run ) {
+			put_match(&w, up, (int)stride);
+			pos += up;
+		}
+		else if( run >= MIN_MATCH ) {
+			put_match(&w, run, 1);
+			pos += run;
+		}
+		else
+			put_symbol(&w, data[pos++]);
+	}
+
+	put_symbol(&w, 256);
+	put_bits(&w, 0, 7);  /* Flush the last byte */
+
+	return w.pos;
+}
+
+static uint32_t crc32(const uint8_t *data, size_t size, uint32_t crc) {
+
+	size_t i;
+	int j;
+	uint32_t c;
+
+	if( crc_table[1] == 0 ) {
+		for(i=0; i!=256; i++) {
+			c = (uint32_t)i;
+			for(j=0; j!=8; j++)
+				c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+			crc_table[i] = c;
+		}
+	}
+
+	crc = ~crc;
+	for(i=0; i!=size; i++)
+		crc = crc_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+static uint32_t adler32(const uint8_t *data, size_t size) {
+
+	uint32_t a = 1, b = 0;
+	size_t i;
+
+	for(i=0; i!=size; i++) {
+		a = (a + data[i]) % 65521;
+		b = (b + a) % 65521;
+	}
+	return (b << 16) | a;
+}
+
+static void put_be32(uint8_t *out, uint32_t value) {
+	out[0] = (uint8_t)(value >> 24);
+	out[1] = (uint8_t)(value >> 16);
+	out[2] = (uint8_t)(value >> 8);
+	out[3] = (uint8_t)value;
+}
+
+/* Closes a chunk whose data was already written after its 8 bytes header */
+static size_t end_chunk(uint8_t *chunk, const char *type, size_t size) {
+
+	put_be32(chunk, (uint32_t)size);
+	memcpy(chunk + 4, type, 4);
+	put_be32(chunk + 8 + size, crc32(chunk + 4, size + 4, 0));
+	return size + 12;
+}
+
+size_t encode_png(uint8_t *out, const uint8_t *pixels, int width, int height,
+                  const uint8_t *palette, int colors) {
+
+	static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	size_t pos, size, stride = (size_t)width + 1;
+	uint8_t *raw, *data;
+	int y;
+
+	memcpy(out, signature, 8);
+	pos = 8;
+
+	/* 8 bits per pixel, indexed colors, no interlacing */
+	data = out + pos + 8;
+	put_be32(data, width);
+	put_be32(data + 4, height);
+	data[8]  = 8;
+	data[9]  = 3;
+	data[10] = data[11] = data[12] = 0;
+	pos += end_chunk(out + pos, "IHDR", 13);
+
+	memcpy(out + pos + 8, palette, 3*colors);
+	pos += end_chunk(out + pos, "PLTE", 3*colors);
+
+	/* Each line starts with its filter type (none). The filtered lines
+	 * are built after the space reserved for the image */
+	raw = out + PNG_MAX_SIZE(width, height, colors);
+	for(y=0; y!=height; y++) {
+		raw[y*stride] = 0;
+		memcpy(raw + y*stride + 1, pixels + (size_t)y*width, width);
+	}
+
+	data = out + pos + 8;
+	data[0] = 0x78;  /* Deflate, 32K window */
+	data[1] = 0x01;
+	size = 2 + deflate(data + 2, raw, stride * height, stride);
+	put_be32(data + size, adler32(raw, stride * height));
+	pos += end_chunk(out + pos, "IDAT", size + 4);
+
+	pos += end_chunk(out + pos, "IEND", 0);
+
+	return pos;
+}
@@ -22,17 +22,34 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
+#include "clock.h"
 #include "common.h"
 #include "debug.h"
 #include "i18n.h"
 #include "imaconfig.h"
+#include "mapper.h"
 #include "palette.h"
 #include "ppu.h"
+#include "present.h"
 #include "screen.h"
 
 nes_ppu *PPU;
 
+/* A12 state as seen by the CPU accesses through 0x2006/0x2007 */
+static int a12_cpu_level;
+static unsigned long int a12_cpu_low_since;
+
+/* Decoded pattern tables. Each tile is stored as 8 rows of 8 color
+ * indexes, both as is and horizontally flipped */
+static uint8_t chr_tiles[CHR_TILES][2][8][8];
+static uint8_t chr_tile_dirty[CHR_TILES];
+
 void initialize_ppu() {
 
 	PPU = (nes_ppu *)malloc(sizeof(nes_ppu));
@@ -52,6 +69,151 @@ void initialize_ppu() {
 	PPU->CR2 = 0;
 	PPU->frames = 0;
 	PPU->lines = 0;
+	PPU->a12_edge_count = 0;
+	PPU->a12_next_edge = 0;
+
+	a12_cpu_level = 0;
+	a12_cpu_low_since = 0;
+
+	invalidate_chr_cache(0x0000, 0x2000);
+}
+
+void invalidate_chr_cache(uint16_t address, unsigned int size) {
+
+	unsigned int tile;
+	unsigned int last;
+
+	if( size == 0 || address >= 0x2000 )
+		return;
+	if( address + size > 0x2000 )
+		size = 0x2000 - address;
+
+	last = (address + size - 1) / CHR_TILE_SIZE;
+	for(tile = address / CHR_TILE_SIZE; tile <= last; tile++)
+		chr_tile_dirty[tile] = 1;
+
+}
+
+/* Returns the decoded row of the tile with the given pattern address,
+ * decoding the whole tile first if its CHR data changed */
+static const uint8_t *chr_tile_row(uint16_t address, int flip) {
+
+	int row;
+	int tx;
+	uint8_t byte1;
+	uint8_t byte2;
+	unsigned int tile = (address & 0x1FFF) / CHR_TILE_SIZE;
+
+	if( chr_tile_dirty[tile] ) {
+		for(row=0;row!=8;row++) {
+			byte1 = PPU->VRAM[tile*CHR_TILE_SIZE + row];
+			byte2 = PPU->VRAM[tile*CHR_TILE_SIZE + row + 0x08];
+			for(tx=0;tx!=8;tx++) {
+				chr_tiles[tile][0][row][tx] = ((byte1 >> (7-tx)) & 0x1) | (((byte2 >> (7-tx)) & 0x1) << 1);
+				chr_tiles[tile][1][row][7-tx] = chr_tiles[tile][0][row][tx];
+			}
+		}
+		chr_tile_dirty[tile] = 0;
+	}
+
+	return chr_tiles[tile][flip][address & 0x07];
+}
+
+/* Adds a fetch to the A12 timeline of the current scanline */
+#define A12_FETCH(cycle, address) \
+	do { \
+		if( (address) & PPU_A12 ) { \
+			if( !level && (cycle) - low_since > A12_FILTER_CYCLES && \
+			    PPU->a12_edge_count < A12_MAX_EDGES ) \
+				PPU->a12_edges[PPU->a12_edge_count++] = (cycle); \
+			level = 1; \
+		} \
+		else if( level ) { \
+			low_since = (cycle); \
+			level = 0; \
+		} \
+	} while(0)
+
+void schedule_a12_edges(int line) {
+
+	int i;
+	int level;
+	int low_since;
+	int sprites;
+	int height;
+	uint8_t y;
+	uint8_t tiles[8];
+	uint16_t spr_patt_table;
+	uint16_t scr_patt_table;
+	uint16_t address;
+
+	PPU->a12_edge_count = 0;
+	PPU->a12_next_edge = 0;
+
+	/* No fetches at all if we're not rendering */
+	if( !(PPU->CR2 & (SHOW_BACKGROUND|SHOW_SPRITES)) ||
+	    line < -1 || line >= NES_SCREEN_HEIGHT )
+		return;
+
+	spr_patt_table = ((PPU->CR1&SPR_PATTERN_ADDRESS)>>3)*0x1000;
+	scr_patt_table = ((PPU->CR1&SCR_PATTERN_ADDRESS)>>4)*0x1000;
+	height = (PPU->CR1 & SPRITE_SIZE_8x16) ? 16 : 8;
+
+	/* Sprites fetched in this line are the ones shown in the next one.
+	 * Empty slots are filled with tile $FF. The pre-render line
+	 * has no sprites evaluated */
+	memset(tiles, 0xFF, 8);
+	sprites = 0;
+	if( line >= 0 ) {
+		for(i=0;i!=64 && sprites!=8;i++) {
+			y = PPU->SPR_RAM[i<<2];
+			if( y <= line && line < y + height )
+				tiles[sprites++] = PPU->SPR_RAM[(i<<2) + 1];
+		}
+	}
+
+	/* The last fetches of the previous line are name table ones */
+	level = 0;
+	low_since = -4;
+
+	/* Background tiles: NT, AT, and two pattern table fetches each */
+	for(i=0;i!=32;i++) {
+		A12_FETCH(8*i + 1, 0);
+		A12_FETCH(8*i + 5, scr_patt_table);
+	}
+
+	/* Sprites: two garbage NT fetches, and two pattern table fetches */
+	for(i=0;i!=8;i++) {
+		if( height == 16 )
+			address = (tiles[i]&0x1)<<12;
+		else
+			address = spr_patt_table;
+		A12_FETCH(257 + 8*i, 0);
+		A12_FETCH(257 + 8*i + 4, address);
+	}
+
+	/* First two tiles of the next line, and the dummy NT fetches */
+	for(i=0;i!=2;i++) {
+		A12_FETCH(321 + 8*i, 0);
+		A12_FETCH(321 + 8*i + 4, scr_patt_table);
+	}
+	A12_FETCH(337, 0);
+
+}
+
+void a12_bus_access(uint16_t address) {
+
+	if( address & PPU_A12 ) {
+		if( !a12_cpu_level &&
+		    CLK->ppu_cycles - a12_cpu_low_since > A12_FILTER_CYCLES )
+			mapper->update();
+		a12_cpu_level = 1;
+	}
+	else if( a12_cpu_level ) {
+		a12_cpu_low_since = CLK->ppu_cycles;
+		a12_cpu_level = 0;
+	}
+
 }
 
 void dump_ppu() {
@@ -93,20 +255,128 @@ void dump_spr_ram() {
 
 #define COLOR_IDX_FROM_PATTERN_BYTES(byte1, byte2, x) (  ((byte1 >> (7-x)) & 0x1) | (((byte2 >> (7-x)) & 0x1) << 1)  );
 
-void draw_line(int line, int frame) {
+/* Renders the row of the given sprite that falls in the line into the
+ * sprite line buffers. Sprite #0 pixels are always marked for the hit
+ * flag, even if the sprite layer is hidden */
+static void sprite_to_line(int line, uint8_t sprite, int big_sprite, uint8_t front, int show,
+                           uint8_t *spr_line, uint8_t *spr_front, uint8_t *spr0_line) {
+
+	int x;
+	int second_sprite; /* For 8x16 sprites */
+	uint8_t tx;
+	uint8_t col_index;
+	uint8_t attrs;
+	uint8_t tileIdx;
+	uint8_t spriteX;
+	uint8_t spriteY;
+	uint16_t spr_patt_table;
+	uint16_t pattern_byte;
+	const uint8_t *row;
+
+	spr_patt_table = ((PPU->CR1&SPR_PATTERN_ADDRESS)>>3)*0x1000;
+
+	/* 0: Y coord (-1). 1: Tile idx. 2: attrs. 3: X coord */
+	spriteY = line - (PPU->SPR_RAM[sprite<<2] + 1);
+	tileIdx = PPU->SPR_RAM[(sprite<<2) + 1];
+	attrs   = PPU->SPR_RAM[(sprite<<2) + 2];
+	spriteX = PPU->SPR_RAM[(sprite<<2) + 3];
+
+	/* If V Flip... */
+	if( attrs & SPRITE_FLIP_VERT )
+		spriteY = (big_sprite ? 15 : 7) - spriteY;
+
+	/* 8x16 sprites pattern table depends on tileIdx being even or not */
+	second_sprite = 0;
+	if( big_sprite ) {
+		spr_patt_table = (tileIdx&0x1)<<12 /*(i*0x1000)*/;
+		tileIdx &= 0xFE;
+		if( spriteY >= 8 ) {
+			spriteY -= 8;
+			second_sprite = 1;
+		}
+	}
+
+	/* Each tile uses 16 bytes in the pattern table */
+	pattern_byte = ((tileIdx+second_sprite)<<4) /*(i*0x10)*/ + spriteY;
+	row = chr_tile_row(spr_patt_table + pattern_byte, attrs & SPRITE_FLIP_HORIZ ? 1 : 0);
+	if( mapper->latch_chr )
+		mapper->latch_chr(spr_patt_table + pattern_byte + 0x08);
+
+	for(tx=0;tx!=8;tx++) {
+
+		/* Don't draw background colors! */
+		col_index = row[tx];
+		x = spriteX + tx;
+		if( !col_index || x >= NES_SCREEN_WIDTH )
+			continue;
+
+		if( show ) {
+			spr_line[x] = 0x10 | ((attrs&0x03) << 2) | col_index;
+			spr_front[x] = front;
+		}
+		if( sprite == 0 )
+			spr0_line[x] = 1;
+	}
+
+}
+
+/* Merges the background and sprite line buffers into palette offsets.
+ * A sprite pixel wins if it's opaque and either it is in front of the
+ * background or the background pixel is transparent. 0 is the
+ * background color */
+static void compose_line(const uint8_t *bg_line, const uint8_t *spr_line,
+                         const uint8_t *spr_front, uint8_t *out_line) {
+
+	int x;
+
+#if defined(__SSE2__)
+	__m128i zero = _mm_setzero_si128();
+	__m128i bg;
+	__m128i spr;
+	__m128i use_spr;
+
+	for(x=0;x!=NES_SCREEN_WIDTH;x+=16) {
+		bg  = _mm_loadu_si128((const __m128i *)(bg_line + x));
+		spr = _mm_loadu_si128((const __m128i *)(spr_line + x));
+		use_spr = _mm_andnot_si128(_mm_cmpeq_epi8(spr, zero),
+		            _mm_or_si128(_mm_loadu_si128((const __m128i *)(spr_front + x)),
+		                         _mm_cmpeq_epi8(bg, zero)));
+		_mm_storeu_si128((__m128i *)(out_line + x),
+		                 _mm_or_si128(_mm_and_si128(use_spr, spr), _mm_andnot_si128(use_spr, bg)));
+	}
+#elif defined(__ARM_NEON)
+	uint8x16_t bg;
+	uint8x16_t spr;
+	uint8x16_t use_spr;
+
+	for(x=0;x!=NES_SCREEN_WIDTH;x+=16) {
+		bg  = vld1q_u8(bg_line + x);
+		spr = vld1q_u8(spr_line + x);
+		use_spr = vandq_u8(vtstq_u8(spr, spr),
+		                   vorrq_u8(vld1q_u8(spr_front + x), vceqq_u8(bg, vdupq_n_u8(0))));
+		vst1q_u8(out_line + x, vbslq_u8(use_spr, spr, bg));
+	}
+#else
+	for(x=0;x!=NES_SCREEN_WIDTH;x++) {
+		if( spr_line[x] && (spr_front[x] || !bg_line[x]) )
+			out_line[x] = spr_line[x];
+		else
+			out_line[x] = bg_line[x];
+	}
+#endif
+
+}
+
+void draw_line(int line, int render) {
 
 	int x;  /* Final x pixel coordinate */
 	int y;  /* Final y pixel coordinate */
 	int i;
-	int j;
 	int big_sprite;
 	int bck_sprites; /* Counters for arrays bellow */
 	int frt_sprites;
-	int second_sprite; /* For 8x16 sprites */
-	int drawn_back_sprites_idx;    /* For Sprite #0 hit flag */
-	int drawn_background_idx;      /* For Sprite #0 hit flag */
-	uint8_t drawn_back_sprites[8]; /* For Sprite #0 hit flag */
-	uint8_t drawn_background[256]; /* For Sprite #0 hit flag */
+	int sprite0_hit;  /* Sprite #0 hit still needs to be checked */
+	int walk_bg;      /* Background tiles need to be fetched */
 	uint8_t front_sprites[9];
 	uint8_t back_sprites[9];
 	uint8_t tx; /* X coord inside a tile */
@@ -116,22 +386,29 @@ void draw_line(int line, int frame) {
 	uint8_t byte2;
 	uint8_t byte3;
 	uint8_t tileIdx;
-	uint8_t tileNum;
 	uint8_t tmp;
+	uint8_t palette;
+	int column;
 	uint16_t attr_table;
 	uint16_t name_table;
 	uint16_t orig_name_table;
-	uint16_t spr_patt_table;
 	uint16_t scr_patt_table;
 	uint8_t prev_hit;
-	uint8_t spriteX;
-	uint8_t spriteY;
-	uint16_t pattern_byte;
+	const uint8_t *row;  /* Decoded tile row */
+	uint8_t bg_row[8];
+
+	/* Line buffers. Transparent pixels are 0 */
+	uint8_t bg_line[NES_SCREEN_WIDTH];   /* Background palette offsets */
+	uint8_t spr_line[NES_SCREEN_WIDTH];  /* Sprite palette offsets */
+	uint8_t spr_front[NES_SCREEN_WIDTH]; /* 0xFF if the sprite is in front of the background */
+	uint8_t spr0_line[NES_SCREEN_WIDTH]; /* Opaque pixels of sprite #0 */
+	uint8_t out_line[NES_SCREEN_WIDTH];
+	uint8_t line_colors[0x20];
 
 	/* Name table depends on the 1st and 2nd bit of PPU CR1 */
-	spr_patt_table  = ((PPU->CR1&SPR_PATTERN_ADDRESS)>>3)*0x1000;
 	scr_patt_table  = ((PPU->CR1&SCR_PATTERN_ADDRESS)>>4)*0x1000;
 	big_sprite      = (PPU->CR1 & SPRITE_SIZE_8x16)>>5;
+	sprite0_hit     = 0;
 
 	prev_hit = PPU->SR & HIT_FLAG;
 	/* Update PPU registers */
@@ -148,6 +425,8 @@ void draw_line(int line, int frame) {
 		for(i=0;i!=64;i++) {
 			tmp = *(PPU->SPR_RAM + (i<<2) /*(i*4)*/) + 1;
 			if( tmp <= line && line < tmp+8*(big_sprite+1) ) {
+				if( i == 0 && !(PPU->SR&HIT_FLAG) )
+					sprite0_hit = 1;
 				if( *(PPU->SPR_RAM + (i<<2) /*(i*4)*/ + 2) & SPRITE_BACK_PRIOR ) {
 					back_sprites[bck_sprites++] = i;
 				}
@@ -164,90 +443,50 @@ void draw_line(int line, int frame) {
 		bck_sprites--;
 	}
 
-	/* Fill all pixels with the background color */
-	if( config.show_screen_bg && ( !config.run_fast || !(frame%2) ) ) {
-		for(i=0;i!=NES_SCREEN_WIDTH;i++)
-				draw_pixel(i, line, system_palette[PPU->VRAM[0x3F00]]);
-	}
-	else {
-		for(i=0;i!=NES_SCREEN_WIDTH;i++)
-				draw_pixel(i, line, system_palette[0]);
-	}
-
+	memset(bg_line, 0, NES_SCREEN_WIDTH);
+	memset(spr_line, 0, NES_SCREEN_WIDTH);
+	memset(spr_front, 0, NES_SCREEN_WIDTH);
+	memset(spr0_line, 0, NES_SCREEN_WIDTH);
 
-	/* Draw the back sprites */
-	drawn_back_sprites_idx = 0;
+	/* Sprites are rendered from the last to the first one, so the first
+	 * ones overwrite the others. Front sprites always overwrite back ones.
+	 * On skipped frames only sprite #0 is needed, unless the mapper
+	 * watches the pattern fetches */
 	if( PPU->CR2&SHOW_SPRITES ) {
-		for(i=bck_sprites;i>=0;i--) {
-
-			/* Each tile information uses 4 bytes */
-			tileNum = back_sprites[i]<<2 /*(i*4)*/;
-
-			/* 0: Y coord (-1). 1: Tile idx. 2: attrs. 3: X coord */
-			spriteY = line - (PPU->SPR_RAM[tileNum] + 1);
-			tileIdx = PPU->SPR_RAM[tileNum + 1];
-			byte3   = PPU->SPR_RAM[tileNum + 2];
-			spriteX = PPU->SPR_RAM[tileNum + 3];
-
-			/* If V Flip... */
-			if( byte3 & SPRITE_FLIP_VERT )
-				spriteY = (big_sprite ? 15 : 7) - spriteY;
-
-			/* 8x16 sprites pattern table depends on tileIdx being even or not */
-			second_sprite = 0;
-			if( big_sprite ) {
-				spr_patt_table = (tileIdx&0x1)<<12 /*(i*0x1000)*/;
-				tileIdx &= 0xFE;
-				if( spriteY >= 8 ) {
-					spriteY -= 8;
-					second_sprite = 1;
-				}
-			}
-
-			/* The two bytes from the pattern table. Each tile uses 16 bytes in the pattern table */
-			pattern_byte = ((tileIdx+second_sprite)<<4) /*(i*0x10)*/ + spriteY;
-			byte1 = read_ppu_vram(spr_patt_table + pattern_byte);
-			byte2 = read_ppu_vram(spr_patt_table + pattern_byte + 0x08);
-			for(tx=0;tx!=8;tx++) {
-				col_index = COLOR_IDX_FROM_PATTERN_BYTES(byte1, byte2, tx);
-				col_index |=  (byte3&0x03) << 2;
-
-				/* Don't draw background colors! */
-				if( col_index & 0x03 ) {
-
-					/* Horizontal flip? */
-					if( byte3 & SPRITE_FLIP_HORIZ )
-						x = spriteX + 7 - tx;
-					else
-						x = spriteX + tx;
-
-					if( (8 <= x && x < NES_SCREEN_WIDTH) ||
-					    (x < 8 && (PPU->CR2&DONTCLIP_SPRITES)) ){
-						if( config.show_back_spr && ( !config.run_fast || !(frame%2) ))
-							draw_pixel( x, line, system_palette[read_ppu_vram(0x3F10+col_index)]);
-						if( back_sprites[i] == 0 )
-							drawn_back_sprites[drawn_back_sprites_idx++] = x;
-					}
-					
-				}
-
-			}
-		}
+		for(i=bck_sprites;i>=0;i--)
+			if( render || mapper->latch_chr || back_sprites[i] == 0 )
+				sprite_to_line(line, back_sprites[i], big_sprite, 0x00, render && config.show_back_spr,
+				               spr_line, spr_front, spr0_line);
+		for(i=frt_sprites;i>=0;i--)
+			if( render || mapper->latch_chr || front_sprites[i] == 0 )
+				sprite_to_line(line, front_sprites[i], big_sprite, 0xFF, render && config.show_front_spr,
+				               spr_line, spr_front, spr0_line);
 	}
+	else
+		sprite0_hit = 0;
 
-	/* Draw the background tiles
+	/* Render the background tiles
 	 * For this we have to consider the horizontal and vertical
 	 * scrolling. Based on this, we choose the name table where the
 	 * tiles come from.
 	 */
-	drawn_background_idx = 0;
 	if( PPU->CR2&SHOW_BACKGROUND ) {
 
 		y = (PPU->vram_addr&0x03E0) >> 5;
 		ty = (PPU->vram_addr&0x7000) >> 12;
 		orig_name_table = 0x2000 + (PPU->vram_addr&0x0800);
+		walk_bg = render || sprite0_hit || mapper->latch_chr;
 
-		for(x=0;x!=NES_SCREEN_WIDTH;) {
+		/* Nobody needs the tiles, just advance the horizontal scroll.
+		 * A line spans 32 tiles, or 33 when it starts in the middle of one */
+		if( !walk_bg ) {
+			i = (PPU->vram_addr&0x1F) + (PPU->x ? 33 : 32);
+			if( (i >> 5) & 0x1 )
+				PPU->vram_addr ^= 0x400;
+			PPU->vram_addr = (PPU->vram_addr&0xFFE0) | (i&0x1F);
+		}
+
+		for(x=0,column=0;walk_bg && x!=NES_SCREEN_WIDTH;column++) {
 
 			/* Name and attribute table */
 			name_table = orig_name_table + (PPU->vram_addr&0x0400);
@@ -256,38 +495,42 @@ void draw_line(int line, int frame) {
 			/* Entry in name table */
 			i = (PPU->vram_addr&0x1F);
 
-			/* Get the 8x8 pixel tile where the line is present */
-			tileIdx = read_ppu_vram(name_table + i + y*NES_SCREEN_WIDTH/8);
+			/* Some mappers provide the tiles by themselves */
+			if( mapper->fetch_bg_tile &&
+			    mapper->fetch_bg_tile(column, line, name_table + i + y*NES_SCREEN_WIDTH/8,
+			                          ty, &byte1, &byte2, &palette) ) {
+
+				/* These don't come from VRAM, so they are not cached */
+				for(tx=0;tx!=8;tx++)
+					bg_row[tx] = COLOR_IDX_FROM_PATTERN_BYTES(byte1, byte2, tx);
+				row = bg_row;
+			}
+			else {
+
+				/* Get the 8x8 pixel tile where the line is present */
+				tileIdx = read_ppu_vram(name_table + i + y*NES_SCREEN_WIDTH/8);
 
-			/* Bytes that participate on the lower bits for the color */
-			byte1 = read_ppu_vram(scr_patt_table + (tileIdx<<4) /*(i*0x10)*/ + ty);
-			byte2 = read_ppu_vram(scr_patt_table + (tileIdx<<4) /*(i*0x10)*/ + ty + 0x08);
-			/* Byte participating on the higher bits for the color */
-			byte3 = read_ppu_vram(attr_table + (i >> 2) + (y >> 2)*NES_SCREEN_WIDTH/32);
+				/* Already decoded lower bits for the color */
+				row = chr_tile_row(scr_patt_table + (tileIdx<<4) /*(i*0x10)*/ + ty, 0);
+				if( mapper->latch_chr )
+					mapper->latch_chr(scr_patt_table + (tileIdx<<4) + ty + 0x08);
 
-			/* Draw the tile pixels */
+				/* Byte participating on the higher bits for the color */
+				byte3 = read_ppu_vram(attr_table + (i >> 2) + (y >> 2)*NES_SCREEN_WIDTH/32);
+				tmp = (((y >> 1)&0x1)<<1) + ((i >> 1)&0x1);
+				palette = (byte3 >> (tmp<<1) /*(i*2)*/ )&0x03;
+			}
+
+			/* Render the tile pixels */
 			for(tx=(x?0:PPU->x); tx!=8; tx++) {
 
 				/* This is from the pattern table */
-				col_index = COLOR_IDX_FROM_PATTERN_BYTES(byte1, byte2, tx);;
+				col_index = row[tx];
 
 				/* And this from the attribute table */
-				tmp = (((y >> 1)&0x1)<<1) + ((i >> 1)&0x1);
-				col_index |=  ((byte3 >> (tmp<<1) /*(i*2)*/ )&0x03) << 2;
-
-				if( (col_index & 0x03) &&
-				    ( (x >= 8) || (x < 8 && (PPU->CR2&DONTCLIP_BACKGROUND)) ) ){
-					drawn_background[drawn_background_idx++] = x;
-
-					for(j=0;!(PPU->SR&HIT_FLAG)&&j!=drawn_back_sprites_idx;j++) {
-						if( x == drawn_back_sprites[j] && x < NES_SCREEN_WIDTH-1 && line < NES_SCREEN_HEIGHT ) {
-							PPU->SR |= HIT_FLAG;
-							break;
-						}
-					}
-					if( config.show_bg && ( !config.run_fast || !(frame%2) ) )
-						draw_pixel(x, line, system_palette[read_ppu_vram(0x3F00+col_index)]);
-				}
+				if( col_index )
+					bg_line[x] = col_index | (palette << 2);
+
 				if( ++x == NES_SCREEN_WIDTH )
 					break;
 			}
@@ -314,77 +557,40 @@ void draw_line(int line, int frame) {
 			PPU->vram_addr = (PPU->vram_addr&0xFC1F) | ((y&0x1F)<<5);
 		}
 	}
-	drawn_background_idx--;
 
-	/* Draw the front sprites */
-	if( PPU->CR2&SHOW_SPRITES ) {
-		for(i=frt_sprites;i>=0;i--) {
-
-			/* Each tile information uses 4 bytes */
-			tileNum = front_sprites[i]<<2 /*(i*4)*/;
-
-			/* 0: Y coord (-1). 1: Tile idx. 2: attrs. 3: X coord */
-			spriteY = line - (PPU->SPR_RAM[tileNum] + 1);
-			tileIdx = PPU->SPR_RAM[tileNum + 1];
-			byte3   = PPU->SPR_RAM[tileNum + 2];
-			spriteX = PPU->SPR_RAM[tileNum + 3];
-
-			/* If V Flip... */
-			if( byte3 & SPRITE_FLIP_VERT )
-				spriteY = (big_sprite ? 15 : 7) - spriteY;
-
-			/* 8x16 sprites pattern table depends on the tileIdx being even or odd */
-			second_sprite = 0;
-			if( big_sprite ) {
-				spr_patt_table = (tileIdx&0x1)<<12 /*(i*0x1000)*/;
-				tileIdx &= 0xFE;
-				if( spriteY >= 8 ) {
-					spriteY -= 8;
-					second_sprite = 1;
-				}
+	/* Left column clipping */
+	if( !(PPU->CR2&DONTCLIP_BACKGROUND) )
+		memset(bg_line, 0, 8);
+	if( !(PPU->CR2&DONTCLIP_SPRITES) ) {
+		memset(spr_line, 0, 8);
+		memset(spr0_line, 0, 8);
+	}
+
+	/* Sprite #0 hit flag, the last pixel never triggers it */
+	if( sprite0_hit && line < NES_SCREEN_HEIGHT ) {
+		for(x=0;x!=NES_SCREEN_WIDTH-1;x++) {
+			if( spr0_line[x] && bg_line[x] ) {
+				PPU->SR |= HIT_FLAG;
+				break;
 			}
+		}
+	}
 
-			/* The two bytes from the pattern table. Each tile uses 16 bytes in the pattern table */
-			pattern_byte = ((tileIdx+second_sprite)<<4) /*(i*0x10)*/ + spriteY;
-			byte1 = read_ppu_vram(spr_patt_table + pattern_byte);
-			byte2 = read_ppu_vram(spr_patt_table + pattern_byte + 0x08);
+	if( !config.show_bg )
+		memset(bg_line, 0, NES_SCREEN_WIDTH);
 
-			for(tx=0;tx!=8;tx++) {
-				col_index = COLOR_IDX_FROM_PATTERN_BYTES(byte1, byte2, tx);
-				col_index |=  (byte3&0x03) << 2;
-
-				/* Don't draw background colors! */
-				if( col_index & 0x03 ) {
-
-					/* Horizontal flip? */
-					if( byte3 & SPRITE_FLIP_HORIZ )
-						x = spriteX + 7 - tx;
-					else
-						x = spriteX + tx;
-
-					if( (8 <= x && x < NES_SCREEN_WIDTH) ||
-					    (x < 8 && (PPU->CR2&DONTCLIP_SPRITES)) ){
-
-						/* Check Sprite#0 Hit flag*/
-						if( !(PPU->SR&HIT_FLAG) && front_sprites[i] == 0) {
-							for(j=drawn_background_idx;j>=0; j--) {
-								if( x == drawn_background[j] && x < NES_SCREEN_WIDTH-1 && line < NES_SCREEN_HEIGHT ) {
-									PPU->SR |= HIT_FLAG;
-									break;
-								}
-							}
-						}
-
-						if( config.show_front_spr && ( !config.run_fast || !(frame%2) ) )
-							draw_pixel( x, line,
-							   system_palette[read_ppu_vram(0x3F10+col_index)]);
-					}
-					
+	/* Merge the layers and output the resulting colors */
+	if( render ) {
+		compose_line(bg_line, spr_line, spr_front, out_line);
 
-				}
+		line_colors[0] = config.show_screen_bg ? PPU->VRAM[0x3F00] : 0;
+		for(i=1;i!=0x20;i++)
+			line_colors[i] = read_ppu_vram(0x3F00+i);
 
-			}
-		}
+		for(x=0;x!=NES_SCREEN_WIDTH;x++)
+			draw_pixel(x, line, line_colors[out_line[x]]);
+		if( line >= 0 && line < NES_SCREEN_HEIGHT )
+			nes_frame->cr2[line] = PPU->CR2;
 	}
 
 	DEBUG(
@@ -493,8 +699,11 @@ void write_ppu_vram(uint16_t address, uint8_t value) {
 	address &= 0x3FFF;
 
 	/* This range has no mirroring */
-	if( address < 0x2000 )
+	if( address < 0x2000 ) {
 		PPU->VRAM[address] = value;
+		chr_tile_dirty[address / CHR_TILE_SIZE] = 1;
+		return;
+	}
 
 	/* After palette mirroring */
 	if( 0x3F20 <= address ) {
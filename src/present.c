@@ -0,0 +1,264 @@
+/*  ImaNES: I'm a NES. An intelligent NES emulator
+
+    present.c   -    Presentation of the emulated frames
+
+    Copyright (C) 2009   Rodrigo Tobar Carrizo
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <SDL/SDL.h>
+
+#include "common.h"
+#include "i18n.h"
+#include "imaconfig.h"
+#include "ntsc.h"
+#include "palette.h"
+#include "platform.h"
+#include "ppu.h"
+#include "present.h"
+#include "recorder.h"
+#include "screen.h"
+#include "screenshot.h"
+#include "telemetry.h"
+
+/* Set in the shared slot when it holds a frame not shown yet */
+#define FRESH_FRAME  (0x4)
+
+frame_buffer *nes_frame;
+
+static frame_buffer buffers[PRESENT_BUFFERS];
+
+/* Buffer being drawn by the PPU, and the one being shown. The third one
+ * is in the shared slot, which is exchanged atomically by both sides */
+static int back;
+static int front;
+static volatile long shared;
+
+static SDL_Thread *presenter;
+static SDL_sem *frame_ready;
+static SDL_mutex *present_lock;
+static SDL_cond *present_done;
+static int presenting;
+static int running;
+
+/* Screen colors of the system palette, with every emphasis */
+static Uint32 colours[NES_EMPHASIS_COLORS];
+
+/* Filters the visible lines through the NTSC filter, and scales them */
+static void present_ntsc(const frame_buffer *frame) {
+
+	int x, y, i;
+	int scale = config.video_scale;
+	int width = NES_SCREEN_WIDTH*scale;
+	uint32_t filtered[NES_SCREEN_WIDTH*NTSC_OUT_PER_PIXEL];
+	Uint32 *dst = (Uint32 *)nes_screen->pixels;
+
+	for(y=8; y!=NES_SCREEN_HEIGHT-8; y++) {
+
+		ntsc_filter_line(frame->pixels + y*NES_SCREEN_WIDTH, frame->cr2[y],
+		                 (frame->phase + y) % NTSC_PHASES, filtered);
+
+		if( scale == NTSC_OUT_PER_PIXEL )
+			memcpy(dst, filtered, sizeof(filtered));
+		else
+			for(x=0; x!=width; x++)
+				dst[x] = filtered[x*NTSC_OUT_PER_PIXEL/scale];
+		for(i=1; i!=scale; i++)
+			memcpy(dst + i*width, dst, width*sizeof(Uint32));
+		dst += width*scale;
+	}
+}
+
+/* Converts the visible lines to the screen colors, and flips the screen */
+static void present(const frame_buffer *frame) {
+
+	int x, y, i;
+	int scale = config.video_scale;
+	int width = NES_SCREEN_WIDTH*scale;
+	int mask;
+	uint8_t cr2;
+	const Uint32 *line_colours;
+	Uint32 *dst;
+	const uint8_t *src;
+	int flipped;
+	uint64_t start = telemetry_now();
+
+	if( config.ntsc_filter ) {
+		present_ntsc(frame);
+		goto flip;
+	}
+
+	/* The first and last 8 lines are not shown on NTSC screens */
+	dst = (Uint32 *)nes_screen->pixels;
+	src = frame->pixels + 8*NES_SCREEN_WIDTH;
+	for(y=0; y!=NES_NTSC_HEIGHT; y++, src += NES_SCREEN_WIDTH) {
+
+		/* Emphasis selects the part of the palette, and the
+		 * monochrome mode keeps only the grey column */
+		cr2 = frame->cr2[y+8];
+		line_colours = colours + ((cr2 & EMPHASIS_MASK) << 1);
+		mask = (cr2 & MONOCHROME_MODE) ? 0x30 : 0x3F;
+
+		if( scale == 1 ) {
+			for(x=0; x!=NES_SCREEN_WIDTH; x++)
+				dst[x] = line_colours[src[x] & mask];
+			dst += width;
+			continue;
+		}
+
+		for(x=0; x!=NES_SCREEN_WIDTH; x++)
+			for(i=0; i!=scale; i++)
+				dst[x*scale+i] = line_colours[src[x] & mask];
+		for(i=1; i!=scale; i++)
+			memcpy(dst + i*width, dst, width*sizeof(Uint32));
+		dst += width*scale;
+	}
+
+flip:
+	lock_video();
+	flipped = SDL_Flip(nes_screen);
+	unlock_video();
+	if( flipped == -1 ) {
+		fprintf(stderr,_("Couldn't refresh screen :(\n"));
+		fprintf(stderr,_("I'm exiting now\n"));
+		SDL_Quit();
+		exit(EXIT_FAILURE);
+	}
+
+	if( counters.presented_frames == 0 )
+		telemetry_first_frame();
+	COUNT(presented_frames, 1);
+	COUNT(present_time, telemetry_now() - start);
+}
+
+static int presentation_thread(void *unused) {
+
+	long slot;
+
+	for(;;) {
+
+		SDL_SemWait(frame_ready);
+
+		SDL_LockMutex(present_lock);
+		if( !running && !(shared & FRESH_FRAME) ) {
+			SDL_UnlockMutex(present_lock);
+			break;
+		}
+		presenting = 1;
+		SDL_UnlockMutex(present_lock);
+
+		/* Several frames may have been published while we were
+		 * showing the last one, only the newest one is left */
+		if( shared & FRESH_FRAME ) {
+			slot = IMANES_XCHG(&shared, (long)front);
+			front = (int)(slot & ~FRESH_FRAME);
+			present(buffers + front);
+		}
+
+		SDL_LockMutex(present_lock);
+		presenting = 0;
+		SDL_CondBroadcast(present_done);
+		SDL_UnlockMutex(present_lock);
+	}
+
+	return 0;
+}
+
+void initialize_presentation() {
+
+	int i;
+
+	for(i=0; i!=NES_EMPHASIS_COLORS; i++) {
+		if( config.use_sdl_colors )
+			colours[i] = SDL_MapRGB(nes_screen->format, system_palette[i].red,
+			                        system_palette[i].green, system_palette[i].blue);
+		else
+			colours[i] = system_palette[i].combined;
+	}
+
+	back = 0;
+	shared = 1;
+	front = 2;
+	nes_frame = buffers + back;
+
+	if( config.ntsc_filter )
+		initialize_ntsc_filter();
+
+	if( !config.present_thread )
+		return;
+
+	frame_ready  = SDL_CreateSemaphore(0);
+	present_lock = SDL_CreateMutex();
+	present_done = SDL_CreateCond();
+	running = 1;
+	presenter = SDL_CreateThread(presentation_thread, NULL);
+
+	if( presenter == NULL ) {
+		fprintf(stderr,_("Couldn't start the presentation thread, frames will be shown synchronously: %s\n"), SDL_GetError());
+		config.present_thread = 0;
+	}
+}
+
+void publish_frame() {
+
+	long slot;
+
+	/* Consecutive frames start at alternate phases */
+	nes_frame->phase = PPU->frames & 1;
+
+	capture_frame(nes_frame->pixels, PPU->frames);
+	record_frame(nes_frame->pixels, PPU->frames);
+
+	if( !config.present_thread ) {
+		present(nes_frame);
+		return;
+	}
+
+	slot = IMANES_XCHG(&shared, (long)back | FRESH_FRAME);
+	if( slot & FRESH_FRAME )
+		COUNT(dropped_frames, 1);
+	back = (int)(slot & ~FRESH_FRAME);
+	nes_frame = buffers + back;
+
+	SDL_SemPost(frame_ready);
+}
+
+void present_flush() {
+
+	if( !config.present_thread )
+		return;
+
+	SDL_LockMutex(present_lock);
+	while( presenting || (shared & FRESH_FRAME) )
+		SDL_CondWait(present_done, present_lock);
+	SDL_UnlockMutex(present_lock);
+}
+
+void end_presentation() {
+
+	if( !config.present_thread )
+		return;
+
+	SDL_LockMutex(present_lock);
+	running = 0;
+	SDL_UnlockMutex(present_lock);
+	SDL_SemPost(frame_ready);
+	SDL_WaitThread(presenter, NULL);
+
+	SDL_DestroyCond(present_done);
+	SDL_DestroyMutex(present_lock);
+	SDL_DestroySemaphore(frame_ready);
+	config.present_thread = 0;
+}
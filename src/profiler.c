@@ -0,0 +1,374 @@
+/*  ImaNES: I'm a NES. An intelligent NES emulator
+
+    profiler.c   -    Execution profiler
+
+    Copyright (C) 2009   Rodrigo Tobar Carrizo
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "clock.h"
+#include "cpu.h"
+#include "i18n.h"
+#include "instruction_set.h"
+#include "platform.h"
+#include "profiler.h"
+#include "translator.h"
+
+/* Rows of the hottest code section of the report */
+#define REPORT_ROWS      (100)
+
+/* Buckets of the mapper/SRAM writes, one per 8 Kb from $6000 */
+#define MAPPER_BUCKETS   (5)
+
+typedef struct _profile_count {
+	uint64_t count;
+	uint64_t cycles;
+} profile_count;
+
+/* A function in a call stack. Functions are identified by their entry
+ * PRG-ROM offset, or by their CPU address when it is not in a known bank */
+typedef struct _profile_node {
+	int      parent;
+	long     key;
+	uint16_t PC;
+	uint64_t cycles;   /* Cycles spent in the function itself */
+} profile_node;
+
+/* An executed instruction */
+typedef struct _profile_site {
+	profile_count count;
+	uint16_t PC;
+	uint8_t  opcode;
+	long     offset;   /* PRG-ROM offset, -1 if not in a known bank */
+} profile_site;
+
+int profiling = 0;
+
+static unsigned long rom_size;
+static profile_site *rom_sites;          /* Indexed by PRG-ROM offset */
+static profile_site *pc_sites;           /* Code out of known PRG banks */
+static profile_count opcode_counts[OPCODES_NUMBER];
+static uint64_t io_reads[0x4000];        /* $2000 -> $5FFF */
+static uint64_t io_writes[0x4000];
+static uint64_t mapper_writes[MAPPER_BUCKETS];
+
+static profile_node *nodes;
+static int *node_hash;
+static int used_nodes;
+static int stack[PROFILE_MAX_DEPTH];
+static int depth;
+static int lost_depth;                   /* Frames above the maximum depth */
+
+/* The instruction whose cycles are still being counted */
+static int pending = 0;
+static uint16_t pending_pc;
+static uint8_t pending_opcode;
+static long pending_offset;
+static unsigned long int pending_start;
+
+/* Returns the node for a function called from parent, creating it */
+static int get_node(int parent, long key, uint16_t pc) {
+
+	unsigned int h;
+
+	h = ((unsigned int)parent * 2654435761U) ^ (unsigned int)key;
+	for(h &= 2*PROFILE_MAX_NODES - 1; node_hash[h] != -1; h = (h + 1) & (2*PROFILE_MAX_NODES - 1)) {
+		if( nodes[node_hash[h]].parent == parent && nodes[node_hash[h]].key == key )
+			return node_hash[h];
+	}
+
+	/* No more room, account it to the caller */
+	if( used_nodes == PROFILE_MAX_NODES )
+		return parent;
+
+	nodes[used_nodes].parent = parent;
+	nodes[used_nodes].key    = key;
+	nodes[used_nodes].PC     = pc;
+	nodes[used_nodes].cycles = 0;
+	node_hash[h] = used_nodes;
+	return used_nodes++;
+}
+
+static void push_frame(long key, uint16_t pc) {
+
+	if( depth == PROFILE_MAX_DEPTH - 1 ) {
+		lost_depth++;
+		return;
+	}
+	stack[depth+1] = get_node(stack[depth], key, pc);
+	depth++;
+}
+
+static void pop_frame() {
+
+	if( lost_depth )
+		lost_depth--;
+	else if( depth )
+		depth--;
+}
+
+/* Returns the key of the function starting at the current PC */
+static long function_key() {
+
+	long offset = prg_offset(CPU->PC);
+	return offset >= 0 ? offset + 0x10000 : CPU->PC;
+}
+
+/* Accounts the cycles of the pending instruction, and follows the calls */
+static void flush_pending() {
+
+	unsigned int cycles;
+	profile_site *site;
+
+	if( !pending )
+		return;
+	pending = 0;
+
+	cycles = (unsigned int)(CLK->ppu_cycles - pending_start)/3;
+	if( pending_offset >= 0 )
+		site = &rom_sites[pending_offset];
+	else
+		site = &pc_sites[pending_pc];
+	site->PC     = pending_pc;
+	site->opcode = pending_opcode;
+	site->offset = pending_offset;
+	site->count.count++;
+	site->count.cycles += cycles;
+	opcode_counts[pending_opcode].count++;
+	opcode_counts[pending_opcode].cycles += cycles;
+	nodes[stack[depth]].cycles += cycles;
+
+	switch( pending_opcode ) {
+		case 0x20: /* JSR */
+			push_frame(function_key(), CPU->PC);
+			break;
+		case 0x00: /* BRK */
+			push_frame(PROFILE_IRQ, CPU->PC);
+			break;
+		case 0x40: /* RTI */
+		case 0x60: /* RTS */
+			pop_frame();
+			break;
+	}
+}
+
+void initialize_profiler(unsigned long prg_size) {
+
+	rom_size   = prg_size;
+	rom_sites  = (profile_site *)calloc(prg_size, sizeof(profile_site));
+	pc_sites   = (profile_site *)calloc(NES_RAM_SIZE, sizeof(profile_site));
+	nodes      = (profile_node *)malloc(sizeof(profile_node) * PROFILE_MAX_NODES);
+	node_hash  = (int *)malloc(sizeof(int) * 2 * PROFILE_MAX_NODES);
+	memset(node_hash, -1, sizeof(int) * 2 * PROFILE_MAX_NODES);
+
+	/* The root of all the stacks */
+	nodes[0].parent = -1;
+	nodes[0].key    = PROFILE_RESET;
+	nodes[0].PC     = 0;
+	nodes[0].cycles = 0;
+	used_nodes = 1;
+	stack[0]   = 0;
+	depth      = 0;
+	lost_depth = 0;
+
+	profiling = 1;
+}
+
+void profile_instruction() {
+
+	flush_pending();
+
+	pending = 1;
+	pending_pc     = CPU->PC;
+	pending_opcode = CPU->RAM[CPU->PC];
+	pending_offset = prg_offset(CPU->PC);
+	pending_start  = CLK->ppu_cycles;
+}
+
+void profile_interrupt(int kind) {
+
+	flush_pending();
+
+	if( kind == PROFILE_RESET ) {
+		depth = 0;
+		lost_depth = 0;
+	}
+	else
+		push_frame(kind, CPU->PC);
+}
+
+void profile_io(uint16_t address, int write) {
+
+	if( address < 0x6000 ) {
+		if( write )
+			io_writes[address - 0x2000]++;
+		else
+			io_reads[address - 0x2000]++;
+	}
+	else if( write )
+		mapper_writes[(address - 0x6000)/0x2000]++;
+}
+
+/* Sorts sites by decreasing cycles */
+static int compare_sites(const void *a, const void *b) {
+
+	uint64_t ca = (*(profile_site **)a)->count.cycles;
+	uint64_t cb = (*(profile_site **)b)->count.cycles;
+
+	return ca < cb ? 1 : (ca > cb ? -1 : 0);
+}
+
+/* Writes the name of a stack frame */
+static void frame_name(FILE *f, profile_node *node) {
+
+	switch( node->key ) {
+		case PROFILE_RESET: fprintf(f, "RESET"); break;
+		case PROFILE_NMI:   fprintf(f, "NMI");   break;
+		case PROFILE_IRQ:   fprintf(f, "IRQ");   break;
+		default:
+			if( node->key >= 0x10000 )
+				fprintf(f, "sub_%02lX:%04X", (node->key - 0x10000)/PRG_PAGE_SIZE, node->PC);
+			else
+				fprintf(f, "sub_%04X", node->PC);
+			break;
+	}
+}
+
+/* Writes the path from the root to a node */
+static void stack_path(FILE *f, int node) {
+
+	if( nodes[node].parent != -1 ) {
+		stack_path(f, nodes[node].parent);
+		fprintf(f, ";");
+	}
+	frame_name(f, &nodes[node]);
+}
+
+static void write_report(FILE *f) {
+
+	unsigned long i;
+	unsigned long rows = 0;
+	uint64_t executed = 0;
+	uint64_t cycles = 0;
+	profile_site **row;
+
+	for(i=0;i!=OPCODES_NUMBER;i++) {
+		executed += opcode_counts[i].count;
+		cycles += opcode_counts[i].cycles;
+	}
+	if( cycles == 0 )
+		cycles = 1;
+
+	fprintf(f, _("# ImaNES profile: %llu instructions, %llu CPU cycles\n"),
+	        (unsigned long long)executed, (unsigned long long)cycles);
+	fprintf(f, _("# Banks are 8 Kb pages of the PRG-ROM\n\n"));
+
+	/* Hottest code */
+	row = (profile_site **)malloc(sizeof(profile_site *) * (rom_size + NES_RAM_SIZE));
+	for(i=0;i!=rom_size;i++)
+		if( rom_sites[i].count.count )
+			row[rows++] = &rom_sites[i];
+	for(i=0;i!=NES_RAM_SIZE;i++)
+		if( pc_sites[i].count.count )
+			row[rows++] = &pc_sites[i];
+	qsort(row, rows, sizeof(profile_site *), compare_sites);
+
+	fprintf(f, _("## Hottest code\n"));
+	fprintf(f, "%14s %7s %12s  %-4s %-4s %s\n", _("cycles"), "%", _("count"), _("bank"), "PC", _("instruction"));
+	for(i=0; i!=rows && i!=REPORT_ROWS; i++) {
+		fprintf(f, "%14llu %6.2f%% %12llu  ",
+		        (unsigned long long)row[i]->count.cycles, 100.*row[i]->count.cycles/cycles,
+		        (unsigned long long)row[i]->count.count);
+		if( row[i]->offset >= 0 )
+			fprintf(f, "%02lX   ", row[i]->offset/PRG_PAGE_SIZE);
+		else
+			fprintf(f, "--   ");
+		fprintf(f, "%04X %02X %s\n", row[i]->PC, row[i]->opcode, instructions[row[i]->opcode].name);
+	}
+	free(row);
+
+	/* Opcodes */
+	fprintf(f, _("\n## Opcodes\n"));
+	fprintf(f, "%14s %7s %12s  %s\n", _("cycles"), "%", _("count"), _("opcode"));
+	for(i=0;i!=OPCODES_NUMBER;i++) {
+		if( opcode_counts[i].count )
+			fprintf(f, "%14llu %6.2f%% %12llu  %02lX %s\n",
+			        (unsigned long long)opcode_counts[i].cycles, 100.*opcode_counts[i].cycles/cycles,
+			        (unsigned long long)opcode_counts[i].count, i, instructions[i].name);
+	}
+
+	/* I/O registers */
+	fprintf(f, _("\n## I/O registers\n"));
+	fprintf(f, "%-11s %12s %12s\n", _("register"), _("reads"), _("writes"));
+	for(i=0;i!=0x4000;i++) {
+		if( io_reads[i] || io_writes[i] )
+			fprintf(f, "$%04lX       %12llu %12llu\n", i + 0x2000,
+			        (unsigned long long)io_reads[i], (unsigned long long)io_writes[i]);
+	}
+	for(i=0;i!=MAPPER_BUCKETS;i++) {
+		if( mapper_writes[i] )
+			fprintf(f, "$%04lX-$%04lX %12s %12llu\n", 0x6000 + i*0x2000, 0x7FFF + i*0x2000,
+			        "-", (unsigned long long)mapper_writes[i]);
+	}
+}
+
+void end_profiler(char *file) {
+
+	int i;
+	char *folded;
+	FILE *f;
+
+	if( !profiling )
+		return;
+	flush_pending();
+	profiling = 0;
+
+	f = fopen(file, "w");
+	if( f == NULL ) {
+		fprintf(stderr,_("Error while opening profile file '%s': "), file);
+		perror(NULL);
+	}
+	else {
+		write_report(f);
+		fclose(f);
+	}
+
+	folded = (char *)malloc(strlen(file) + 8);
+	imanes_sprintf(folded, strlen(file) + 8, "%s.folded", file);
+	f = fopen(folded, "w");
+	if( f == NULL ) {
+		fprintf(stderr,_("Error while opening profile file '%s': "), folded);
+		perror(NULL);
+	}
+	else {
+		for(i=0;i!=used_nodes;i++) {
+			if( nodes[i].cycles ) {
+				stack_path(f, i);
+				fprintf(f, " %llu\n", (unsigned long long)nodes[i].cycles);
+			}
+		}
+		fclose(f);
+	}
+	free(folded);
+
+	free(rom_sites);
+	free(pc_sites);
+	free(nodes);
+	free(node_hash);
+}
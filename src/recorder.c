@@ -0,0 +1,363 @@
+/*  ImaNES: I'm a NES. An intelligent NES emulator
+
+    recorder.c   -    Lossless recording of frames and audio
+
+    Copyright (C) 2009   Rodrigo Tobar Carrizo
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL/SDL.h>
+
+#include "common.h"
+#include "frame_control.h"
+#include "i18n.h"
+#include "mapper.h"
+#include "palette.h"
+#include "playback.h"
+#include "recorder.h"
+#include "screen.h"
+#include "telemetry.h"
+
+#define FRAME_SIZE  (NES_SCREEN_WIDTH*NES_NTSC_HEIGHT)
+
+/* Worst case. No operation takes more than 2 bytes per pixel: skips take
+ * 1 byte, or 3 from RECORD_LONG_OP pixels, runs of 3 pixels or more take 4
+ * bytes at most, and literals take 1 byte more than their pixels, or 3 more
+ * from RECORD_LONG_OP pixels */
+#define ENCODED_SIZE  (2*FRAME_SIZE)
+
+typedef struct _recorded_frame {
+	uint8_t pixels[FRAME_SIZE];
+	unsigned long number;
+} recorded_frame;
+
+static int recording = 0;
+
+static FILE *record_file;
+static recorded_frame queue[RECORD_QUEUE];
+static int head;
+static int pending;
+static int running;
+
+static SDL_Thread *encoder;
+static SDL_mutex *record_lock;
+static SDL_cond *record_ready;
+
+/* Last written frame, and the frames since the last key frame */
+static uint8_t previous[FRAME_SIZE];
+static int since_key;
+static uint8_t encoded[ENCODED_SIZE];
+
+/* Audio ring, filled from the audio callback */
+static uint8_t audio[RECORD_AUDIO_SIZE];
+static unsigned int audio_head;
+static unsigned int audio_length;
+
+static void put_le(uint8_t *out, uint64_t value, int bytes) {
+
+	int i;
+
+	for(i=0; i!=bytes; i++)
+		out[i] = (uint8_t)(value >> (8*i));
+}
+
+static size_t put_op(uint8_t *out, int type, int pixels) {
+
+	if( pixels < RECORD_LONG_OP ) {
+		out[0] = (uint8_t)(type << 6 | pixels);
+		return 1;
+	}
+	out[0] = (uint8_t)(type << 6 | RECORD_LONG_OP);
+	put_le(out + 1, pixels, 2);
+	return 3;
+}
+
+/* Encodes a frame as the differences with the previous one, or as runs
+ * and literals only if there's no previous frame */
+static size_t encode_frame(uint8_t *out, const uint8_t *frame, const uint8_t *prev) {
+
+	size_t pos = 0;
+	int i = 0, len;
+
+	while( i < FRAME_SIZE ) {
+
+		/* Unchanged pixels */
+		len = 0;
+		if( prev != NULL )
+			while( i+len < FRAME_SIZE && len < RECORD_MAX_OP && frame[i+len] == prev[i+len] )
+				len++;
+		if( len ) {
+			pos += put_op(out + pos, RECORD_SKIP, len);
+			i += len;
+			continue;
+		}
+
+		/* Pixels of the same color */
+		len = 1;
+		while( i+len < FRAME_SIZE && len < RECORD_MAX_OP && frame[i+len] == frame[i] )
+			len++;
+		if( len >= 3 ) {
+			pos += put_op(out + pos, RECORD_RUN, len);
+			out[pos++] = frame[i];
+			i += len;
+			continue;
+		}
+
+		/* Anything else, until something of the above appears. Shorter
+		 * skips and runs don't pay the new operation */
+		len = 1;
+		while( i+len < FRAME_SIZE && len < RECORD_MAX_OP ) {
+			if( prev != NULL && i+len+1 < FRAME_SIZE &&
+			    frame[i+len] == prev[i+len] && frame[i+len+1] == prev[i+len+1] )
+				break;
+			if( i+len+3 < FRAME_SIZE && frame[i+len] == frame[i+len+1] &&
+			    frame[i+len] == frame[i+len+2] && frame[i+len] == frame[i+len+3] )
+				break;
+			len++;
+		}
+		pos += put_op(out + pos, RECORD_LITERAL, len);
+		memcpy(out + pos, frame + i, len);
+		pos += len;
+		i += len;
+	}
+
+	return pos;
+}
+
+/* Returns 0 if the chunk was completely written */
+static int write_chunk(char type, const uint8_t *prefix, size_t prefix_size,
+                       const uint8_t *data, size_t size) {
+
+	uint8_t header[5];
+
+	header[0] = (uint8_t)type;
+	put_le(header + 1, prefix_size + size, 4);
+	if( fwrite(header, 1, 5, record_file) != 5 )
+		return 1;
+	if( prefix_size && fwrite(prefix, 1, prefix_size, record_file) != prefix_size )
+		return 1;
+	return fwrite(data, 1, size, record_file) != size;
+}
+
+/* Writes the audio played until now, in at most two pieces of the ring */
+static int write_audio() {
+
+	static uint8_t samples[RECORD_AUDIO_SIZE];
+	unsigned int length, first;
+
+	SDL_LockAudio();
+	length = audio_length;
+	first = RECORD_AUDIO_SIZE - audio_head;
+	if( first > length )
+		first = length;
+	memcpy(samples, audio + audio_head, first);
+	memcpy(samples + first, audio, length - first);
+	audio_head = (audio_head + length) % RECORD_AUDIO_SIZE;
+	audio_length = 0;
+	SDL_UnlockAudio();
+
+	if( length )
+		return write_chunk('A', NULL, 0, samples, length);
+	return 0;
+}
+
+static int write_frame(recorded_frame *f) {
+
+	uint8_t number[4];
+	size_t size;
+	int key = (since_key == 0);
+
+	if( write_audio() )
+		return 1;
+
+	size = encode_frame(encoded, f->pixels, key ? NULL : previous);
+	put_le(number, f->number, 4);
+	if( write_chunk(key ? 'K' : 'F', number, 4, encoded, size) )
+		return 1;
+
+	memcpy(previous, f->pixels, FRAME_SIZE);
+	since_key = (since_key + 1) % KEYFRAME_INTERVAL;
+	return 0;
+}
+
+static int recording_thread(void *unused) {
+
+	recorded_frame *f;
+
+	SDL_LockMutex(record_lock);
+	for(;;) {
+
+		while( running && !pending )
+			SDL_CondWait(record_ready, record_lock);
+		if( !pending )
+			break;
+
+		f = queue + head;
+		SDL_UnlockMutex(record_lock);
+
+		if( write_frame(f) ) {
+			perror(_("Error while writing the recording, it has been stopped"));
+			SDL_LockMutex(record_lock);
+			running = 0;
+			pending = 0;
+			break;
+		}
+
+		SDL_LockMutex(record_lock);
+		head = (head + 1) % RECORD_QUEUE;
+		pending--;
+	}
+	SDL_UnlockMutex(record_lock);
+
+	return 0;
+}
+
+int initialize_recording(char *file_name) {
+
+	int i;
+	uint8_t header[32 + 3*NES_PALETTE_COLORS];
+	uint8_t *color;
+
+	record_file = fopen(file_name, "wb");
+	if( record_file == NULL ) {
+		fprintf(stderr,_("Error while opening recording file '%s': "), file_name);
+		perror(NULL);
+		return 1;
+	}
+	setvbuf(record_file, NULL, _IOFBF, 1 << 20);
+
+	memcpy(header, "IMANESV", 7);
+	header[7] = RECORD_VERSION;
+	put_le(header + 8, NES_SCREEN_WIDTH, 2);
+	put_le(header + 10, NES_NTSC_HEIGHT, 2);
+	if( mapper->file->pal ) {
+		put_le(header + 12, PAL_FRAME_NS_NUM, 8);
+		put_le(header + 20, PAL_FRAME_NS_DEN, 8);
+	}
+	else {
+		put_le(header + 12, NTSC_FRAME_NS_NUM, 8);
+		put_le(header + 20, NTSC_FRAME_NS_DEN, 8);
+	}
+	put_le(header + 28, playback_rate(), 4);
+	for(i=0; i!=NES_PALETTE_COLORS; i++) {
+		color = header + 32 + 3*i;
+		color[0] = system_palette[i].red;
+		color[1] = system_palette[i].green;
+		color[2] = system_palette[i].blue;
+	}
+	if( fwrite(header, 1, sizeof(header), record_file) != sizeof(header) ) {
+		fprintf(stderr,_("Error while writing recording file '%s': "), file_name);
+		perror(NULL);
+		fclose(record_file);
+		return 1;
+	}
+
+	record_lock  = SDL_CreateMutex();
+	record_ready = SDL_CreateCond();
+	running = 1;
+	encoder = SDL_CreateThread(recording_thread, NULL);
+	if( encoder == NULL ) {
+		fprintf(stderr,_("Couldn't start the recording thread: %s\n"), SDL_GetError());
+		fclose(record_file);
+		SDL_DestroyCond(record_ready);
+		SDL_DestroyMutex(record_lock);
+		return 1;
+	}
+
+	recording = 1;
+	return 0;
+}
+
+void record_frame(const uint8_t *frame, unsigned long number) {
+
+	recorded_frame *f;
+
+	if( !recording )
+		return;
+
+	SDL_LockMutex(record_lock);
+
+	/* Stopped after a write error */
+	if( !running ) {
+		SDL_UnlockMutex(record_lock);
+		return;
+	}
+
+	if( pending == RECORD_QUEUE ) {
+		SDL_UnlockMutex(record_lock);
+		COUNT(dropped_captures, 1);
+		return;
+	}
+	f = queue + (head + pending) % RECORD_QUEUE;
+	SDL_UnlockMutex(record_lock);
+
+	memcpy(f->pixels, frame + 8*NES_SCREEN_WIDTH, FRAME_SIZE);
+	f->number = number;
+
+	SDL_LockMutex(record_lock);
+	pending++;
+	SDL_CondSignal(record_ready);
+	SDL_UnlockMutex(record_lock);
+}
+
+void record_audio(const uint8_t *samples, int len) {
+
+	unsigned int tail;
+	int i;
+
+	if( !recording )
+		return;
+
+	/* Called from the audio callback, where the audio is already locked */
+	for(i=0; i!=len && audio_length != RECORD_AUDIO_SIZE; i++) {
+		tail = (audio_head + audio_length) % RECORD_AUDIO_SIZE;
+		audio[tail] = samples[i];
+		audio_length++;
+	}
+}
+
+void end_recording() {
+
+	int stopped;
+	int failed;
+
+	if( !recording )
+		return;
+
+	SDL_LockMutex(record_lock);
+	stopped = !running;
+	running = 0;
+	SDL_CondSignal(record_ready);
+	SDL_UnlockMutex(record_lock);
+	SDL_WaitThread(encoder, NULL);
+	recording = 0;
+
+	/* The last frames are only in the buffer until it's closed. Write
+	 * errors in the thread have already been reported */
+	if( !stopped ) {
+		failed = write_audio();
+		if( fclose(record_file) || failed )
+			perror(_("Error while writing the recording"));
+	}
+	else
+		fclose(record_file);
+
+	SDL_DestroyCond(record_ready);
+	SDL_DestroyMutex(record_lock);
+}
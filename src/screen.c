@@ -24,27 +24,59 @@
 #include "common.h"
 #include "debug.h"
 #include "i18n.h"
+#include "icon.h"
 #include "imaconfig.h"
 #include "loop.h"
+#include "ntsc.h"
 #include "pad.h"
 #include "platform.h"
+#include "present.h"
 #include "screen.h"
-#include "screenshot.h"
 
 /* This is used by the screenshot utility */
 SDL_Surface *nes_screen;
 
+static SDL_mutex *video_lock;
+
+void lock_video() {
+	SDL_LockMutex(video_lock);
+}
+
+void unlock_video() {
+	SDL_UnlockMutex(video_lock);
+}
+
+int poll_event(SDL_Event *event) {
+
+	int polled;
+
+	lock_video();
+	polled = SDL_PollEvent(event);
+	unlock_video();
+
+	return polled;
+}
+
 void screen_loop() {
 
 	SDL_Event event;
 
-	while( SDL_PollEvent(&event) ) {
+	while( poll_event(&event) ) {
 		switch(event.type) {
 
 			case SDL_KEYUP:
 				nes_keyup(event.key.keysym);
 				break;
 
+			case SDL_JOYBUTTONDOWN:
+			case SDL_JOYBUTTONUP:
+				nes_joybutton(&event.jbutton);
+				break;
+
+			case SDL_JOYAXISMOTION:
+				nes_joyaxis(&event.jaxis);
+				break;
+
 			/* Alt-F4 in Windows should lead us to SDL_QUIT */
 			case SDL_KEYDOWN:
 				if( !(event.key.keysym.sym == SDLK_F4 &&
@@ -68,40 +100,6 @@ void init_screen() {
 	char window_title[13];
 
 	SDL_Surface *icon;
-	Uint8 mask[32*4] = {
-		0x00, 0x00, 0x07, 0xF0,
-		0x00, 0x00, 0x0F, 0xFC,
-		0x00, 0x00, 0x1F, 0xFE,
-		0x00, 0x00, 0x3F, 0xFE,
-		0x00, 0x00, 0x3F, 0xFF,
-		0x00, 0x00, 0x7F, 0xFF,
-		0x00, 0x00, 0xFE, 0x1F,
-		0x00, 0x00, 0xFC, 0x1F,
-		0x00, 0x00, 0xF8, 0x1F,
-		0x00, 0x00, 0xF0, 0x3F,
-		0x00, 0x00, 0xF0, 0x7F,
-		0x00, 0x07, 0xE0, 0xFF,
-		0x00, 0x07, 0x73, 0xFE,
-		0x00, 0x03, 0xFF, 0xFC,
-		0x00, 0x0F, 0xFF, 0xF0,
-		0x00, 0x0E, 0xF7, 0xC0,
-		0x03, 0x89, 0xF3, 0x00,
-		0x07, 0xE3, 0xB0, 0x00,
-		0x0F, 0xF7, 0x20, 0x00,
-		0x1F, 0xFE, 0x00, 0x00,
-		0x3F, 0xFC, 0x00, 0x00,
-		0x7F, 0xFE, 0x00, 0x00,
-		0xFF, 0xFE, 0x00, 0x00,
-		0xFF, 0xFF, 0x00, 0x00,
-		0xFF, 0xFF, 0x00, 0x00,
-		0xFF, 0xFF, 0x00, 0x00,
-		0xFF, 0xFE, 0x00, 0x00,
-		0xFF, 0xFE, 0x00, 0x00,
-		0x7F, 0xFC, 0x00, 0x00,
-		0x7F, 0xFC, 0x00, 0x00,
-		0x7F, 0xFC, 0x00, 0x00,
-		0x3D, 0xBC, 0x00, 0x00
-	};
 
 	if( SDL_Init(SDL_INIT_VIDEO) < 0 ) {
 		fprintf(stderr,_("Error when initializing screen: %s\n"), SDL_GetError());
@@ -109,12 +107,20 @@ void init_screen() {
 	}
 
 
- 	icon = SDL_LoadBMP("icons/imanes-32.bmp");
+	/* The icon is built in, so it's found wherever we are run from */
+	icon = SDL_CreateRGBSurfaceFrom((void *)imanes_icon, ICON_SIZE, ICON_SIZE, 32,
+	                                ICON_SIZE*4, 0xFF0000, 0xFF00, 0xFF, 0);
 	if( icon == NULL )
 		fprintf(stderr,_("Could not load ImaNES icon :(\n"));
 	else
-		SDL_WM_SetIcon(icon, mask);
+		SDL_WM_SetIcon(icon, (Uint8 *)imanes_icon_mask);
+
 
+	/* The NTSC filter doubles the horizontal resolution */
+	if( config.ntsc_filter && config.video_scale < NTSC_OUT_PER_PIXEL ) {
+		INFO( printf(_("Using a video scale factor of %d for the NTSC filter\n"), NTSC_OUT_PER_PIXEL) );
+		config.video_scale = NTSC_OUT_PER_PIXEL;
+	}
 
 	nes_screen = SDL_SetVideoMode(NES_SCREEN_WIDTH*config.video_scale, NES_NTSC_HEIGHT*config.video_scale, NES_SCREEN_BPP, SDL_HWSURFACE | SDL_DOUBLEBUF);
 
@@ -126,29 +132,17 @@ void init_screen() {
 	imanes_sprintf(window_title,30,"ImaNES %s",IMANES_VERSION);
 
 	SDL_ShowCursor(SDL_DISABLE);
+
+	video_lock = SDL_CreateMutex();
+	initialize_presentation();
 }
 
 void end_screen() {
+	end_presentation();
+	SDL_DestroyMutex(video_lock);
 	SDL_Quit();
 }
 
-void redraw_screen() {
-
-	/* Take screenshot */
-	if( config.take_screenshot ) {
-		config.take_screenshot = 0;
-		save_screenshot();
-	}
-
-	if( SDL_Flip(nes_screen) == -1 ) {
-		fprintf(stderr,_("Couldn't refresh screen :(\n"));
-		fprintf(stderr,_("I'm exiting now\n"));
-		SDL_Quit();
-		exit(EXIT_FAILURE);
-	}
-
-}
-
 void show_fps(int fps) {
 
 	char window_title[23];
@@ -157,6 +151,8 @@ void show_fps(int fps) {
 		imanes_sprintf(window_title,23,"ImaNES %s - %d fps",IMANES_VERSION, fps);
 	else
 		imanes_sprintf(window_title,23,"ImaNES %s",IMANES_VERSION);
+	lock_video();
 	SDL_WM_SetCaption(window_title, NULL);
+	unlock_video();
 
 }
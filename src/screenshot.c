@@ -1,6 +1,6 @@
 /*  ImaNES: I'm a NES. An intelligent NES emulator
 
-    screenshot.c   -    Screenshot utility for ImaNES
+    screenshot.c   -    Screenshots and frame dumps for ImaNES
 
     Copyright (C) 2009   Rodrigo Tobar Carrizo
 
@@ -18,7 +18,6 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <fcntl.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -29,123 +28,205 @@
 #include "debug.h"
 #include "i18n.h"
 #include "imaconfig.h"
+#include "palette.h"
 #include "platform.h"
+#include "png.h"
 #include "screen.h"
 #include "screenshot.h"
+#include "telemetry.h"
 
-void save_screenshot() {
+#define CAPTURE_SIZE  (NES_SCREEN_WIDTH*NES_NTSC_HEIGHT)
+
+/* A frame waiting to be written */
+typedef struct _capture {
+	uint8_t pixels[CAPTURE_SIZE];
+	unsigned long frame;  /* Emulated frame number, names the dumps */
+	int screenshot;
+} capture;
+
+static capture queue[CAPTURE_QUEUE];
+static int head;      /* Next capture to be written */
+static int pending;   /* Captures in the queue */
+static int running;
+
+static SDL_Thread *writer;
+static SDL_mutex *capture_lock;
+static SDL_cond *capture_ready;
+
+static uint8_t encoded[PNG_BUFFER_SIZE(NES_SCREEN_WIDTH, NES_NTSC_HEIGHT, NES_PALETTE_COLORS)];
+
+/* Returns a new name for a screenshot, so we don't overwrite an existing one */
+static char *screenshot_name(const char *extension) {
 
-	int fd;
 	int i;
-	int j;
-	unsigned int offset;
-	unsigned int total_size;
+	size_t size;
 	char *ss_dir;
 	char *ss_file;
 	char *tmp;
-	char *buffer;
-	char *color;
-	uint16_t tmp16;
-	uint32_t tmp32;
-	Uint32 *pixels;
 	struct stat s;
-	RW_RET written;
-
-	total_size = 0x36 + (NES_SCREEN_WIDTH * NES_NTSC_HEIGHT)*3;
-	buffer = (char *)malloc(total_size);
-
-	/* Magic number */
-	memset(buffer, 'B', 1);
-	memset(buffer + 0x01, 'M', 1);
-
-	/* file size, reserved data and offset */
-	tmp32 = total_size;
-	memcpy(buffer + 0x02, &tmp32, 4);
-	memset(buffer + 0x06, 0, 4);
-	tmp32 = 0x36;
-	memcpy(buffer + 0x0A, &tmp32, 4);
-
-	/*** DIB header ***/
-	tmp32 = 0x28;
-	memcpy(buffer + 0x0E, &tmp32, 4);
-	/* Dimensions */
-	tmp32 = NES_SCREEN_WIDTH;
-	memcpy(buffer + 0x12, &tmp32, 4);
-	tmp32 = NES_NTSC_HEIGHT;
-	memcpy(buffer + 0x16, &tmp32, 4);
-	tmp16 = 1;
-	memcpy(buffer + 0x1A, &tmp16, 2);
-	/* bpp */
-	tmp16 = 24;
-	memcpy(buffer + 0x1C, &tmp16, 2);
-	/* Compression method */
-	memset(buffer + 0x1E, 0, 4);
-	/* Raw data size */
-	tmp32 = (NES_SCREEN_WIDTH * NES_NTSC_HEIGHT)*3;
-	memcpy(buffer + 0x22, &tmp32, 4);
-	/* Resolutions */
-	tmp32 = 2835;
-	memcpy(buffer + 0x26, &tmp32, 4);
-	memcpy(buffer + 0x2A, &tmp32, 4);
-	/* Palette colors */
-	memset(buffer + 0x2E, 0, 4);
-	memset(buffer + 0x32, 0, 4);
-
-	/* Pixel data */
-	offset = 0x36;
-	pixels = (Uint32*)nes_screen->pixels;
-	for(i = NES_NTSC_HEIGHT - 1; i>=0; i--) {
-		for(j = 0; j!= NES_SCREEN_WIDTH; j++) {
-			color = (char *)(pixels+config.video_scale*config.video_scale*i*NES_SCREEN_WIDTH+j*config.video_scale);
-			memcpy(buffer + offset++, color, 1);
-			memcpy(buffer + offset++, color+1, 1);
-			memcpy(buffer + offset++, color+2, 1);
-		}
-	}
 
 	ss_dir = get_imanes_dir(Snapshots);
-	if( ss_dir == NULL ) {
-		fprintf(stderr,_("Couldn't save screenshot\n"));
-		free(buffer);
-		free(ss_dir);
-		return;
-	}
+	if( ss_dir == NULL )
+		return NULL;
 
-	/* We loop until we find a name for a file that doesn't exist,
-	 * so we don't overwrite an existing screenshot */
 	tmp = get_filename(config.rom_file);
-	ss_file = (char *)malloc(strlen(ss_dir) + strlen(tmp) + 4 + 7);
+	size = strlen(ss_dir) + strlen(tmp) + strlen(extension) + 8;
+	ss_file = (char *)malloc(size);
 	for(i=0;;i++) {
-		imanes_sprintf(ss_file,strlen(ss_dir)+strlen(tmp)+4+7,"%s%c%s-%04d.bmp", ss_dir, DIR_SEP, tmp, i);
-		j = stat(ss_file, &s);
-		if( j == -1 )
+		imanes_sprintf(ss_file, (int)size, "%s%c%s-%04d.%s", ss_dir, DIR_SEP, tmp, i, extension);
+		if( stat(ss_file, &s) == -1 )
 			break;
 	}
 
-	IMANES_OPEN(fd, ss_file, IMANES_OPEN_WRITE);
 	free(ss_dir);
 	free(tmp);
+	return ss_file;
+}
+
+static char *dump_name(unsigned long frame, const char *extension) {
+
+	size_t size;
+	char *dump_file;
 
-	if( fd == -1 ) {
-		tmp = (char *)malloc(23 + strlen(ss_file));
-		imanes_sprintf(tmp, strlen(ss_file)+23, _("Error while opening '%s': "), ss_file);
-		perror(tmp);
-		free(tmp);
-		free(ss_file);
+	size = strlen(config.dump_dir) + strlen(extension) + 32;
+	dump_file = (char *)malloc(size);
+	imanes_sprintf(dump_file, (int)size, "%s%cframe-%06lu.%s", config.dump_dir, DIR_SEP, frame, extension);
+	return dump_file;
+}
+
+static void write_capture(capture *c) {
+
+	int i;
+	size_t size;
+	char *file_name;
+	const uint8_t *data;
+	uint8_t palette[3*NES_PALETTE_COLORS];
+	FILE *file;
+
+	if( config.capture_format == CAPTURE_RAW ) {
+		data = c->pixels;
+		size = CAPTURE_SIZE;
+	}
+	else {
+		for(i=0; i!=NES_PALETTE_COLORS; i++) {
+			palette[3*i]   = system_palette[i].red;
+			palette[3*i+1] = system_palette[i].green;
+			palette[3*i+2] = system_palette[i].blue;
+		}
+		data = encoded;
+		size = encode_png(encoded, c->pixels, NES_SCREEN_WIDTH, NES_NTSC_HEIGHT,
+		                  palette, NES_PALETTE_COLORS);
+	}
+
+	if( c->screenshot )
+		file_name = screenshot_name(config.capture_format == CAPTURE_RAW ? "raw" : "png");
+	else
+		file_name = dump_name(c->frame, config.capture_format == CAPTURE_RAW ? "raw" : "png");
+	if( file_name == NULL ) {
+		fprintf(stderr,_("Couldn't save screenshot\n"));
 		return;
 	}
 
-	written = IMANES_WRITE(fd, (void *)buffer, total_size);
+	file = fopen(file_name, "wb");
+	if( file == NULL || fwrite(data, 1, size, file) != size ) {
+		fprintf(stderr,_("Error while saving '%s': "), file_name);
+		perror(NULL);
+	}
+	else if( c->screenshot )
+		INFO( printf(_("Saved screenshot at '%s'\n"), file_name) );
+
+	if( file != NULL )
+		fclose(file);
+	free(file_name);
+}
+
+static int capture_thread(void *unused) {
 
-	if( written != total_size ) {
-		perror(_("Error while saving snapshot"));
-		free(ss_file);
+	capture *c;
+
+	SDL_LockMutex(capture_lock);
+	for(;;) {
+
+		while( running && !pending )
+			SDL_CondWait(capture_ready, capture_lock);
+		if( !pending )
+			break;
+
+		/* The slot is ours until we release it */
+		c = queue + head;
+		SDL_UnlockMutex(capture_lock);
+
+		write_capture(c);
+
+		SDL_LockMutex(capture_lock);
+		head = (head + 1) % CAPTURE_QUEUE;
+		pending--;
+	}
+	SDL_UnlockMutex(capture_lock);
+
+	return 0;
+}
+
+void initialize_capture() {
+
+	capture_lock  = SDL_CreateMutex();
+	capture_ready = SDL_CreateCond();
+	running = 1;
+
+	writer = SDL_CreateThread(capture_thread, NULL);
+	if( writer == NULL ) {
+		fprintf(stderr,_("Couldn't start the capture thread, no screenshots will be taken: %s\n"), SDL_GetError());
+		running = 0;
+	}
+}
+
+void capture_frame(const uint8_t *frame, unsigned long number) {
+
+	int screenshot = config.take_screenshot;
+	capture *c;
+
+	if( !screenshot && config.dump_dir == NULL )
+		return;
+	config.take_screenshot = 0;
+
+	if( !running )
+		return;
+
+	/* Dropping a frame is better than stalling the emulation */
+	SDL_LockMutex(capture_lock);
+	if( pending == CAPTURE_QUEUE ) {
+		SDL_UnlockMutex(capture_lock);
+		COUNT(dropped_captures, 1);
+		if( screenshot )
+			fprintf(stderr,_("Too many frames being saved, screenshot discarded\n"));
 		return;
 	}
-	IMANES_CLOSE(fd);
+	c = queue + (head + pending) % CAPTURE_QUEUE;
+	SDL_UnlockMutex(capture_lock);
+
+	/* The writer doesn't touch slots that are not pending */
+	memcpy(c->pixels, frame + 8*NES_SCREEN_WIDTH, CAPTURE_SIZE);
+	c->frame = number;
+	c->screenshot = screenshot;
+
+	SDL_LockMutex(capture_lock);
+	pending++;
+	SDL_CondSignal(capture_ready);
+	SDL_UnlockMutex(capture_lock);
+}
+
+void end_capture() {
+
+	if( !running )
+		return;
 
-	INFO( printf(_("Saved screenshot at '%s'\n"), ss_file) );
+	/* Everything in the queue is still written */
+	SDL_LockMutex(capture_lock);
+	running = 0;
+	SDL_CondSignal(capture_ready);
+	SDL_UnlockMutex(capture_lock);
+	SDL_WaitThread(writer, NULL);
 
-	free(ss_file);
-	free(buffer);
+	SDL_DestroyCond(capture_ready);
+	SDL_DestroyMutex(capture_lock);
 }
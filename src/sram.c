@@ -21,25 +21,108 @@
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
+#ifdef _MSC_VER
+#include <Windows.h>
+#endif
+#include <SDL/SDL.h>
 
+#include "common.h"
 #include "cpu.h"
 #include "debug.h"
 #include "i18n.h"
+#include "imaconfig.h"
+#include "mapper.h"
 #include "platform.h"
 #include "sram.h"
 
+static char *save_file;  /* Where the SRAM is kept */
+static char *temp_file;  /* Written first, and then renamed to save_file */
 
-void save_sram(char *save_file) {
+/* Contents of the SRAM that are (or are being) saved */
+static uint8_t saved[SRAM_SIZE];
+
+/* Contents of the SRAM waiting to be written */
+static uint8_t flushing[SRAM_SIZE];
+static int pending;
+static int running;
+static unsigned int frames;
+
+static SDL_Thread *flusher;
+static SDL_mutex *sram_lock;
+static SDL_cond *sram_changed;
+
+/* Replaces the save file as a whole, so a crash in the middle
+ * leaves the previous one in place */
+static void write_sram(const uint8_t *sram) {
 
 	int fd;
 	RW_RET written_bytes;
 
-	if( !CPU->sram_enabled )
+	IMANES_OPEN(fd, temp_file, IMANES_OPEN_WRITE);
+
+	if( fd == -1 ) {
+		fprintf(stderr,_("Error while opening '%s': "), temp_file);
+		perror(NULL);
+		return;
+	}
+
+	written_bytes = IMANES_WRITE(fd, sram, SRAM_SIZE);
+	IMANES_CLOSE(fd);
+
+	if( written_bytes != SRAM_SIZE ) {
+		fprintf(stderr,_("Couldn't dump SRAM data to '%s': "), temp_file);
+		perror(NULL);
 		return;
+	}
+
+	if( IMANES_RENAME(temp_file, save_file) ) {
+		fprintf(stderr,_("Couldn't replace '%s': "), save_file);
+		perror(NULL);
+		return;
+	}
+
+	DEBUG( printf(_("SRAM saved to '%s'\n"), save_file) );
+}
+
+static int sram_thread(void *unused) {
+
+	SDL_LockMutex(sram_lock);
+	for(;;) {
+
+		while( running && !pending )
+			SDL_CondWait(sram_changed, sram_lock);
+		if( !pending )
+			break;
+
+		/* The buffer isn't touched again until we are done */
+		SDL_UnlockMutex(sram_lock);
+		write_sram(flushing);
+		SDL_LockMutex(sram_lock);
+		pending = 0;
+	}
+	SDL_UnlockMutex(sram_lock);
+
+	return 0;
+}
+
+/* Some boards keep the RAM elsewhere while mapping ROM on 0x6000 */
+static uint8_t *current_sram() {
 
-	INFO( printf(_("Saving SRAM... ")) );
-	IMANES_OPEN(fd,save_file, IMANES_OPEN_WRITE);
+	if( mapper->sram != NULL )
+		return mapper->sram();
+	return CPU->RAM + SRAM_START;
+}
+
+/* Reads the save file, if it exists */
+static void load_sram() {
+
+	int fd;
+	RW_RET read_bytes;
+
+	INFO( printf(_("Loading SRAM... ")) );
+	IMANES_OPEN(fd,save_file, IMANES_OPEN_READ);
 
 	if( fd == -1 ) {
 		fprintf(stderr,_("Error while opening '%s': "), save_file);
@@ -47,67 +130,109 @@ void save_sram(char *save_file) {
 		return;
 	}
 
-	written_bytes = IMANES_WRITE(fd, CPU->RAM + 0x6000, 0x2000);
+	read_bytes = IMANES_READ(fd, CPU->RAM + SRAM_START, SRAM_SIZE);
 
-	if( written_bytes != 0x2000 ) {
-		fprintf(stderr,_("Couldn't dump SRAM data to '%s': "), save_file);
-		perror(NULL);
+	if( read_bytes != SRAM_SIZE ) {
+		fprintf(stderr,_("File '%s' is not a valid SRAM dump file, SRAM not loaded.\n"), save_file);
+		memset(CPU->RAM + SRAM_START, 0, SRAM_SIZE);
 	}
 
 	IMANES_CLOSE(fd);
-	INFO( printf(_("done!\n")) );
 
-	return;
+	INFO( printf(_("done!\n")) );
 }
 
-char *load_sram(char *rom_file) {
+void initialize_sram(char *rom_file) {
 
-	int fd;
-	char *save_file;
 	char *save_dir;
 	char *tmp;
-	RW_RET read_bytes;
+	size_t size;
 
-	INFO( printf(_("Loading SRAM... ")) );
-	save_dir = get_imanes_dir(Saves);
+	/* Without battery there is nothing to load nor save, so
+	 * the saves directory isn't even needed */
+	if( !CPU->sram_enabled ) {
+		INFO( printf(_("SRAM disabled, not loading anything\n")) );
+		return;
+	}
 
+	save_dir = get_imanes_dir(Saves);
 	if( save_dir == NULL ) {
 		fprintf(stderr,_("Couldn't load SRAM because saves direcory cannot be accessed\n"));
-		free(save_dir);
-		return NULL;
+		return;
 	}
 
 	/* Get just the name of the file */
 	tmp = get_filename(rom_file);
 
-	save_file = (char *)malloc(strlen(save_dir) + strlen(tmp) + 6);
-	imanes_sprintf(save_file, strlen(save_dir) + strlen(tmp)+6, "%s%c%s.sav", save_dir, DIR_SEP, tmp);
+	size = strlen(save_dir) + strlen(tmp) + 10;
+	save_file = (char *)malloc(size);
+	temp_file = (char *)malloc(size);
+	imanes_sprintf(save_file, (int)size, "%s%c%s.sav", save_dir, DIR_SEP, tmp);
+	imanes_sprintf(temp_file, (int)size, "%s%c%s.sav.tmp", save_dir, DIR_SEP, tmp);
 	free(tmp);
 	free(save_dir);
 
-	/* If SRAM is not enabled, just return the name of the file */
-	if( !CPU->sram_enabled ) {
-		INFO( printf(_("SRAM disabled, not loading anything\n")) );
-		return save_file;
+	load_sram();
+	memcpy(saved, current_sram(), SRAM_SIZE);
+
+	sram_lock    = SDL_CreateMutex();
+	sram_changed = SDL_CreateCond();
+	running = 1;
+
+	flusher = SDL_CreateThread(sram_thread, NULL);
+	if( flusher == NULL ) {
+		fprintf(stderr,_("Couldn't start the SRAM thread, it will be saved only at exit: %s\n"), SDL_GetError());
+		running = 0;
 	}
+}
 
-	IMANES_OPEN(fd,save_file, IMANES_OPEN_READ);
+void check_sram() {
 
-	if( fd == -1 ) {
-		fprintf(stderr,_("Error while opening '%s': "), save_file);
-		perror(NULL);
-		return save_file;
+	if( !running || ++frames < SRAM_FLUSH_FRAMES )
+		return;
+
+	/* Nothing written since the last time is the usual case */
+	if( !memcmp(saved, current_sram(), SRAM_SIZE) ) {
+		frames = 0;
+		return;
 	}
 
-	read_bytes = IMANES_READ(fd, CPU->RAM + 0x6000, 0x2000);
+	/* Try again in the next frame if the last one is still being written */
+	SDL_LockMutex(sram_lock);
+	if( !pending ) {
+		memcpy(saved, current_sram(), SRAM_SIZE);
+		memcpy(flushing, saved, SRAM_SIZE);
+		pending = 1;
+		frames = 0;
+		SDL_CondSignal(sram_changed);
+	}
+	SDL_UnlockMutex(sram_lock);
+}
 
-	if( read_bytes != 0x2000 ) {
-		fprintf(stderr,_("File '%s' is not a valid SRAM dump file, SRAM not loaded.\n"), save_file);
-		memset(CPU->RAM + 0x6000, 0, 0x2000);
+void end_sram() {
+
+	if( save_file == NULL )
+		return;
+
+	if( running ) {
+		SDL_LockMutex(sram_lock);
+		running = 0;
+		SDL_CondSignal(sram_changed);
+		SDL_UnlockMutex(sram_lock);
+		SDL_WaitThread(flusher, NULL);
 	}
 
-	IMANES_CLOSE(fd);
+	if( memcmp(saved, current_sram(), SRAM_SIZE) ) {
+		INFO( printf(_("Saving SRAM... ")) );
+		write_sram(current_sram());
+		INFO( printf(_("done!\n")) );
+	}
 
-	INFO( printf(_("done!\n")) );
-	return save_file;
+	if( sram_lock != NULL ) {
+		SDL_DestroyCond(sram_changed);
+		SDL_DestroyMutex(sram_lock);
+	}
+	free(save_file);
+	free(temp_file);
+	save_file = NULL;
 }
@@ -22,9 +22,15 @@
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
+#ifdef _MSC_VER
+#include <Windows.h>
+#endif
+#include <SDL/SDL.h>
 
 #include "clock.h"
+#include "common.h"
 #include "cpu.h"
 #include "debug.h"
 #include "i18n.h"
@@ -33,155 +39,350 @@
 #include "platform.h"
 #include "ppu.h"
 #include "states.h"
+#include "translator.h"
+
+/* A state kept in memory */
+typedef struct _cached_state {
+	int slot;        /* -1 if the entry is free */
+	uint64_t used;   /* When it was last saved or loaded */
+	uint8_t *data;
+} cached_state;
+
+/* A state waiting to be compressed and written */
+typedef struct _state_job {
+	int slot;
+	uint8_t *data;
+} state_job;
+
+static unsigned int state_size;
+
+/* Size of version 1 states, and what they lack, taken from the
+ * power on values */
+static unsigned int v1_state_size;
+static uint8_t v1_sram_enabled;
+static uint8_t *v1_mapper_state;
+static uint64_t uses;
+
+/* Only touched by the emulation thread, or with the lock held
+ * while the writer is prefetching */
+static cached_state cache[STATE_CACHE_SIZE];
+
+static state_job queue[STATE_QUEUE];
+static int head;
+static int pending;
+static int running;
+
+static SDL_Thread *writer;
+static SDL_mutex *states_lock;
+static SDL_cond *state_saved;
+
+/* Only used by the writer, or by the emulation thread when it isn't running */
+static uint8_t *compressed;
+static uint8_t *prefetch;
+
+/* Only used by the emulation thread, to read the slots that aren't cached */
+static uint8_t *load_compressed;
+static uint8_t *loaded;
+
+/* Longest compression of a state */
+#define COMPRESSED_SIZE(size)  (STATE_HEADER + (size) + (size)/128 + 1)
+
+/* Name of the file of a state slot */
+static char *state_file(const char *ss_dir, int slot, const char *extension) {
+
+	size_t size;
+	char *tmp;
+	char *ss_file;
 
-static void *state;
-static int last_save = -1;
+	tmp = get_filename(config.rom_file);
+	size = strlen(ss_dir) + strlen(tmp) + strlen(extension) + 8;
+	ss_file = (char *)malloc(size);
+	imanes_sprintf(ss_file, (int)size, "%s%c%s-%02d.%s", ss_dir, DIR_SEP, tmp, slot, extension);
+	free(tmp);
 
-void load_state(int i) {
+	return ss_file;
+}
+
+static void put_le32(uint8_t *out, uint32_t value) {
+
+	int i;
+
+	for(i=0; i!=4; i++)
+		out[i] = (uint8_t)(value >> (8*i));
+}
+
+static uint32_t get_le32(const uint8_t *in) {
+	return in[0] | in[1] << 8 | in[2] << 16 | (uint32_t)in[3] << 24;
+}
+
+/* Runs and literals of up to 128 bytes, each one after a control byte:
+ * 0x80|(length-1) for runs, followed by the repeated byte, and length-1
+ * for literals, followed by the bytes themselves */
+static size_t compress_state(uint8_t *out, const uint8_t *in, size_t size) {
+
+	size_t pos = 0;
+	size_t i = 0, len;
+
+	while( i < size ) {
+
+		len = 1;
+		while( i+len < size && len < 128 && in[i+len] == in[i] )
+			len++;
+		if( len >= 3 ) {
+			out[pos++] = (uint8_t)(0x80 | (len-1));
+			out[pos++] = in[i];
+			i += len;
+			continue;
+		}
+
+		/* Until a run that pays its own control byte */
+		len = 1;
+		while( i+len < size && len < 128 &&
+		       !(i+len+2 < size && in[i+len] == in[i+len+1] && in[i+len] == in[i+len+2]) )
+			len++;
+		out[pos++] = (uint8_t)(len-1);
+		memcpy(out + pos, in + i, len);
+		pos += len;
+		i += len;
+	}
+
+	return pos;
+}
+
+/* Returns 0 if the compressed data has exactly 'size' bytes */
+static int decompress_state(uint8_t *out, size_t size, const uint8_t *in, size_t in_size) {
+
+	size_t pos = 0;
+	size_t i = 0, len;
+
+	while( i < in_size ) {
+		len = (in[i] & 0x7F) + 1;
+		if( pos + len > size )
+			return -1;
+
+		if( in[i] & 0x80 ) {
+			if( i+1 >= in_size )
+				return -1;
+			memset(out + pos, in[i+1], len);
+			i += 2;
+		}
+		else {
+			if( i+1+len > in_size )
+				return -1;
+			memcpy(out + pos, in + i + 1, len);
+			i += 1 + len;
+		}
+		pos += len;
+	}
+
+	return pos == size ? 0 : -1;
+}
+
+/* Compresses a state and replaces its file, so a crash in the middle
+ * leaves the previous one in place */
+static void write_state(int slot, const uint8_t *state) {
 
 	int fd;
+	size_t size;
 	char *ss_dir;
 	char *ss_file;
-	char *tmp;
-	char *buffer;
-	unsigned int total_size;
-	RW_RET read_bytes;
+	char *temp_file;
+	RW_RET written;
 
-	/* This is the total size of the state */
-	total_size = 
-	/* CPU registers*/  7 +
-	/* RAM dump */      0x0800 + 0xBFDF +
-	/* PPU registers */ 12 + 3*sizeof(int) +
-	/* VRAM dump */     0x4000 +
-	/* SPR-RAM dump */  0x100 +
-	/* CLK */           sizeof(int) + sizeof(long) +
-	/* Mapper */        1 + sizeof(int) + mapper->reg_count;
+	ss_dir = get_imanes_dir(States);
+	if( ss_dir == NULL ) {
+		fprintf(stderr,_("Couldn't save state: cannot reach states dir\n"));
+		return;
+	}
+	ss_file   = state_file(ss_dir, slot, "sta");
+	temp_file = state_file(ss_dir, slot, "sta.tmp");
+	free(ss_dir);
 
-	/* If we are loading the last state that we saved,
-	 * we don't need to go and read the state file */
-	if( last_save == config.current_state )
-		buffer = state;
-	else {
-		/* Read the state from the corresponding file */
-		ss_dir = get_imanes_dir(States);
-		tmp = get_filename(config.rom_file);
-		ss_file = (char *)malloc(strlen(ss_dir) + strlen(tmp) + 2 + 7);
-		imanes_sprintf(ss_file,strlen(ss_dir)+strlen(tmp)+2+7,"%s%c%s-%02d.sta", ss_dir, DIR_SEP, tmp, config.current_state);
+	memcpy(compressed, STATE_MAGIC, STATE_MAGIC_SIZE);
+	put_le32(compressed + STATE_MAGIC_SIZE, state_size);
+	size = STATE_HEADER + compress_state(compressed + STATE_HEADER, state, state_size);
 
-		IMANES_OPEN(fd, ss_file, IMANES_OPEN_READ);
-		free(ss_dir);
-		free(tmp);
+	IMANES_OPEN(fd, temp_file, IMANES_OPEN_WRITE);
+	if( fd == -1 ) {
+		fprintf(stderr,_("Error while opening '%s': "), temp_file);
+		perror(NULL);
+	}
+	else {
+		written = IMANES_WRITE(fd, compressed, (unsigned int)size);
+		IMANES_CLOSE(fd);
 
-		if( fd == -1 && errno == ENOENT) {
-			fprintf(stderr,_("Cannot load state %d because it doesn't exist\n"), config.current_state);
-			free(ss_file);
-			return;
-		}
-		else if( fd == -1 ) {
-			fprintf(stderr,_("Error while opening '%s': "), ss_file);
+		if( written != (RW_RET)size )
+			perror(_("Error while saving state to file"));
+		else if( IMANES_RENAME(temp_file, ss_file) ) {
+			fprintf(stderr,_("Couldn't replace '%s': "), ss_file);
 			perror(NULL);
-			free(ss_file);
-			return;
 		}
-		buffer = (char *)malloc(total_size);
-		read_bytes = IMANES_READ(fd, buffer, total_size);
-		IMANES_CLOSE(fd);
+		else
+			DEBUG( printf(_("State %d written to '%s' (%lu bytes)\n"), slot, ss_file, (unsigned long)size) );
+	}
 
-		if( read_bytes != total_size ) {
-			fprintf(stderr,_("File '%s' is not a valid state file\n"), ss_file);
-			free(ss_file);
-			return;
+	free(temp_file);
+	free(ss_file);
+}
+
+/* Turns a version 1 state into the current layout, in place. The CPU
+ * registers are followed by the IRQ lines and the SRAM enable, and the
+ * mapper registers by the internal mapper state */
+static void upgrade_v1_state(uint8_t *state) {
+
+	memmove(state + 9, state + 7, v1_state_size - 7);
+	state[7] = 0;
+	state[8] = v1_sram_enabled;
+	memcpy(state + v1_state_size + 2, v1_mapper_state + mapper->reg_count,
+	       mapper_state_size() - mapper->reg_count);
+}
+
+/* Reads the state file of a slot, using data as the buffer for the file
+ * contents. States from older versions were saved without compression.
+ * Returns 0 if it was read */
+static int read_state(const char *ss_dir, int slot, uint8_t *state, uint8_t *data, int verbose) {
+
+	int fd;
+	char *ss_file;
+	RW_RET read_bytes;
+	int error = 0;
+
+	ss_file = state_file(ss_dir, slot, "sta");
+	IMANES_OPEN(fd, ss_file, IMANES_OPEN_READ);
+
+	if( fd == -1 ) {
+		if( verbose && errno == ENOENT )
+			fprintf(stderr,_("Cannot load state %d because it doesn't exist\n"), slot);
+		else if( verbose ) {
+			fprintf(stderr,_("Error while opening '%s': "), ss_file);
+			perror(NULL);
 		}
 		free(ss_file);
+		return -1;
 	}
 
-	/* CPU dumping */
-	memcpy(&(CPU->A),      buffer, 1); buffer++;
-	memcpy(&(CPU->X),      buffer, 1); buffer++;
-	memcpy(&(CPU->Y),      buffer, 1); buffer++;
-	memcpy(&(CPU->SP),     buffer, 1); buffer++;
-	memcpy(&(CPU->SR),     buffer, 1); buffer++;
-	memcpy(&(CPU->PC),     buffer, 2); buffer += 2;
+	read_bytes = IMANES_READ(fd, data, COMPRESSED_SIZE(state_size));
+	IMANES_CLOSE(fd);
 
-	/* RAM dumping */
-	memcpy(CPU->RAM, buffer, 0x0800);
-	buffer += 0x0800;
-	memcpy(CPU->RAM + 0x4020, buffer, 0xBFDF);
-	buffer += 0xBFDF;
+	if( read_bytes > STATE_HEADER && !memcmp(data, STATE_MAGIC, STATE_MAGIC_SIZE) ) {
+		error = get_le32(data + STATE_MAGIC_SIZE) != state_size ||
+		        decompress_state(state, state_size, data + STATE_HEADER, read_bytes - STATE_HEADER);
+	}
+	else if( read_bytes > STATE_HEADER && !memcmp(data, STATE_MAGIC_V1, STATE_MAGIC_SIZE) ) {
+		error = get_le32(data + STATE_MAGIC_SIZE) != v1_state_size ||
+		        decompress_state(state, v1_state_size, data + STATE_HEADER, read_bytes - STATE_HEADER);
+		if( !error )
+			upgrade_v1_state(state);
+	}
+	else if( read_bytes == (RW_RET)v1_state_size ) {
+		memcpy(state, data, v1_state_size);
+		upgrade_v1_state(state);
+	}
+	else
+		error = 1;
 
-	/* PPU dumping */
-	memcpy(&(PPU->CR1), buffer, 1);       buffer++;
-	memcpy(&(PPU->CR2), buffer, 1);       buffer++;
-	memcpy(&(PPU->SR), buffer, 1);        buffer++;
-	memcpy(&(PPU->mirroring), buffer, 1); buffer++;
-	memcpy(&(PPU->x), buffer, 1);         buffer++;
-	memcpy(&(PPU->latch), buffer, 1);     buffer++;
-	memcpy(&(PPU->vram_addr), buffer, 2); buffer += 2;
-	memcpy(&(PPU->temp_addr), buffer, 2); buffer += 2;
-	memcpy(&(PPU->spr_addr), buffer, 2);  buffer += 2;
-	memcpy(&(PPU->scanline_timeout), buffer, sizeof(int));
-	buffer += sizeof(int);
-	memcpy(&(PPU->lines), buffer, sizeof(int));
-	buffer += sizeof(int);
-	memcpy(&(PPU->frames), buffer, sizeof(int));
-	buffer += sizeof(int);
+	if( error && verbose )
+		fprintf(stderr,_("File '%s' is not a valid state file\n"), ss_file);
 
-	/* VRAM dumping */
-	memcpy(PPU->VRAM, buffer, 0x4000);
-	buffer += 0x4000;
+	free(ss_file);
+	return error ? -1 : 0;
+}
 
-	/* SPR-RAM dumping */
-	memcpy(PPU->SPR_RAM, buffer, 0x100);
-	buffer += 0x100;
+/* Returns the cache entry of a slot, or NULL */
+static cached_state *find_cached(int slot) {
 
-	/* CLK dumping */
-	memcpy(&(CLK->ppu_cycles), buffer, sizeof(long));
-	buffer += sizeof(long);
-	memcpy(&(CLK->nmi_pcycles), buffer, sizeof(int));
-	buffer += sizeof(int);
+	int i;
 
-	/* Mapper dumping */
-	memcpy(&(mapper->id), buffer, 1);  buffer++;
-	memcpy(&(mapper->reg_count), buffer, sizeof(int));
-	buffer += sizeof(int);
-	memcpy(mapper->regs, buffer, mapper->reg_count);
+	for(i=0; i!=STATE_CACHE_SIZE; i++)
+		if( cache[i].slot == slot )
+			return cache + i;
+	return NULL;
+}
 
-	mapper->reset();
-	mapper->switch_banks();
+/* Returns the entry where a slot should be cached: its own one, a free
+ * one, or the least recently used */
+static cached_state *cache_entry(int slot) {
 
-	INFO( printf(_("Loaded state %d\n"), config.current_state) );
+	int i;
+	cached_state *entry;
 
-	return;
+	entry = find_cached(slot);
+	if( entry != NULL )
+		return entry;
+
+	entry = cache;
+	for(i=0; i!=STATE_CACHE_SIZE; i++) {
+		if( cache[i].slot == -1 )
+			return cache + i;
+		if( cache[i].used < entry->used )
+			entry = cache + i;
+	}
+	return entry;
 }
 
-void save_state(int i) {
+/* Reads all the slots of the ROM in advance, so they are loaded at once */
+static void prefetch_states() {
 
-	int fd;
+	int slot;
 	char *ss_dir;
-	char *ss_file;
-	char *tmp;
-	char *buffer;
-	unsigned int total_size;
-	RW_RET written;
+	cached_state *entry;
 
-	ss_dir = get_imanes_dir(States);
-	if( ss_dir == NULL ) {
-		fprintf(stderr,_("Couldn't save state: cannot reach states dir\n"));
+	ss_dir = imanes_dir_name(States);
+	if( ss_dir == NULL )
 		return;
+
+	for(slot=0; slot!=STATE_SLOTS && running; slot++) {
+
+		if( read_state(ss_dir, slot, prefetch, compressed, 0) )
+			continue;
+
+		/* Saved or loaded in the meanwhile, then it's newer */
+		SDL_LockMutex(states_lock);
+		if( find_cached(slot) == NULL ) {
+			entry = cache_entry(slot);
+			if( entry->slot == -1 ) {
+				memcpy(entry->data, prefetch, state_size);
+				entry->slot = slot;
+				INFO( printf(_("State %d ready\n"), slot) );
+			}
+		}
+		SDL_UnlockMutex(states_lock);
 	}
 
-	/* This is the total size of the state */
-	total_size = 
-	/* CPU registers*/  7 +
-	/* RAM dump */      0x0800 + 0xBFDF +
-	/* PPU registers */ 12 + 3*sizeof(int) +
-	/* VRAM dump */     0x4000 +
-	/* SPR-RAM dump */  0x100 +
-	/* CLK */           sizeof(int) + sizeof(long) +
-	/* Mapper */        1 + sizeof(int) + mapper->reg_count;
+	free(ss_dir);
+}
+
+static int states_thread(void *unused) {
+
+	state_job *job;
+
+	prefetch_states();
 
-	/* Memory allocation for state information */
-	buffer = (char *)malloc(total_size);
+	SDL_LockMutex(states_lock);
+	for(;;) {
+
+		while( running && !pending )
+			SDL_CondWait(state_saved, states_lock);
+		if( !pending )
+			break;
+
+		/* The job is ours until we release it */
+		job = queue + head;
+		SDL_UnlockMutex(states_lock);
+
+		write_state(job->slot, job->data);
+
+		SDL_LockMutex(states_lock);
+		head = (head + 1) % STATE_QUEUE;
+		pending--;
+	}
+	SDL_UnlockMutex(states_lock);
+
+	return 0;
+}
+
+/* Dumps the emulation state into a buffer of state_size bytes */
+static void serialize_state(uint8_t *buffer) {
 
 	/* CPU dumping */
 	memcpy(buffer, &(CPU->A),  1); buffer++;
@@ -190,6 +391,8 @@ void save_state(int i) {
 	memcpy(buffer, &(CPU->SP), 1); buffer++;
 	memcpy(buffer, &(CPU->SR), 1); buffer++;
 	memcpy(buffer, &(CPU->PC), 2); buffer += 2;
+	memcpy(buffer, &(CPU->irq), 1); buffer++;
+	memcpy(buffer, &(CPU->sram_enabled), 1); buffer++;
 
 	/* RAM dumping */
 	/* We only need to dump the following sections:
@@ -239,37 +442,229 @@ void save_state(int i) {
 	memcpy(buffer, &(mapper->id), 1);  buffer++;
 	memcpy(buffer, &(mapper->reg_count), sizeof(int));
 	buffer += sizeof(int);
-	memcpy(buffer, mapper->regs, mapper->reg_count);
-	buffer += mapper->reg_count;
+	save_mapper_state(buffer);
+}
 
-	/* Get the pointer back to where it should be */
-	buffer -= total_size;
+/* Sets the emulation state from a buffer of state_size bytes */
+static void restore_state(const uint8_t *buffer) {
 
-	/* Finally, save it into a file */
-	tmp = get_filename(config.rom_file);
-	ss_file = (char *)malloc(strlen(ss_dir) + strlen(tmp) + 2 + 7);
-	imanes_sprintf(ss_file,strlen(ss_dir)+strlen(tmp)+2+7,"%s%c%s-%02d.sta", ss_dir, DIR_SEP, tmp, config.current_state);
+	/* CPU dumping */
+	memcpy(&(CPU->A),      buffer, 1); buffer++;
+	memcpy(&(CPU->X),      buffer, 1); buffer++;
+	memcpy(&(CPU->Y),      buffer, 1); buffer++;
+	memcpy(&(CPU->SP),     buffer, 1); buffer++;
+	memcpy(&(CPU->SR),     buffer, 1); buffer++;
+	memcpy(&(CPU->PC),     buffer, 2); buffer += 2;
+	memcpy(&(CPU->irq),    buffer, 1); buffer++;
+	memcpy(&(CPU->sram_enabled), buffer, 1); buffer++;
 
-	IMANES_OPEN(fd,ss_file, IMANES_OPEN_WRITE);
-	free(ss_dir);
-	free(tmp);
-	free(ss_file);
+	/* RAM dumping */
+	memcpy(CPU->RAM, buffer, 0x0800);
+	buffer += 0x0800;
+	memcpy(CPU->RAM + 0x4020, buffer, 0xBFDF);
+	buffer += 0xBFDF;
 
-	written = IMANES_WRITE(fd, (void *)buffer, total_size);
+	/* PPU dumping */
+	memcpy(&(PPU->CR1), buffer, 1);       buffer++;
+	memcpy(&(PPU->CR2), buffer, 1);       buffer++;
+	memcpy(&(PPU->SR), buffer, 1);        buffer++;
+	memcpy(&(PPU->mirroring), buffer, 1); buffer++;
+	memcpy(&(PPU->x), buffer, 1);         buffer++;
+	memcpy(&(PPU->latch), buffer, 1);     buffer++;
+	memcpy(&(PPU->vram_addr), buffer, 2); buffer += 2;
+	memcpy(&(PPU->temp_addr), buffer, 2); buffer += 2;
+	memcpy(&(PPU->spr_addr), buffer, 2);  buffer += 2;
+	memcpy(&(PPU->scanline_timeout), buffer, sizeof(int));
+	buffer += sizeof(int);
+	memcpy(&(PPU->lines), buffer, sizeof(int));
+	buffer += sizeof(int);
+	memcpy(&(PPU->frames), buffer, sizeof(int));
+	buffer += sizeof(int);
 
-	if( written != total_size )
-		perror(_("Error while saving state to file"));
+	/* VRAM dumping */
+	memcpy(PPU->VRAM, buffer, 0x4000);
+	invalidate_chr_cache(0x0000, 0x2000);
+	buffer += 0x4000;
 
-	IMANES_CLOSE(fd);
+	/* SPR-RAM dumping */
+	memcpy(PPU->SPR_RAM, buffer, 0x100);
+	buffer += 0x100;
 
-	/* Copy the state into the a buffer, so we don't need to
-	 * read the state file if we want to load the last saved state */
-	state = realloc(state, total_size);
-	memcpy(state, buffer, total_size);
-	last_save = config.current_state;
+	/* CLK dumping */
+	memcpy(&(CLK->ppu_cycles), buffer, sizeof(long));
+	buffer += sizeof(long);
+	memcpy(&(CLK->nmi_pcycles), buffer, sizeof(int));
+	buffer += sizeof(int);
+
+	/* Mapper dumping */
+	memcpy(&(mapper->id), buffer, 1);  buffer++;
+	memcpy(&(mapper->reg_count), buffer, sizeof(int));
+	buffer += sizeof(int);
+	load_mapper_state(buffer);
 
-	free(buffer);
-	INFO( printf(_("Saved state %d\n"), config.current_state) );
+	reset_prg_map();
+	invalidate_decoded(0x0000, NES_RAM_SIZE);
+	mapper->reset();
+	mapper->switch_banks();
+}
+
+void initialize_states() {
+
+	int i;
+
+	/* This is the total size of the state */
+	state_size =
+	/* CPU registers*/  9 +
+	/* RAM dump */      0x0800 + 0xBFDF +
+	/* PPU registers */ 12 + 3*sizeof(int) +
+	/* VRAM dump */     0x4000 +
+	/* SPR-RAM dump */  0x100 +
+	/* CLK */           sizeof(int) + sizeof(long) +
+	/* Mapper */        1 + sizeof(int) + mapper_state_size();
+
+	v1_state_size = state_size - 2 - (mapper_state_size() - mapper->reg_count);
+	v1_sram_enabled = CPU->sram_enabled;
+	v1_mapper_state = (uint8_t *)malloc(mapper_state_size());
+	save_mapper_state(v1_mapper_state);
+
+	/* Everything is allocated now, so saving is just copying */
+	for(i=0; i!=STATE_CACHE_SIZE; i++) {
+		cache[i].slot = -1;
+		cache[i].data = (uint8_t *)malloc(state_size);
+	}
+	for(i=0; i!=STATE_QUEUE; i++)
+		queue[i].data = (uint8_t *)malloc(state_size);
+	compressed = (uint8_t *)malloc(COMPRESSED_SIZE(state_size));
+	prefetch   = (uint8_t *)malloc(state_size);
+	load_compressed = (uint8_t *)malloc(COMPRESSED_SIZE(state_size));
+	loaded          = (uint8_t *)malloc(state_size);
+
+	states_lock = SDL_CreateMutex();
+	state_saved = SDL_CreateCond();
+	running = 1;
+
+	writer = SDL_CreateThread(states_thread, NULL);
+	if( writer == NULL ) {
+		fprintf(stderr,_("Couldn't start the states thread, they will be saved in the foreground: %s\n"), SDL_GetError());
+		running = 0;
+	}
+}
+
+void save_state(int i) {
+
+	cached_state *entry;
+	state_job *job;
+
+	/* The writer may be prefetching into the cache */
+	if( running )
+		SDL_LockMutex(states_lock);
+	entry = cache_entry(i);
+	serialize_state(entry->data);
+	entry->slot = i;
+	entry->used = ++uses;
+
+	if( !running ) {
+		write_state(i, entry->data);
+		INFO( printf(_("Saved state %d\n"), i) );
+		return;
+	}
+
+	/* Only when saving faster than the disk can keep up */
+	while( pending == STATE_QUEUE ) {
+		SDL_UnlockMutex(states_lock);
+		SDL_Delay(1);
+		SDL_LockMutex(states_lock);
+	}
+
+	/* The writer doesn't touch jobs that are not pending */
+	job = queue + (head + pending) % STATE_QUEUE;
+	SDL_UnlockMutex(states_lock);
+	memcpy(job->data, entry->data, state_size);
+	job->slot = i;
+
+	SDL_LockMutex(states_lock);
+	pending++;
+	SDL_CondSignal(state_saved);
+	SDL_UnlockMutex(states_lock);
+
+	INFO( printf(_("Saved state %d\n"), i) );
+}
+
+void load_state(int i) {
+
+	int j;
+	char *ss_dir;
+	cached_state *entry;
+
+	if( running )
+		SDL_LockMutex(states_lock);
+
+	entry = find_cached(i);
+
+	/* Evicted before being written, the newest job has it */
+	if( entry == NULL && running ) {
+		for(j=pending-1; j>=0 && entry == NULL; j--) {
+			if( queue[(head + j) % STATE_QUEUE].slot == i ) {
+				entry = cache_entry(i);
+				memcpy(entry->data, queue[(head + j) % STATE_QUEUE].data, state_size);
+			}
+		}
+	}
+
+	/* Not in memory, so it has to be read. The writer keeps its own
+	 * buffers, and has no pending job for this slot */
+	if( entry == NULL ) {
+		if( running )
+			SDL_UnlockMutex(states_lock);
+
+		ss_dir = imanes_dir_name(States);
+		if( ss_dir == NULL || read_state(ss_dir, i, loaded, load_compressed, 1) ) {
+			free(ss_dir);
+			return;
+		}
+		free(ss_dir);
+
+		if( running )
+			SDL_LockMutex(states_lock);
+		entry = cache_entry(i);
+		memcpy(entry->data, loaded, state_size);
+	}
+
+	entry->slot = i;
+	entry->used = ++uses;
+	restore_state(entry->data);
+
+	if( running )
+		SDL_UnlockMutex(states_lock);
+
+	INFO( printf(_("Loaded state %d\n"), i) );
+}
+
+void end_states() {
+
+	int i;
+
+	/* Everything in the queue is still written */
+	if( running ) {
+		SDL_LockMutex(states_lock);
+		running = 0;
+		SDL_CondSignal(state_saved);
+		SDL_UnlockMutex(states_lock);
+		SDL_WaitThread(writer, NULL);
+	}
+
+	if( states_lock != NULL ) {
+		SDL_DestroyCond(state_saved);
+		SDL_DestroyMutex(states_lock);
+	}
 
-	return;
+	for(i=0; i!=STATE_CACHE_SIZE; i++)
+		free(cache[i].data);
+	for(i=0; i!=STATE_QUEUE; i++)
+		free(queue[i].data);
+	free(compressed);
+	free(prefetch);
+	free(load_compressed);
+	free(loaded);
+	free(v1_mapper_state);
 }
@@ -0,0 +1,222 @@
+/*  ImaNES: I'm a NES. An intelligent NES emulator
+
+    telemetry.c   -    Performance counters and telemetry
+
+    Copyright (C) 2009   Rodrigo Tobar Carrizo
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef _MSC_VER
+#include <Windows.h>
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "debug.h"
+#include "i18n.h"
+#include "platform.h"
+#include "telemetry.h"
+
+/* NTSC frames per second */
+#define NES_FPS  (60.0988)
+
+/* Longest line of the report */
+#define REPORT_SIZE  (512)
+
+nes_counters counters;
+int telemetry = 0;
+
+static FILE *report_file;
+#ifndef _MSC_VER
+static int report_socket = -1;
+static struct sockaddr_un report_address;
+#endif
+
+static telemetry_timer current_timer;
+static uint64_t timer_start;
+static uint64_t last_report;
+static uint64_t last_frames;
+static uint64_t startup;
+
+int initialize_telemetry(char *destination) {
+
+	size_t prefix = strlen(TELEMETRY_UNIX_PREFIX);
+
+	if( !strncmp(destination, TELEMETRY_UNIX_PREFIX, prefix) ) {
+#ifdef _MSC_VER
+		fprintf(stderr,_("Telemetry to Unix sockets is not supported in this platform\n"));
+		return -1;
+#else
+		if( strlen(destination + prefix) >= sizeof(report_address.sun_path) ) {
+			fprintf(stderr,_("Telemetry socket path is too long: '%s'\n"), destination + prefix);
+			return -1;
+		}
+		report_socket = socket(AF_UNIX, SOCK_DGRAM, 0);
+		if( report_socket == -1 ) {
+			perror(_("Error while creating telemetry socket"));
+			return -1;
+		}
+		memset(&report_address, 0, sizeof(report_address));
+		report_address.sun_family = AF_UNIX;
+		strcpy(report_address.sun_path, destination + prefix);
+#endif
+	}
+	else {
+		report_file = fopen(destination, "a");
+		if( report_file == NULL ) {
+			fprintf(stderr,_("Error while opening telemetry file '%s': "), destination);
+			perror(NULL);
+			return -1;
+		}
+	}
+
+	current_timer = CPUTime;
+	timer_start   = telemetry_now();
+	last_report   = timer_start;
+	last_frames   = counters.frames;
+	telemetry = 1;
+
+	return 0;
+}
+
+void telemetry_startup() {
+	startup = telemetry_now();
+}
+
+void telemetry_first_frame() {
+	counters.first_frame_time = telemetry_now() - startup;
+	INFO( printf(_("First frame shown %llu us after starting\n"), (unsigned long long)counters.first_frame_time) );
+}
+
+uint64_t telemetry_now() {
+
+#ifdef _MSC_VER
+	static LARGE_INTEGER freq;
+	LARGE_INTEGER now;
+
+	if( !freq.QuadPart )
+		QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&now);
+	return (uint64_t)(now.QuadPart * 1000000.0 / freq.QuadPart);
+#else
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec*1000000 + now.tv_nsec/1000;
+#endif
+}
+
+void telemetry_timer_switch(telemetry_timer timer) {
+
+	uint64_t now = telemetry_now();
+
+	counters.time[current_timer] += now - timer_start;
+	current_timer = timer;
+	timer_start = now;
+}
+
+/* Writes the counters as a line of the line protocol:
+ * <measurement> <field>=<value>[,<field>=<value>...] <timestamp> */
+static void report(uint64_t now) {
+
+	int len;
+	char line[REPORT_SIZE];
+	double speed;
+
+	speed = (counters.frames - last_frames) / (NES_FPS * (now - last_report) / 1e6);
+
+	len = imanes_sprintf(line, REPORT_SIZE,
+	    "imanes frames=%llui,rendered_frames=%llui,presented_frames=%llui,"
+	    "dropped_frames=%llui,dropped_captures=%llui,late_frames=%llui,"
+	    "instructions=%llui,bank_switches=%llui,vram_accesses=%llui,"
+	    "audio_underruns=%llui,sleep_overshoot_us=%llui,"
+	    "cpu_us=%llui,ppu_us=%llui,host_us=%llui,sleep_us=%llui,present_us=%llui,"
+	    "first_frame_us=%llui,"
+	    "speed=%.3f %llu\n",
+	    (unsigned long long)counters.frames,
+	    (unsigned long long)counters.rendered_frames,
+	    (unsigned long long)counters.presented_frames,
+	    (unsigned long long)counters.dropped_frames,
+	    (unsigned long long)counters.dropped_captures,
+	    (unsigned long long)counters.late_frames,
+	    (unsigned long long)counters.instructions,
+	    (unsigned long long)counters.bank_switches,
+	    (unsigned long long)counters.vram_accesses,
+	    (unsigned long long)counters.audio_underruns,
+	    (unsigned long long)counters.sleep_overshoot,
+	    (unsigned long long)counters.time[CPUTime],
+	    (unsigned long long)counters.time[PPUTime],
+	    (unsigned long long)counters.time[HostTime],
+	    (unsigned long long)counters.time[SleepTime],
+	    (unsigned long long)counters.present_time,
+	    (unsigned long long)counters.first_frame_time,
+	    speed, (unsigned long long)time(NULL) * 1000000000ULL);
+
+	if( len <= 0 || len >= REPORT_SIZE )
+		return;
+
+	if( report_file != NULL ) {
+		fputs(line, report_file);
+		fflush(report_file);
+	}
+#ifndef _MSC_VER
+	/* Nobody may be listening, reports are just lost then */
+	else if( report_socket != -1 )
+		sendto(report_socket, line, len, MSG_DONTWAIT,
+		       (struct sockaddr *)&report_address, sizeof(report_address));
+#endif
+}
+
+void telemetry_frame(int rendered) {
+
+	uint64_t now;
+
+	counters.frames++;
+	if( rendered )
+		counters.rendered_frames++;
+
+	if( !telemetry )
+		return;
+
+	now = telemetry_now();
+	if( now - last_report >= TELEMETRY_PERIOD*1000000 ) {
+		report(now);
+		last_report = now;
+		last_frames = counters.frames;
+	}
+}
+
+void end_telemetry() {
+
+	if( !telemetry )
+		return;
+
+	TELEMETRY_TIMER(CPUTime);
+	report(telemetry_now());
+	telemetry = 0;
+
+	if( report_file != NULL )
+		fclose(report_file);
+#ifndef _MSC_VER
+	if( report_socket != -1 )
+		close(report_socket);
+#endif
+}
@@ -0,0 +1,146 @@
+/*  ImaNES: I'm a NES. An intelligent NES emulator
+
+    trace.c   -    Binary instruction trace recorder
+
+    Copyright (C) 2009   Rodrigo Tobar Carrizo
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _MSC_VER
+#include <sys/mman.h>
+#endif
+
+#include "clock.h"
+#include "cpu.h"
+#include "i18n.h"
+#include "instruction_set.h"
+#include "platform.h"
+#include "ppu.h"
+#include "trace.h"
+
+int tracing = 0;
+
+static trace_header *header;
+static trace_record *ring;
+static size_t trace_size;
+
+#ifdef _MSC_VER
+/* Without mmap() the trace is kept in memory and written at the end */
+static char *trace_file;
+#endif
+
+int initialize_trace(char *file) {
+
+	int i;
+#ifndef _MSC_VER
+	int fd;
+#endif
+
+	trace_size = TRACE_HEADER_SIZE + sizeof(trace_record)*TRACE_RECORDS;
+
+#ifdef _MSC_VER
+	header = (trace_header *)malloc(trace_size);
+	if( header == NULL ) {
+		fprintf(stderr,_("Error while allocating the trace buffer\n"));
+		return -1;
+	}
+	trace_file = file;
+#else
+	IMANES_OPEN(fd, file, IMANES_OPEN_WRITE);
+	if( fd == -1 ) {
+		fprintf(stderr,_("Error while opening trace file '%s': "), file);
+		perror(NULL);
+		return -1;
+	}
+	if( ftruncate(fd, trace_size) == -1 ) {
+		fprintf(stderr,_("Error while resizing trace file '%s': "), file);
+		perror(NULL);
+		IMANES_CLOSE(fd);
+		return -1;
+	}
+
+	header = (trace_header *)mmap(NULL, trace_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	IMANES_CLOSE(fd);
+	if( header == MAP_FAILED ) {
+		fprintf(stderr,_("Error while mapping trace file '%s': "), file);
+		perror(NULL);
+		return -1;
+	}
+#endif
+
+	memset(header, 0, TRACE_HEADER_SIZE);
+	memcpy(header->magic, TRACE_MAGIC, 8);
+	header->version     = TRACE_VERSION;
+	header->record_size = sizeof(trace_record);
+	header->capacity    = TRACE_RECORDS;
+	for(i=0;i!=OPCODES_NUMBER;i++) {
+		memcpy(header->opcodes[i].name, instructions[i].name, 4);
+		header->opcodes[i].addr_mode = instructions[i].addr_mode;
+		header->opcodes[i].size      = instructions[i].size;
+	}
+
+	ring = (trace_record *)((uint8_t *)header + TRACE_HEADER_SIZE);
+	tracing = 1;
+
+	return 0;
+}
+
+void trace_instruction() {
+
+	trace_record *r = &ring[header->next];
+
+	r->cycle       = CLK->ppu_cycles/3;
+	r->frame       = PPU->frames;
+	r->scanline    = (int16_t)PPU->lines;
+	r->PC          = CPU->PC;
+	r->opcode      = CPU->RAM[CPU->PC];
+	r->operands[0] = CPU->RAM[(uint16_t)(CPU->PC+1)];
+	r->operands[1] = CPU->RAM[(uint16_t)(CPU->PC+2)];
+	r->A           = CPU->A;
+	r->X           = CPU->X;
+	r->Y           = CPU->Y;
+	r->SR          = CPU->SR;
+	r->SP          = CPU->SP;
+
+	header->next = (header->next + 1) & (TRACE_RECORDS - 1);
+	header->total++;
+}
+
+void end_trace() {
+
+#ifdef _MSC_VER
+	int fd;
+#endif
+
+	if( !tracing )
+		return;
+	tracing = 0;
+
+#ifdef _MSC_VER
+	IMANES_OPEN(fd, trace_file, IMANES_OPEN_WRITE);
+	if( fd == -1 || IMANES_WRITE(fd, header, trace_size) != trace_size )
+		fprintf(stderr,_("Error while writing trace file '%s'\n"), trace_file);
+	if( fd != -1 )
+		IMANES_CLOSE(fd);
+	free(header);
+#else
+	msync(header, trace_size, MS_SYNC);
+	munmap(header, trace_size);
+#endif
+
+}
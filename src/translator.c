@@ -0,0 +1,764 @@
+/*  ImaNES: I'm a NES. An intelligent NES emulator
+
+    translator.c   -    PRG-ROM to x86-64 block translator for ImaNES
+
+    Copyright (C) 2009   Rodrigo Tobar Carrizo
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "clock.h"
+#include "cpu.h"
+#include "debug.h"
+#include "i18n.h"
+#include "imaconfig.h"
+#include "instruction_set.h"
+#include "telemetry.h"
+#include "translator.h"
+
+/* Native code is generated for x86-64 hosts using the System V calling
+ * convention. Everywhere else, the interpreter runs all the code */
+#if defined(__x86_64__) && !defined(_WIN32)
+#define NATIVE_BLOCKS
+#include <sys/mman.h>
+#endif
+
+/* PRG-ROM offset mapped at each page, -1 if unknown */
+static long prg_map[PRG_PAGES];
+
+static const uint8_t *prg_rom;
+static unsigned long prg_size;
+
+#ifdef NATIVE_BLOCKS
+
+/* Special values of the block index */
+#define NOT_TRANSLATED     (0x0000)
+#define NOT_TRANSLATABLE   (0xFFFF)
+
+/* Room for the native code of all the blocks, and the most that a single
+ * block can take. Blocks are flushed when there's no room for another */
+#define CODE_BUFFER_SIZE   (4*1024*1024)
+#define BLOCK_MAX_CODE     (BLOCK_MAX_INSTS*160 + 64)
+
+/**
+ * A straight-line sequence of PRG-ROM instructions translated into x86-64
+ * code. It doesn't touch I/O registers, it only ends in a control flow
+ * instruction and it takes at most max_cycles CPU cycles. The native code
+ * leaves the CPU registers and PC as the interpreter would, and returns the
+ * cycles added by page crossings and taken branches. Its CPU addresses are
+ * built into the code, so it's only valid where it was translated
+ */
+typedef struct _block {
+	uint16_t address;
+	uint8_t length;
+	uint8_t base_cycles;
+	uint8_t max_cycles;
+	uint8_t *code;
+} block;
+
+/* Signature of the native code of the blocks */
+typedef int (*native_code)(nes_cpu *cpu);
+
+/* Translated blocks, and the block that starts at each PRG-ROM offset */
+static block *blocks;
+static int used_blocks;
+static uint16_t *block_index;
+
+/* Native code buffer */
+static uint8_t *code_buffer;
+static unsigned long code_used;
+
+/* Operand given to the instructions that are run through their handler */
+static operand block_oper;
+
+/* Offsets of the CPU registers, addressed from rbx */
+#define REG(r)  ((uint8_t)offsetof(nes_cpu, r))
+
+/* x86-64 condition codes for jcc (0x70+cc) and setcc (0x0F 0x90+cc) */
+#define CC_O   (0x0)
+#define CC_NO  (0x1)
+#define CC_B   (0x2)
+#define CC_AE  (0x3)
+#define CC_Z   (0x4)
+#define CC_NZ  (0x5)
+
+#endif /* NATIVE_BLOCKS */
+
+void initialize_translator(ines_file *file) {
+
+	prg_rom  = file->rom;
+	prg_size = (unsigned long)file->romBanks16k * ROM_BANK_SIZE;
+	reset_prg_map();
+
+	if( !config.translate_blocks )
+		return;
+
+#ifdef NATIVE_BLOCKS
+	code_buffer = (uint8_t *)mmap(NULL, CODE_BUFFER_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+	                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if( code_buffer == MAP_FAILED ) {
+		code_buffer = NULL;
+		fprintf(stderr,_("Cannot allocate memory for translated code, blocks will be interpreted\n"));
+		config.translate_blocks = 0;
+		return;
+	}
+	code_used = 0;
+
+	blocks = (block *)malloc(sizeof(block) * MAX_BLOCKS);
+	block_index = (uint16_t *)malloc(sizeof(uint16_t) * prg_size);
+	memset(block_index, 0, sizeof(uint16_t) * prg_size);
+	used_blocks = 0;
+#else
+	fprintf(stderr,_("Block translation is only available on x86-64, blocks will be interpreted\n"));
+	config.translate_blocks = 0;
+#endif
+}
+
+void map_prg_pages(uint16_t address, const uint8_t *prg, unsigned int size) {
+
+	unsigned int i;
+
+	invalidate_decoded(address, size);
+
+	for(i=0; i < size; i += PRG_PAGE_SIZE) {
+
+		if( address + i < 0x8000 )
+			continue;
+
+		if( prg_rom != NULL && prg_rom <= prg + i && prg + i < prg_rom + prg_size )
+			prg_map[(address + i - 0x8000)/PRG_PAGE_SIZE] = (long)(prg + i - prg_rom);
+		else
+			prg_map[(address + i - 0x8000)/PRG_PAGE_SIZE] = -1;
+	}
+
+}
+
+long prg_offset(uint16_t address) {
+
+	long page;
+
+	if( address < 0x8000 )
+		return -1;
+
+	page = prg_map[(address - 0x8000)/PRG_PAGE_SIZE];
+	return page < 0 ? -1 : page + (address % PRG_PAGE_SIZE);
+}
+
+void reset_prg_map() {
+
+	int i;
+
+	for(i=0;i!=PRG_PAGES;i++)
+		prg_map[i] = -1;
+
+}
+
+#ifdef NATIVE_BLOCKS
+
+/* Returns whether an instruction only reads its memory operand */
+static int read_only(uint8_t instr_id) {
+
+	switch( instr_id ) {
+		case ADC: case AND: case BIT: case CMP: case CPX: case CPY:
+		case EOR: case LAX: case LDA: case LDX: case LDY: case NOP:
+		case ORA: case SBC:
+			return 1;
+		default:
+			return 0;
+	}
+
+}
+
+/* Returns whether an instruction ends a block. CLI and PLP may unmask
+ * a pending IRQ, which must be serviced right after them */
+static int ends_block(uint8_t instr_id) {
+
+	switch( instr_id ) {
+		case BCC: case BCS: case BEQ: case BMI: case BNE: case BPL:
+		case BVC: case BVS: case JMP: case JSR: case RTI: case RTS:
+		case CLI: case PLP:
+			return 1;
+		default:
+			return 0;
+	}
+
+}
+
+/* Checks that the instruction at the given address can be part of a
+ * block, and decodes it. Memory accesses must fall in the internal RAM,
+ * or be reads from PRG-ROM */
+static int translate_inst(uint16_t address, decoded_inst *t) {
+
+	uint16_t first;
+	uint16_t last;
+	const instruction *inst;
+
+	decode_instruction(address, t);
+	inst = t->inst;
+
+	/* Instructions with side effects on the interrupts, or with an
+	 * address that can't be known in advance are left for the interpreter */
+	if( inst->size == 0 || inst->instr_id == BRK ||
+	    inst->addr_mode == ADDR_INDIRECT ||
+	    inst->addr_mode == ADDR_IND_INDIR ||
+	    inst->addr_mode == ADDR_INDIR_IND )
+		return 0;
+
+	/* Don't cross to a page that might be mapped elsewhere */
+	if( (address & (PRG_PAGE_SIZE-1)) + inst->size > PRG_PAGE_SIZE )
+		return 0;
+
+	switch( inst->addr_mode ) {
+
+		case ADDR_IMMEDIATE:
+		case ADDR_RELATIVE:
+		case ADDR_IMPLIED:
+		case ADDR_ACCUM:
+		case ADDR_ZEROPAGE:
+		case ADDR_ZERO_INDX:
+		case ADDR_ZERO_INDY:
+			return 1;
+
+		case ADDR_ABSOLUTE:
+			first = last = t->oper.address;
+
+			/* The operand is the jump target, not a memory access */
+			if( inst->instr_id == JMP || inst->instr_id == JSR )
+				return 1;
+			break;
+
+		case ADDR_ABS_INDX:
+		case ADDR_ABS_INDY:
+			first = CPU->RAM[address+1] | (CPU->RAM[address+2] << 8);
+			last  = first + 0xFF;
+			if( last < first )
+				return 0;
+			break;
+
+		default:
+			return 0;
+	}
+
+	if( last < 0x2000 )
+		return 1;
+	if( first >= 0x8000 && read_only(inst->instr_id) )
+		return 1;
+
+	return 0;
+}
+
+/***************************/
+/* x86-64 code generation  */
+/***************************/
+
+static void emit8(uint8_t b) {
+	code_buffer[code_used++] = b;
+}
+
+static void emit16(uint16_t w) {
+	emit8(w & 0xFF);
+	emit8(w >> 8);
+}
+
+static void emit32(uint32_t d) {
+	emit16(d & 0xFFFF);
+	emit16(d >> 16);
+}
+
+static void emit64(uint64_t q) {
+	emit32(q & 0xFFFFFFFF);
+	emit32(q >> 32);
+}
+
+/* movzx eax, byte [rbx+reg] */
+static void emit_load(uint8_t reg) {
+	emit8(0x0F); emit8(0xB6); emit8(0x43); emit8(reg);
+}
+
+/* mov [rbx+reg], al */
+static void emit_store(uint8_t reg) {
+	emit8(0x88); emit8(0x43); emit8(reg);
+}
+
+/* and byte [rbx+SR], ~flags */
+static void emit_clear_flags(uint8_t flags) {
+	emit8(0x80); emit8(0x63); emit8(REG(SR)); emit8((uint8_t)~flags);
+}
+
+/* or byte [rbx+SR], flags */
+static void emit_set_flags(uint8_t flags) {
+	emit8(0x80); emit8(0x4B); emit8(REG(SR)); emit8(flags);
+}
+
+/* Sets the given flags of SR to the bits held in cl */
+static void emit_flags_from_cl(uint8_t flags) {
+	emit_clear_flags(flags);
+	emit8(0x08); emit8(0x4B); emit8(REG(SR));  /* or [rbx+SR], cl */
+}
+
+/* Updates the N and Z flags from al, like update_flags() */
+static void emit_nz() {
+	emit_clear_flags(N_FLAG | Z_FLAG);
+	emit8(0x84); emit8(0xC0);                  /* test al, al */
+	emit8(0x70 + CC_NZ); emit8(4);
+	emit_set_flags(Z_FLAG);
+	emit8(0x84); emit8(0xC0);                  /* test al, al */
+	emit8(0x79); emit8(4);                     /* jns */
+	emit_set_flags(N_FLAG);
+}
+
+/* Loads C into the host carry flag, using edx */
+static void emit_carry_in() {
+	emit8(0x0F); emit8(0xB6); emit8(0x53); emit8(REG(SR)); /* movzx edx, byte [rbx+SR] */
+	emit8(0xD1); emit8(0xEA);                              /* shr edx, 1 */
+}
+
+/* setcc cl */
+static void emit_setcc_cl(uint8_t cc) {
+	emit8(0x0F); emit8(0x90 + cc); emit8(0xC1);
+}
+
+/* Computes the effective address of the operand into ecx, or its
+ * value into dl for immediate operands. Page crossings that add a cycle
+ * are counted in r13d */
+static void emit_operand(decoded_inst *t, uint16_t address) {
+
+	const instruction *inst = t->inst;
+	uint16_t base;
+
+	switch( inst->addr_mode ) {
+
+		case ADDR_IMMEDIATE:
+			emit8(0xB2); emit8(t->oper.value);           /* mov dl, imm8 */
+			break;
+
+		case ADDR_ZEROPAGE:
+		case ADDR_ABSOLUTE:
+			base = t->oper.address;
+			if( base < 0x2000 )
+				base &= 0x7FF;
+			emit8(0xB9); emit32(base);                   /* mov ecx, imm32 */
+			break;
+
+		case ADDR_ZERO_INDX:
+		case ADDR_ZERO_INDY:
+			emit8(0x0F); emit8(0xB6); emit8(0x4B);       /* movzx ecx, byte [rbx+X/Y] */
+			emit8(inst->addr_mode == ADDR_ZERO_INDX ? REG(X) : REG(Y));
+			emit8(0x80); emit8(0xC1); emit8(CPU->RAM[address+1]); /* add cl, imm8 */
+			break;
+
+		case ADDR_ABS_INDX:
+		case ADDR_ABS_INDY:
+			base = CPU->RAM[address+1] | (CPU->RAM[address+2] << 8);
+			emit8(0x0F); emit8(0xB6); emit8(0x4B);       /* movzx ecx, byte [rbx+X/Y] */
+			emit8(inst->addr_mode == ADDR_ABS_INDX ? REG(X) : REG(Y));
+			emit8(0x81); emit8(0xC1); emit32(base);      /* add ecx, imm32 */
+			if( inst->cycle_change == CYCLE_PAGE ) {
+				emit8(0x89); emit8(0xC8);                /* mov eax, ecx */
+				emit8(0x35); emit32(base);               /* xor eax, imm32 */
+				emit8(0xF6); emit8(0xC4); emit8(0x01);   /* test ah, 1 */
+				emit8(0x70 + CC_Z); emit8(3);
+				emit8(0x41); emit8(0xFF); emit8(0xC5);   /* inc r13d */
+			}
+			if( base < 0x2000 ) {
+				emit8(0x81); emit8(0xE1); emit32(0x7FF); /* and ecx, 0x7FF */
+			}
+			break;
+	}
+
+}
+
+/* movzx edx, byte [r12+rcx], unless the operand is immediate */
+static void emit_read_operand(const instruction *inst) {
+	if( inst->addr_mode != ADDR_IMMEDIATE ) {
+		emit8(0x41); emit8(0x0F); emit8(0xB6); emit8(0x14); emit8(0x0C);
+	}
+}
+
+/* Loads the value to modify into al: A or memory */
+static void emit_load_modified(const instruction *inst) {
+	if( inst->addr_mode == ADDR_ACCUM )
+		emit_load(REG(A));
+	else {
+		emit8(0x41); emit8(0x0F); emit8(0xB6); emit8(0x04); emit8(0x0C); /* movzx eax, byte [r12+rcx] */
+	}
+}
+
+/* Stores al back into A or memory. Like _write_ram, writes to memory
+ * invalidate the instructions decoded from their page, using r8 and r9 */
+static void emit_store_modified(const instruction *inst) {
+	if( inst->addr_mode == ADDR_ACCUM )
+		emit_store(REG(A));
+	else {
+		emit8(0x41); emit8(0x88); emit8(0x04); emit8(0x0C);              /* mov [r12+rcx], al */
+		emit8(0x41); emit8(0x89); emit8(0xC8);                           /* mov r8d, ecx */
+		emit8(0x41); emit8(0xC1); emit8(0xE8); emit8(8);                 /* shr r8d, 8 */
+		emit8(0x49); emit8(0xB9); emit64((uint64_t)(uintptr_t)decoded_page_gen); /* mov r9, decoded_page_gen */
+		emit8(0x4B); emit8(0xFF); emit8(0x04); emit8(0xC1);              /* inc qword [r9+r8*8] */
+	}
+}
+
+/* Calls the instruction handler, for the instructions that are not
+ * generated inline. PC must be right, since handlers use it */
+static void emit_handler_call(decoded_inst *t, uint16_t address) {
+
+	emit8(0x66); emit8(0xC7); emit8(0x43); emit8(REG(PC)); emit16(address); /* mov word [rbx+PC], imm16 */
+
+	emit8(0x48); emit8(0xBF); emit64((uint64_t)(uintptr_t)t->inst);        /* mov rdi, inst */
+	emit8(0x48); emit8(0xBE); emit64((uint64_t)(uintptr_t)&block_oper);    /* mov rsi, &block_oper */
+	if( t->dynamic ) {
+		emit8(0x48); emit8(0xB8); emit64((uint64_t)(uintptr_t)&get_operand);
+		emit8(0xFF); emit8(0xD0);                                          /* call rax */
+		emit8(0x48); emit8(0xBF); emit64((uint64_t)(uintptr_t)t->inst);
+		emit8(0x48); emit8(0xBE); emit64((uint64_t)(uintptr_t)&block_oper);
+	}
+	else {
+		emit8(0x66); emit8(0xC7); emit8(0x46);                             /* mov word [rsi+address], imm16 */
+		emit8((uint8_t)offsetof(operand, address)); emit16(t->oper.address);
+		emit8(0xC6); emit8(0x46);                                          /* mov byte [rsi+value], imm8 */
+		emit8((uint8_t)offsetof(operand, value)); emit8(t->oper.value);
+	}
+	emit8(0x48); emit8(0xB8); emit64((uint64_t)(uintptr_t)t->handler);
+	emit8(0xFF); emit8(0xD0);                                              /* call rax */
+
+	/* Handlers of control flow instructions leave PC before the increment */
+	if( ends_block(t->inst->instr_id) ) {
+		emit8(0x66); emit8(0x83); emit8(0x43); emit8(REG(PC)); emit8((uint8_t)t->inst->size); /* add word [rbx+PC], imm8 */
+	}
+}
+
+/* Generates a conditional branch, which always ends the block */
+static void emit_branch(decoded_inst *t, uint16_t address) {
+
+	uint8_t flag;
+	uint8_t taken_if_set;
+	uint16_t target;
+
+	switch( t->inst->instr_id ) {
+		case BCC: flag = C_FLAG; taken_if_set = 0; break;
+		case BCS: flag = C_FLAG; taken_if_set = 1; break;
+		case BNE: flag = Z_FLAG; taken_if_set = 0; break;
+		case BEQ: flag = Z_FLAG; taken_if_set = 1; break;
+		case BVC: flag = V_FLAG; taken_if_set = 0; break;
+		case BVS: flag = V_FLAG; taken_if_set = 1; break;
+		case BPL: flag = N_FLAG; taken_if_set = 0; break;
+		default:  flag = N_FLAG; taken_if_set = 1; break;
+	}
+	target = address + 2 + (int8_t)t->oper.value;
+
+	emit8(0xF6); emit8(0x43); emit8(REG(SR)); emit8(flag);  /* test byte [rbx+SR], flag */
+	emit8(0x70 + (taken_if_set ? CC_Z : CC_NZ)); emit8(12);
+
+	/* Taken: one more cycle, or two if the target is in another page */
+	emit8(0x66); emit8(0xC7); emit8(0x43); emit8(REG(PC)); emit16(target);
+	emit8(0x41); emit8(0x83); emit8(0xC5);                  /* add r13d, imm8 */
+	emit8( ((address+2)&0x100) == (target&0x100) ? 1 : 2 );
+	emit8(0xEB); emit8(6);                                  /* jmp */
+
+	emit8(0x66); emit8(0xC7); emit8(0x43); emit8(REG(PC)); emit16(address + 2);
+}
+
+/* Generates the code of an instruction. Returns 1 if it set PC */
+static int emit_instruction(decoded_inst *t, uint16_t address) {
+
+	const instruction *inst = t->inst;
+
+	switch( inst->instr_id ) {
+
+		case LDA: case LDX: case LDY:
+			emit_operand(t, address);
+			emit_read_operand(inst);
+			emit8(0x89); emit8(0xD0);                        /* mov eax, edx */
+			emit_store(inst->instr_id == LDA ? REG(A) : inst->instr_id == LDX ? REG(X) : REG(Y));
+			emit_nz();
+			return 0;
+
+		case STA: case STX: case STY:
+			emit_operand(t, address);
+			emit_load(inst->instr_id == STA ? REG(A) : inst->instr_id == STX ? REG(X) : REG(Y));
+			emit_store_modified(inst);
+			return 0;
+
+		case AND: case ORA: case EOR:
+			emit_operand(t, address);
+			emit_read_operand(inst);
+			emit_load(REG(A));
+			emit8(inst->instr_id == AND ? 0x20 : inst->instr_id == ORA ? 0x08 : 0x30);
+			emit8(0xD0);                                     /* and/or/xor al, dl */
+			emit_store(REG(A));
+			emit_nz();
+			return 0;
+
+		case ADC: case SBC:
+			emit_operand(t, address);
+			emit_read_operand(inst);
+			emit8(0x0F); emit8(0xB6); emit8(0x73); emit8(REG(SR)); /* movzx esi, byte [rbx+SR] */
+			emit8(0xD1); emit8(0xEE);                        /* shr esi, 1 */
+			emit_load(REG(A));
+			if( inst->instr_id == ADC ) {
+				emit8(0x10); emit8(0xD0);                    /* adc al, dl */
+				emit_setcc_cl(CC_B);
+			}
+			else {
+				emit8(0xF5);                                 /* cmc */
+				emit8(0x18); emit8(0xD0);                    /* sbb al, dl */
+				emit_setcc_cl(CC_AE);
+			}
+			emit8(0x0F); emit8(0x90 + CC_O); emit8(0xC2);    /* seto dl */
+			emit_store(REG(A));
+			emit8(0xC0); emit8(0xE2); emit8(6);              /* shl dl, 6 */
+			emit8(0x08); emit8(0xD1);                        /* or cl, dl */
+			emit_flags_from_cl(C_FLAG | V_FLAG);
+			emit_nz();
+			return 0;
+
+		case CMP: case CPX: case CPY:
+			emit_operand(t, address);
+			emit_read_operand(inst);
+			emit_load(inst->instr_id == CMP ? REG(A) : inst->instr_id == CPX ? REG(X) : REG(Y));
+			emit8(0x38); emit8(0xD0);                        /* cmp al, dl */
+			emit_setcc_cl(CC_AE);
+			emit8(0x28); emit8(0xD0);                        /* sub al, dl */
+			emit_flags_from_cl(C_FLAG);
+			emit_nz();
+			return 0;
+
+		case BIT:
+			emit_operand(t, address);
+			emit_read_operand(inst);
+			emit_clear_flags(N_FLAG | V_FLAG | Z_FLAG);
+			emit8(0x89); emit8(0xD0);                        /* mov eax, edx */
+			emit8(0x24); emit8(N_FLAG | V_FLAG);             /* and al, 0xC0 */
+			emit8(0x08); emit8(0x43); emit8(REG(SR));        /* or [rbx+SR], al */
+			emit_load(REG(A));
+			emit8(0x84); emit8(0xD0);                        /* test al, dl */
+			emit8(0x70 + CC_NZ); emit8(4);
+			emit_set_flags(Z_FLAG);
+			return 0;
+
+		case INC: case DEC:
+			emit_operand(t, address);
+			emit_load_modified(inst);
+			emit8(0xFE); emit8(inst->instr_id == INC ? 0xC0 : 0xC8); /* inc/dec al */
+			emit_store_modified(inst);
+			emit_nz();
+			return 0;
+
+		case ASL: case LSR: case ROL: case ROR:
+			emit_operand(t, address);
+			if( inst->instr_id == ROL || inst->instr_id == ROR )
+				emit_carry_in();
+			emit_load_modified(inst);
+			emit8(0xD0);                                     /* shl/shr/rcl/rcr al, 1 */
+			switch( inst->instr_id ) {
+				case ASL: emit8(0xE0); break;
+				case LSR: emit8(0xE8); break;
+				case ROL: emit8(0xD0); break;
+				default:  emit8(0xD8); break;
+			}
+			emit8(0x0F); emit8(0x90 + CC_B); emit8(0xC2);    /* setc dl */
+			emit_store_modified(inst);
+			emit8(0x88); emit8(0xD1);                        /* mov cl, dl */
+			emit_flags_from_cl(C_FLAG);
+			emit_nz();
+			return 0;
+
+		case INX: case INY: case DEX: case DEY:
+			emit_load(inst->instr_id == INX || inst->instr_id == DEX ? REG(X) : REG(Y));
+			emit8(0xFE); emit8(inst->instr_id == INX || inst->instr_id == INY ? 0xC0 : 0xC8);
+			emit_store(inst->instr_id == INX || inst->instr_id == DEX ? REG(X) : REG(Y));
+			emit_nz();
+			return 0;
+
+		case TAX: case TAY: case TXA: case TYA: case TSX:
+			switch( inst->instr_id ) {
+				case TAX: emit_load(REG(A));  emit_store(REG(X)); break;
+				case TAY: emit_load(REG(A));  emit_store(REG(Y)); break;
+				case TXA: emit_load(REG(X));  emit_store(REG(A)); break;
+				case TYA: emit_load(REG(Y));  emit_store(REG(A)); break;
+				default:  emit_load(REG(SP)); emit_store(REG(X)); break;
+			}
+			emit_nz();
+			return 0;
+
+		case TXS:
+			emit_load(REG(X));
+			emit_store(REG(SP));
+			return 0;
+
+		case CLC: emit_clear_flags(C_FLAG); return 0;
+		case SEC: emit_set_flags(C_FLAG);   return 0;
+		case CLD: emit_clear_flags(D_FLAG); return 0;
+		case SED: emit_set_flags(D_FLAG);   return 0;
+		case CLV: emit_clear_flags(V_FLAG); return 0;
+		case SEI: emit_set_flags(I_FLAG);   return 0;
+
+		/* Only their page crossing cycle matters */
+		case NOP:
+			if( inst->addr_mode == ADDR_ABS_INDX )
+				emit_operand(t, address);
+			return 0;
+
+		case BCC: case BCS: case BEQ: case BMI:
+		case BNE: case BPL: case BVC: case BVS:
+			emit_branch(t, address);
+			return 1;
+
+		case JMP:
+			emit8(0x66); emit8(0xC7); emit8(0x43); emit8(REG(PC)); emit16(t->oper.address);
+			return 1;
+
+		/* Stack, interrupt and undocumented instructions */
+		default:
+			emit_handler_call(t, address);
+			return ends_block(inst->instr_id);
+	}
+
+}
+
+/* Translates the block that starts at the current PC into native code.
+ * Returns its index, or NOT_TRANSLATABLE if the first instruction can't
+ * be translated */
+static uint16_t translate_block() {
+
+	uint16_t address = CPU->PC;
+	int pc_set = 0;
+	block *b;
+	decoded_inst t;
+
+	/* Out of room, start from scratch */
+	if( used_blocks == MAX_BLOCKS || code_used + BLOCK_MAX_CODE > CODE_BUFFER_SIZE ) {
+		INFO( printf(_("Translated blocks exhausted, flushing them\n")) );
+		memset(block_index, 0, sizeof(uint16_t) * prg_size);
+		used_blocks = 0;
+		code_used = 0;
+	}
+
+	b = &blocks[used_blocks];
+	b->address = address;
+	b->length = 0;
+	b->base_cycles = 0;
+	b->max_cycles = 0;
+	b->code = code_buffer + code_used;
+
+	/* Prologue: rbx holds the CPU, r12 its memory and r13d the extra cycles */
+	emit8(0x53);                                   /* push rbx */
+	emit8(0x41); emit8(0x54);                      /* push r12 */
+	emit8(0x41); emit8(0x55);                      /* push r13 */
+	emit8(0x48); emit8(0x89); emit8(0xFB);         /* mov rbx, rdi */
+	emit8(0x4C); emit8(0x8B); emit8(0x63); emit8(REG(RAM)); /* mov r12, [rbx+RAM] */
+	emit8(0x45); emit8(0x31); emit8(0xED);         /* xor r13d, r13d */
+
+	while( b->length != BLOCK_MAX_INSTS ) {
+
+		if( !translate_inst(address, &t) )
+			break;
+
+		b->length++;
+		b->base_cycles += t.inst->cycles;
+		b->max_cycles += t.inst->cycles;
+		if( t.inst->cycle_change == CYCLE_PAGE )
+			b->max_cycles += 1;
+		else if( t.inst->cycle_change == CYCLE_BRANCH )
+			b->max_cycles += 2;
+
+		pc_set = emit_instruction(&t, address);
+		address += t.inst->size;
+
+		if( ends_block(t.inst->instr_id) )
+			break;
+		if( !(address & (PRG_PAGE_SIZE-1)) )
+			break;
+	}
+
+	if( b->length == 0 ) {
+		code_used = b->code - code_buffer;
+		return NOT_TRANSLATABLE;
+	}
+
+	/* Epilogue: leave PC after the last instruction, return the extra cycles */
+	if( !pc_set ) {
+		emit8(0x66); emit8(0xC7); emit8(0x43); emit8(REG(PC)); emit16(address);
+	}
+	emit8(0x44); emit8(0x89); emit8(0xE8);         /* mov eax, r13d */
+	emit8(0x41); emit8(0x5D);                      /* pop r13 */
+	emit8(0x41); emit8(0x5C);                      /* pop r12 */
+	emit8(0x5B);                                   /* pop rbx */
+	emit8(0xC3);                                   /* ret */
+
+	DEBUG( printf(_("Translated block #%d at %04x: %d instructions, up to %d cycles, %lu bytes\n"),
+	       used_blocks, CPU->PC, b->length, b->max_cycles,
+	       (unsigned long)(code_buffer + code_used - b->code)) );
+	return ++used_blocks;
+}
+
+#endif /* NATIVE_BLOCKS */
+
+int execute_block(int budget) {
+
+#ifdef NATIVE_BLOCKS
+	long offset;
+	int extra_cycles;
+	block *b;
+	native_code run;
+
+	if( CPU->PC < 0x8000 )
+		return 0;
+
+	offset = prg_map[(CPU->PC - 0x8000)/PRG_PAGE_SIZE];
+	if( offset < 0 )
+		return 0;
+	offset += CPU->PC & (PRG_PAGE_SIZE-1);
+
+	/* The same PRG-ROM can be mapped at more than one CPU address */
+	if( block_index[offset] == NOT_TRANSLATED ||
+	    (block_index[offset] != NOT_TRANSLATABLE &&
+	     blocks[block_index[offset] - 1].address != CPU->PC) )
+		block_index[offset] = translate_block();
+	if( block_index[offset] == NOT_TRANSLATABLE )
+		return 0;
+
+	b = &blocks[block_index[offset] - 1];
+	if( b->max_cycles > budget )
+		return 0;
+
+	/* ISO C has no cast from data to function pointers */
+	memcpy(&run, &b->code, sizeof(run));
+	extra_cycles = run(CPU);
+	ADD_CPU_CYCLES(b->base_cycles + extra_cycles);
+	COUNT(instructions, b->length);
+
+	return b->base_cycles;
+#else
+	return 0;
+#endif
+}
+
+void end_translator() {
+
+#ifdef NATIVE_BLOCKS
+	if( code_buffer != NULL )
+		munmap(code_buffer, CODE_BUFFER_SIZE);
+	if( blocks != NULL )
+		free(blocks);
+	if( block_index != NULL )
+		free(block_index);
+#endif
+
+}
@@ -32,12 +32,12 @@ void unrom_initialize_mapper() {
 	return;
 }
 
-int unrom_check_address(uint16_t address) {
+int unrom_check_address(uint16_t address, uint8_t value) {
 
 	/* It is not necessary to check <= 0xFFFF because of the data range
 	 * of a uint16_t :) */
 	if( 0x8000 <= address ) {
-		mapper->regs[0] = CPU->RAM[address];
+		mapper->regs[0] = value;
 		return 1;
 	}
 
@@ -48,17 +48,17 @@ void unrom_switch_banks()
 {
 
 	DEBUG( printf(_("Performing bank switching: Switching to bank %d of ROM\n"),mapper->regs[0]) );
-	memcpy(CPU->RAM+0x8000, mapper->file->rom + mapper->regs[0]*ROM_BANK_SIZE,
-	       ROM_BANK_SIZE);
+	SWAP_RAM(0x8000, mapper->file->rom + mapper->regs[0]*ROM_BANK_SIZE,
+	         ROM_BANK_SIZE);
 }
 
 void unrom_reset()
 {
 
-	memcpy(CPU->RAM+0x8000, mapper->file->rom, ROM_BANK_SIZE);
-	memcpy(CPU->RAM+0xC000,
-	       mapper->file->rom + (mapper->file->romBanks16k-1)*ROM_BANK_SIZE,
-	       ROM_BANK_SIZE);
+	SWAP_RAM(0x8000, mapper->file->rom, ROM_BANK_SIZE);
+	SWAP_RAM(0xC000,
+	         mapper->file->rom + (mapper->file->romBanks16k-1)*ROM_BANK_SIZE,
+	         ROM_BANK_SIZE);
 
 }
 
@@ -0,0 +1,373 @@
+/*  ImaNES: I'm a NES. An intelligent NES emulator
+
+    vrc6.c   -    Konami VRC6 Mapper emulation under ImaNES
+
+    Copyright (C) 2009   Rodrigo Tobar Carrizo
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apu.h"
+#include "cpu.h"
+#include "debug.h"
+#include "i18n.h"
+#include "mapper.h"
+#include "playback.h"
+#include "ppu.h"
+#include "vrc6.h"
+
+/* VRC6 pulse channels */
+typedef struct _vrc6_pulse {
+	uint16_t period;
+	uint8_t  volume;
+	uint8_t  duty;
+	uint8_t  mode;
+	uint8_t  enabled;
+	uint8_t  step;
+	int      timeout;
+} vrc6_pulse;
+
+/* VRC6 sawtooth channel */
+typedef struct _vrc6_saw {
+	uint16_t period;
+	uint8_t  rate;
+	uint8_t  enabled;
+	uint8_t  accumulator;
+	uint8_t  step;
+	int      timeout;
+} vrc6_saw;
+
+/* Mapper #26 has the A0 and A1 lines swapped */
+static int swapped_lines;
+
+static int audio_halted;
+static vrc6_pulse pulses[2];
+static vrc6_saw saw;
+static uint8_t last_sample;
+
+/* VRC IRQ counter, shared with the VRC7 */
+static uint8_t irq_latch;
+static uint8_t irq_counter;
+static uint8_t irq_control;
+static int irq_prescaler;
+
+const mapper_state vrc_irq_state[VRC_IRQ_STATES] = {
+	MAPPER_STATE(irq_latch),
+	MAPPER_STATE(irq_counter),
+	MAPPER_STATE(irq_control),
+	MAPPER_STATE(irq_prescaler)
+};
+
+static const mapper_state vrc6_state[] = {
+	MAPPER_STATE(audio_halted),
+	MAPPER_STATE(pulses),
+	MAPPER_STATE(saw),
+	MAPPER_STATE(last_sample),
+	MAPPER_STATE(irq_latch),
+	MAPPER_STATE(irq_counter),
+	MAPPER_STATE(irq_control),
+	MAPPER_STATE(irq_prescaler)
+};
+
+void vrc6_initialize_mapper() {
+
+	/* 0: 16kb PRG, 1: 8kb PRG, 2: mirroring, 3-10: CHR banks */
+	mapper->regs = (uint8_t *)malloc(11);
+	memset(mapper->regs, 0, 11);
+
+	swapped_lines = 0;
+	audio_halted = 0;
+	memset(pulses, 0, sizeof(pulses));
+	memset(&saw, 0, sizeof(saw));
+	last_sample = 0;
+
+	vrc_irq_reset();
+
+	mapper->state = vrc6_state;
+	mapper->state_count = MAPPER_STATES(vrc6_state);
+	return;
+}
+
+void vrc6b_initialize_mapper() {
+
+	vrc6_initialize_mapper();
+	swapped_lines = 1;
+
+	return;
+}
+
+static void vrc6_write_pulse(vrc6_pulse *pulse, int reg, uint8_t value) {
+
+	switch( reg ) {
+		case 0:
+			pulse->mode   = value & 0x80;
+			pulse->duty   = (value & 0x70) >> 4;
+			pulse->volume = value & 0x0F;
+			break;
+		case 1:
+			pulse->period = (pulse->period & 0x0F00) | value;
+			break;
+		case 2:
+			pulse->period = (pulse->period & 0x00FF) | ((value & 0x0F) << 8);
+			pulse->enabled = value & 0x80;
+			if( !pulse->enabled )
+				pulse->step = 15;
+			break;
+	}
+
+}
+
+static void vrc6_write_saw(int reg, uint8_t value) {
+
+	switch( reg ) {
+		case 0:
+			saw.rate = value & 0x3F;
+			break;
+		case 1:
+			saw.period = (saw.period & 0x0F00) | value;
+			break;
+		case 2:
+			saw.period = (saw.period & 0x00FF) | ((value & 0x0F) << 8);
+			saw.enabled = value & 0x80;
+			if( !saw.enabled ) {
+				saw.accumulator = 0;
+				saw.step = 0;
+			}
+			break;
+	}
+
+}
+
+int vrc6_check_address(uint16_t address, uint8_t value) {
+
+	int reg;
+
+	if( address < 0x8000 )
+		return 0;
+
+	reg = address & 0x03;
+	if( swapped_lines )
+		reg = ((reg & 0x01) << 1) | ((reg & 0x02) >> 1);
+
+	switch( address & 0xF000 ) {
+
+		case 0x8000:
+			mapper->regs[0] = value & 0x0F;
+			return 1;
+
+		case 0x9000:
+			if( reg == 3 )
+				audio_halted = value & 0x01;
+			else
+				vrc6_write_pulse(pulses, reg, value);
+			break;
+
+		case 0xA000:
+			if( reg != 3 )
+				vrc6_write_pulse(pulses + 1, reg, value);
+			break;
+
+		case 0xB000:
+			if( reg == 3 ) {
+				mapper->regs[2] = (value & 0x0C) >> 2;
+				return 1;
+			}
+			vrc6_write_saw(reg, value);
+			break;
+
+		case 0xC000:
+			mapper->regs[1] = value & 0x1F;
+			return 1;
+
+		case 0xD000:
+			mapper->regs[3 + reg] = value;
+			return 1;
+
+		case 0xE000:
+			mapper->regs[7 + reg] = value;
+			return 1;
+
+		case 0xF000:
+			if( reg == 0 )
+				vrc_irq_write_latch(value);
+			else if( reg == 1 )
+				vrc_irq_write_control(value);
+			else if( reg == 2 )
+				vrc_irq_acknowledge();
+			break;
+	}
+
+	return 0;
+}
+
+void vrc6_switch_banks() {
+
+	int i;
+
+	SWAP_RAM_16K(0x8000, mapper->regs[0] % mapper->file->romBanks16k);
+	SWAP_RAM_8K(0xC000, mapper->regs[1] % mapper->file->romBanks8k);
+
+	if( mapper->file->vromBanks != 0 ) {
+		for(i=0;i!=8;i++)
+			SWAP_VRAM_1K(i*0x400, mapper->regs[3+i] % (mapper->file->vromBanks*8));
+	}
+
+	switch( mapper->regs[2] ) {
+		case 0:
+			PPU->mirroring = VERTICAL_MIRRORING;
+			break;
+		case 1:
+			PPU->mirroring = HORIZONTAL_MIRRORING;
+			break;
+		case 2:
+			PPU->mirroring = SINGLE_SCREEN_MIRRORING_A;
+			break;
+		case 3:
+			PPU->mirroring = SINGLE_SCREEN_MIRRORING_B;
+			break;
+	}
+
+}
+
+void vrc6_reset() {
+
+	/* The last 8kb bank is always fixed into 0xE000-0xFFFF */
+	SWAP_RAM_8K(0xE000, mapper->file->romBanks8k - 1);
+	vrc6_switch_banks();
+}
+
+void vrc6_update() {
+	return;
+}
+
+void vrc6_clock_cpu(int cycles) {
+
+	int i;
+	uint8_t sample;
+	vrc6_pulse *pulse;
+
+	vrc_irq_clock(cycles);
+
+	if( audio_halted )
+		return;
+
+	/* Pulses: 16 steps sequencer, high while step <= duty */
+	sample = 0;
+	for(i=0;i!=2;i++) {
+		pulse = pulses + i;
+		if( !pulse->enabled )
+			continue;
+		pulse->timeout -= cycles;
+		while( pulse->timeout <= 0 ) {
+			pulse->timeout += pulse->period + 1;
+			pulse->step = (pulse->step + 1) & 0x0F;
+		}
+		if( pulse->mode || pulse->step <= pulse->duty )
+			sample += pulse->volume;
+	}
+
+	/* Sawtooth: the accumulator grows every 2 clocks,
+	 * and it's reset after 7 additions */
+	if( saw.enabled ) {
+		saw.timeout -= cycles;
+		while( saw.timeout <= 0 ) {
+			saw.timeout += saw.period + 1;
+			if( ++saw.step == 14 ) {
+				saw.step = 0;
+				saw.accumulator = 0;
+			}
+			else if( !(saw.step & 0x01) )
+				saw.accumulator += saw.rate;
+		}
+		sample += saw.accumulator >> 3;
+	}
+
+	if( sample != last_sample ) {
+		playback_add_sample(Expansion, sample);
+		last_sample = sample;
+	}
+
+}
+
+void vrc6_end_mapper() {
+	free(mapper->regs);
+}
+
+void vrc_irq_reset() {
+	irq_latch = 0;
+	irq_counter = 0;
+	irq_control = 0;
+	irq_prescaler = 341;
+}
+
+void vrc_irq_write_latch(uint8_t value) {
+	irq_latch = value;
+}
+
+void vrc_irq_write_control(uint8_t value) {
+
+	irq_control = value & 0x07;
+	if( irq_control & VRC_IRQ_ENABLE ) {
+		irq_counter = irq_latch;
+		irq_prescaler = 341;
+	}
+	CPU->irq &= ~IRQ_MAPPER;
+
+}
+
+void vrc_irq_acknowledge() {
+
+	/* The "enable after acknowledge" bit goes into the enable one */
+	if( irq_control & VRC_IRQ_ENABLE_AFTER_ACK )
+		irq_control |= VRC_IRQ_ENABLE;
+	else
+		irq_control &= ~VRC_IRQ_ENABLE;
+	CPU->irq &= ~IRQ_MAPPER;
+
+}
+
+void vrc_irq_clock(int cycles) {
+
+	int clocks;
+
+	if( !(irq_control & VRC_IRQ_ENABLE) )
+		return;
+
+	/* In scanline mode the prescaler divides the CPU
+	 * clock by 113.667 (341 PPU cycles) */
+	if( irq_control & VRC_IRQ_CYCLE_MODE )
+		clocks = cycles;
+	else {
+		clocks = 0;
+		irq_prescaler -= cycles*3;
+		while( irq_prescaler <= 0 ) {
+			irq_prescaler += 341;
+			clocks++;
+		}
+	}
+
+	while( clocks-- ) {
+		if( irq_counter == 0xFF ) {
+			irq_counter = irq_latch;
+			CPU->irq |= IRQ_MAPPER;
+		}
+		else
+			irq_counter++;
+	}
+
+}
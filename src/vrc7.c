@@ -0,0 +1,148 @@
+/*  ImaNES: I'm a NES. An intelligent NES emulator
+
+    vrc7.c   -    Konami VRC7 Mapper emulation under ImaNES
+
+    Copyright (C) 2009   Rodrigo Tobar Carrizo
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "debug.h"
+#include "i18n.h"
+#include "mapper.h"
+#include "ppu.h"
+#include "vrc6.h"
+#include "vrc7.h"
+
+void vrc7_initialize_mapper() {
+
+	/* 0-2: PRG banks, 3: mirroring, 4-11: CHR banks */
+	mapper->regs = (uint8_t *)malloc(12);
+	memset(mapper->regs, 0, 12);
+
+	vrc_irq_reset();
+
+	mapper->state = vrc_irq_state;
+	mapper->state_count = VRC_IRQ_STATES;
+	return;
+}
+
+int vrc7_check_address(uint16_t address, uint8_t value) {
+
+	if( address < 0x8000 )
+		return 0;
+
+	/* Depending on the board, the second register of each
+	 * pair is selected either by A4 or by A3 */
+	address = (address & 0xF000) | ((address & 0x18) ? 0x10 : 0);
+
+	switch( address ) {
+
+		case 0x8000:
+			mapper->regs[0] = value & 0x3F;
+			return 1;
+		case 0x8010:
+			mapper->regs[1] = value & 0x3F;
+			return 1;
+		case 0x9000:
+			mapper->regs[2] = value & 0x3F;
+			return 1;
+
+		/* Audio registers, the FM synthesizer is not emulated */
+		case 0x9010:
+			break;
+
+		case 0xA000:
+		case 0xA010:
+		case 0xB000:
+		case 0xB010:
+		case 0xC000:
+		case 0xC010:
+		case 0xD000:
+		case 0xD010:
+			mapper->regs[4 + ((address - 0xA000) >> 11) + ((address & 0x10) >> 4)] = value;
+			return 1;
+
+		case 0xE000:
+			mapper->regs[3] = value;
+			return 1;
+
+		case 0xE010:
+			vrc_irq_write_latch(value);
+			break;
+		case 0xF000:
+			vrc_irq_write_control(value);
+			break;
+		case 0xF010:
+			vrc_irq_acknowledge();
+			break;
+	}
+
+	return 0;
+}
+
+void vrc7_switch_banks() {
+
+	int i;
+
+	for(i=0;i!=3;i++)
+		SWAP_RAM_8K(0x8000 + i*0x2000, mapper->regs[i] % mapper->file->romBanks8k);
+
+	if( mapper->file->vromBanks != 0 ) {
+		for(i=0;i!=8;i++)
+			SWAP_VRAM_1K(i*0x400, mapper->regs[4+i] % (mapper->file->vromBanks*8));
+	}
+
+	switch( mapper->regs[3] & 0x03 ) {
+		case 0:
+			PPU->mirroring = VERTICAL_MIRRORING;
+			break;
+		case 1:
+			PPU->mirroring = HORIZONTAL_MIRRORING;
+			break;
+		case 2:
+			PPU->mirroring = SINGLE_SCREEN_MIRRORING_A;
+			break;
+		case 3:
+			PPU->mirroring = SINGLE_SCREEN_MIRRORING_B;
+			break;
+	}
+
+	CPU->sram_enabled = (mapper->regs[3] & 0x80) ? SRAM_ENABLE : 0;
+
+}
+
+void vrc7_reset() {
+
+	/* The last 8kb bank is always fixed into 0xE000-0xFFFF */
+	SWAP_RAM_8K(0xE000, mapper->file->romBanks8k - 1);
+	vrc7_switch_banks();
+}
+
+void vrc7_update() {
+	return;
+}
+
+void vrc7_clock_cpu(int cycles) {
+	vrc_irq_clock(cycles);
+}
+
+void vrc7_end_mapper() {
+	free(mapper->regs);
+}